@@ -0,0 +1,240 @@
+#include "AsyncSnapshot.h"
+
+#include <algorithm>
+#include <chrono>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && !defined(MADV_COLLAPSE)
+#define MADV_COLLAPSE 25
+#endif
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+#ifndef _WIN32
+	// The child of a fork may only rely on async-signal-safe calls, so it writes
+	// with plain write() instead of stdio.
+	bool WriteAll(int fd, const void* data, size_t size)
+	{
+		const char* p = static_cast<const char*>(data);
+		while (size > 0) {
+			const ssize_t written = write(fd, p, size);
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			p += written;
+			size -= static_cast<size_t>(written);
+		}
+		return true;
+	}
+
+	bool WriteInChild(const char* path, const char* temp, const WorldFileHeader& header, const World& world)
+	{
+		const int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			return false;
+
+		bool ok = WriteAll(fd, &header, sizeof(header)) &&
+			WriteAll(fd, world.particles.data(), world.particles.size() * sizeof(Particle));
+		ok = close(fd) == 0 && ok;
+
+		if (!ok || rename(temp, path) != 0) {
+			unlink(temp);
+			return false;
+		}
+		return true;
+	}
+#endif
+
+#ifdef __linux__
+	// Mark the whole huge pages inside [data, data + size) and collapse the ones
+	// already faulted in now rather than whenever khugepaged gets to them.
+	// Collapsing is safe while other threads keep writing to the range.
+	void CollapseHugePages(void* data, size_t size, bool advise)
+	{
+		const uintptr_t hugePage = 2u << 20;
+		const uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + hugePage - 1) & ~(hugePage - 1);
+		const uintptr_t end = (reinterpret_cast<uintptr_t>(data) + size) & ~(hugePage - 1);
+		if (end <= begin)
+			return;
+
+		if (advise)
+			madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE);
+		madvise(reinterpret_cast<void*>(begin), end - begin, MADV_COLLAPSE);
+	}
+
+	void CollapseWorld(World& world, bool advise)
+	{
+		CollapseHugePages(world.particles.data(), world.particles.size() * sizeof(Particle), advise);
+		CollapseHugePages(world.colors.data(), world.colors.size() * sizeof(Color32), advise);
+	}
+#endif
+}
+
+AsyncSnapshot::~AsyncSnapshot()
+{
+	Wait();
+}
+
+void AsyncSnapshot::Finished(bool ok)
+{
+	mLastSucceeded = ok;
+	++mCompleted;
+}
+
+#ifdef _WIN32
+
+void AsyncSnapshot::UseHugePages(World&)
+{
+	// large pages need a privilege on Windows and cannot be applied to existing memory
+}
+
+bool AsyncSnapshot::Begin(const ParticleSim& sim, const std::string& path)
+{
+	if (Busy())
+		return false;
+
+	const auto start = Clock::now();
+
+	const World& world = sim.GetWorld();
+	const WorldFileHeader header = MakeWorldFileHeader(world.width, world.height, sim.FrameCounter());
+	mCopy = world.particles;
+
+	mWorkerDone = false;
+	mWorker = std::thread([this, header, path] {
+		mWriterOk = WriteWorldFile(path, header, mCopy.data(), mCopy.size());
+		mWorkerDone = true;
+	});
+
+	mLastPauseMs = MillisecondsSince(start);
+	mMaxPauseMs = std::max(mMaxPauseMs, mLastPauseMs);
+	return true;
+}
+
+bool AsyncSnapshot::Busy()
+{
+	if (!mWorker.joinable())
+		return false;
+	if (!mWorkerDone)
+		return true;
+
+	mWorker.join();
+	Finished(mWriterOk);
+	return false;
+}
+
+void AsyncSnapshot::Wait()
+{
+	if (!mWorker.joinable())
+		return;
+
+	mWorker.join();
+	Finished(mWriterOk);
+}
+
+#else
+
+void AsyncSnapshot::UseHugePages(World& world)
+{
+#ifdef __linux__
+	Wait();
+	mHugePageWorld = &world;
+	CollapseWorld(world, true);
+#else
+	(void)world;
+#endif
+}
+
+bool AsyncSnapshot::Begin(const ParticleSim& sim, const std::string& path)
+{
+	if (Busy())
+		return false;
+
+	const auto start = Clock::now();
+
+	// everything the child needs is prepared before the fork
+	const World& world = sim.GetWorld();
+	const WorldFileHeader header = MakeWorldFileHeader(world.width, world.height, sim.FrameCounter());
+	const std::string temp = path + ".tmp";
+
+	// buffered output would otherwise be flushed twice
+	std::fflush(nullptr);
+
+	const pid_t child = fork();
+	if (child < 0)
+		return false;
+
+	if (child == 0)
+		_exit(WriteInChild(path.c_str(), temp.c_str(), header, world) ? 0 : 1);
+
+	mChild = child;
+	mLastPauseMs = MillisecondsSince(start);
+	mMaxPauseMs = std::max(mMaxPauseMs, mLastPauseMs);
+	return true;
+}
+
+bool AsyncSnapshot::Busy()
+{
+	if (mChild >= 0) {
+		int status = 0;
+		const pid_t done = waitpid(mChild, &status, WNOHANG);
+		if (done == 0)
+			return true;
+
+		mChild = -1;
+		Finished(done > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+#ifdef __linux__
+		// writes during the child's lifetime split the huge pages it shared
+		if (mHugePageWorld != nullptr) {
+			mWorkerDone = false;
+			mWorker = std::thread([this] {
+				CollapseWorld(*mHugePageWorld, false);
+				mWorkerDone = true;
+			});
+		}
+#endif
+	}
+
+	if (mWorker.joinable()) {
+		if (!mWorkerDone)
+			return true;
+		mWorker.join();
+	}
+	return false;
+}
+
+void AsyncSnapshot::Wait()
+{
+	if (mChild >= 0) {
+		int status = 0;
+		pid_t done;
+		do {
+			done = waitpid(mChild, &status, 0);
+		} while (done < 0 && errno == EINTR);
+
+		mChild = -1;
+		Finished(done > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+
+	if (mWorker.joinable())
+		mWorker.join();
+}
+
+#endif
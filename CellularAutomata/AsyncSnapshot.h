@@ -0,0 +1,73 @@
+#pragma once
+
+#include "WorldFile.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes world files without stalling the simulation.
+//
+// On POSIX systems Begin() forks. The child sees a copy-on-write image of the
+// parent's memory frozen at the fork, writes that consistent world to disk and
+// exits while the parent keeps simulating. The pause is the fork itself, which
+// copies the page tables. On Linux UseHugePages() cuts those to a fraction;
+// the pages the parent writes while a child is alive are split back to small
+// pages, so they are collapsed again in the background once the child is done.
+//
+// Windows has no fork, so there the planes are copied into a buffer that a
+// writer thread saves. The copy still pauses the caller in proportion to the
+// world size.
+class AsyncSnapshot
+{
+public:
+	AsyncSnapshot() = default;
+	~AsyncSnapshot();
+
+	AsyncSnapshot(const AsyncSnapshot& rhs) = delete;
+	AsyncSnapshot& operator=(const AsyncSnapshot& rhs) = delete;
+
+	// Back the planes of world with huge pages where the system supports it.
+	// world has to outlive this object.
+	void UseHugePages(World& world);
+
+	// Start saving the world of sim to path. Only one snapshot is written at a
+	// time; false while the previous one is still running or if it cannot start.
+	bool Begin(const ParticleSim& sim, const std::string& path);
+
+	// true while a snapshot is being written
+	bool Busy();
+
+	// Block until the running snapshot finished.
+	void Wait();
+
+	// outcome of the last finished snapshot
+	bool LastSucceeded() const { return mLastSucceeded; }
+
+	// milliseconds Begin() blocked the caller for, last and worst so far
+	double LastPauseMs() const { return mLastPauseMs; }
+	double MaxPauseMs() const { return mMaxPauseMs; }
+
+	unsigned int Completed() const { return mCompleted; }
+
+private:
+	void Finished(bool ok);
+
+	bool mLastSucceeded = true;
+	double mLastPauseMs = 0.0;
+	double mMaxPauseMs = 0.0;
+	unsigned int mCompleted = 0;
+
+	// writer thread on Windows, huge page collapse after a child on Linux
+	std::thread mWorker;
+	std::atomic<bool> mWorkerDone{ true };
+
+#ifdef _WIN32
+	bool mWriterOk = false;
+	std::vector<Particle> mCopy;
+#else
+	int mChild = -1;
+	World* mHugePageWorld = nullptr;
+#endif
+};
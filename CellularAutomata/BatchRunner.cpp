@@ -0,0 +1,126 @@
+#include "BatchRunner.h"
+#include "Quiescence.h"
+#include "Scenes.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+namespace
+{
+	PopulationSample Sample(const World& world, unsigned int tick)
+	{
+		PopulationSample sample = { tick, {} };
+		CountMaterials(world, sample.counts.data());
+		return sample;
+	}
+
+	BatchResult RunJob(const BatchJob& job)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		ParticleSim sim(job.width, job.height);
+		BuildTestScene(sim, job.seed);
+		sim.SetGravity(job.gravity);
+		sim.SetMaterials(job.materials);
+
+		BatchResult result;
+		result.population.push_back(Sample(sim.GetWorld(), 0));
+
+		SettleCriteria criteria;
+		criteria.ticks = job.settleTicks;
+		criteria.changedFraction = job.settleFraction;
+		criteria.expiries = false;
+		QuiescenceDetector detector(criteria);
+
+		while (result.ticks < job.maxTicks) {
+			sim.Step(job.dt);
+			++result.ticks;
+
+			if (job.sampleInterval > 0 && result.ticks % job.sampleInterval == 0)
+				result.population.push_back(Sample(sim.GetWorld(), result.ticks));
+
+			if (job.settleTicks > 0 && detector.Update(sim)) {
+				result.settleTick = static_cast<int>(result.ticks - detector.QuietTicks());
+				break;
+			}
+		}
+
+		if (result.population.back().tick != result.ticks)
+			result.population.push_back(Sample(sim.GetWorld(), result.ticks));
+
+		result.checksum = ComputeChecksum(sim.GetWorld());
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return result;
+	}
+
+	const char* const materialNames[mat_id_count] = { "empty", "sand", "water", "stone", "fire", "smoke", "steam" };
+}
+
+std::vector<BatchResult> RunBatch(const std::vector<BatchJob>& jobs, ThreadPool& pool)
+{
+	std::vector<BatchResult> results(jobs.size());
+	pool.ParallelFor(jobs.size(), [&](size_t i) { results[i] = RunJob(jobs[i]); });
+	return results;
+}
+
+bool WriteBatchReport(const std::string& directory, const std::vector<BatchJob>& jobs,
+	const std::vector<BatchResult>& results)
+{
+	namespace fs = std::filesystem;
+
+	std::error_code error;
+	fs::create_directories(directory, error);
+	if (error)
+		return false;
+
+	FILE* summary = std::fopen((fs::path(directory) / "summary.csv").string().c_str(), "w");
+	if (summary == nullptr)
+		return false;
+
+	std::fprintf(summary, "name,width,height,seed,gravity,water_fall_rate,water_spread_rate,"
+		"fire_burnout_age,fire_burnout_chance,smoke_lifetime,steam_lifetime,"
+		"settle_tick,ticks,checksum,seconds");
+	for (int m = 1; m < mat_id_count; ++m)
+		std::fprintf(summary, ",final_%s", materialNames[m]);
+	std::fprintf(summary, "\n");
+
+	bool ok = true;
+	for (size_t i = 0; i < jobs.size() && i < results.size(); ++i) {
+		const BatchJob& job = jobs[i];
+		const BatchResult& result = results[i];
+		const MaterialParams& mp = job.materials;
+
+		std::fprintf(summary, "%s,%u,%u,%u,%g,%d,%d,%g,%d,%g,%g,%d,%u,%016llx,%.4f",
+			job.name.c_str(), job.width, job.height, job.seed, job.gravity,
+			mp.waterFallRate, mp.waterSpreadRate, mp.fireBurnoutAge, mp.fireBurnoutChance,
+			mp.smokeLifetime, mp.steamLifetime, result.settleTick, result.ticks,
+			static_cast<unsigned long long>(result.checksum), result.seconds);
+		for (int m = 1; m < mat_id_count; ++m)
+			std::fprintf(summary, ",%zu", result.population.back().counts[m]);
+		std::fprintf(summary, "\n");
+
+		FILE* curve = std::fopen((fs::path(directory) / (job.name + ".csv")).string().c_str(), "w");
+		if (curve == nullptr) {
+			ok = false;
+			continue;
+		}
+
+		std::fprintf(curve, "tick");
+		for (int m = 1; m < mat_id_count; ++m)
+			std::fprintf(curve, ",%s", materialNames[m]);
+		std::fprintf(curve, "\n");
+
+		for (size_t s = 0; s < result.population.size(); ++s) {
+			std::fprintf(curve, "%u", result.population[s].tick);
+			for (int m = 1; m < mat_id_count; ++m)
+				std::fprintf(curve, ",%zu", result.population[s].counts[m]);
+			std::fprintf(curve, "\n");
+		}
+		std::fclose(curve);
+	}
+
+	std::fclose(summary);
+	return ok;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "ParticleSim.h"
+
+#include <array>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// One world of a parameter sweep. Every job builds the test scene from its
+// seed and runs until the world settles or maxTicks is reached.
+struct BatchJob
+{
+	std::string name;
+	unsigned int width = 200;
+	unsigned int height = 150;
+	unsigned int seed = 1;
+	float gravity = 10.0f;
+	MaterialParams materials;
+
+	unsigned int maxTicks = 3600;
+	// A world counts as settled once at most settleFraction of its cells changed
+	// in each of settleTicks consecutive ticks. Water surfaces and trapped gases
+	// never come to a complete rest, so zero would rarely trigger, and the
+	// gases left in the world are not waited for.
+	float settleFraction = 0.01f;
+	unsigned int settleTicks = 60;
+	unsigned int sampleInterval = 10;	// ticks between population samples
+	float dt = 1.0f / 60.0f;
+};
+
+struct PopulationSample
+{
+	unsigned int tick;
+	std::array<size_t, mat_id_count> counts;
+};
+
+struct BatchResult
+{
+	int settleTick = -1;				// first tick of the quiet run, -1 if the world never settled
+	unsigned int ticks = 0;				// ticks actually simulated
+	uint64_t checksum = 0;				// ComputeChecksum of the final world
+	double seconds = 0.0;
+
+	// material counts every sampleInterval ticks, from the initial scene to the final tick
+	std::vector<PopulationSample> population;
+};
+
+// Run every job on the pool, one world per task. Results are in job order and
+// depend only on the jobs, not on the number of threads.
+std::vector<BatchResult> RunBatch(const std::vector<BatchJob>& jobs, ThreadPool& pool);
+
+// Write summary.csv with one row per job and <name>.csv with its population
+// curve into directory, creating it if needed.
+bool WriteBatchReport(const std::string& directory, const std::vector<BatchJob>& jobs,
+	const std::vector<BatchResult>& results);
@@ -2,7 +2,17 @@
 #include "d3dApp.h"
 #include "MathHelper.h"
 #include <SimpleMath.h>
+#include "ElementaryAutomaton.h"
+#include "FrameGovernor.h"
+#include "MaterialTable.h"
+#include "MemoryReport.h"
+#include "ParticleSim.h"
+#include "WorldHistory.h"
+#include "WorldStream.h"
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <random>
 
 using Microsoft::WRL::ComPtr;
@@ -10,45 +20,6 @@ using namespace DirectX;
 using namespace DirectX::PackedVector;
 using namespace DirectX::SimpleMath;
 
-// material ids
-#define mat_id_empty  (uint8_t)0
-#define mat_id_sand   (uint8_t)1
-#define mat_id_water  (uint8_t)2
-#define mat_id_stone  (uint8_t)3
-#define mat_id_fire   (uint8_t)4
-#define mat_id_smoke  (uint8_t)5
-#define mat_id_steam  (uint8_t)6
-
-// material colors
-// Colors
-#define mat_col_empty  { 0, 0, 0, 0}
-#define mat_col_sand   { 150, 100, 50, 255 }
-#define mat_col_water  { 20, 100, 170, 200 }
-#define mat_col_stone  { 128, 128, 128, 200 }
-#define mat_col_fire   { 150, 20, 0, 255 }
-#define mat_col_smoke  { 50, 50, 50, 255 }
-#define mat_col_steam  { 220, 220, 250, 255 }
-
-struct Color32 {
-	uint8_t r;
-	uint8_t g;
-	uint8_t b;
-	uint8_t a;
-
-	Color32(uint8_t x, uint8_t y, uint8_t z, uint8_t w)
-		: r(x), g(y), b(z), a(w)
-	{
-	}
-};
-
-struct Particle {
-	uint8_t id = mat_id_empty;
-	float life_time;
-	Vector2 velocity;
-	Color32 color = mat_col_empty;
-	bool has_been_updated_this_frame;
-};
-
 // width and height of texture buffer (equals to screen size)
 constexpr unsigned int textureWidth = 800;
 constexpr unsigned int textureHeight = 600;
@@ -60,26 +31,47 @@ enum class material_selection
 	mat_sel_stone,
 	mat_sel_fire,
 	mat_sel_smoke,
-	mat_sel_steam
+	mat_sel_steam,
+	mat_sel_plugin
 };
 
 // selected material (by default, it's sand)
 material_selection selectedMaterial = material_selection::mat_sel_sand;
 
-// world particle data
-std::vector<Particle> WorldData{ textureWidth * textureHeight };
-
-// color data
-std::vector<Color32> ColorData{ textureWidth * textureHeight, Color32(0, 0, 0, 0) };
+// material id painted when a plugin material is selected
+uint8_t selectedPluginMaterial = mat_id_empty;
 
-// gravity settings
-float gravity = 10.0f;
+// material plugins are loaded from this directory at startup
+const char* pluginDirectory = "plugins";
 
 // selection radius
 float selectionRadius = 10.0f;
 
-// frame counter
-unsigned int frameCounter = 0;
+// when set, the 1D automaton runs instead of the particle simulation and its
+// space-time diagram scrolls up through the world texture
+bool elementaryMode = false;
+
+// generations of the 1D automaton appended to the diagram per frame
+unsigned int elementaryRowsPerFrame = 1;
+
+// seconds of simulation kept for rewinding, at 60 frames per second
+constexpr unsigned int rewindSeconds = 10;
+constexpr unsigned int rewindFramesPerSecond = 60;
+
+// milliseconds a simulation step may take before the governor trades quality for speed
+constexpr double stepBudgetMs = 8.0;
+
+// memory the rewind history may take before old frames are compressed, then dropped
+constexpr size_t historyBudgetBytes = 256u << 20;
+
+// simulation ticks per presented frame that F cycles through; above one the
+// colors are only resolved for the frame that is shown
+constexpr unsigned int fastForwardSpeeds[] = { 1, 4, 16, 64 };
+unsigned int fastForwardIndex = 0;
+
+// "host:port" of a headless server to watch instead of simulating locally,
+// from the --connect command line option
+std::string streamAddress;
 
 class CellularAutomata : public D3DApp
 {
@@ -105,36 +97,21 @@ private:
 	void OnMouseMove(WPARAM btnState, int x, int y) override;
 	void OnKeyUp(WPARAM button) override;
 
-	// particle definitions
-	inline Particle ParticleEmpty();
-	inline Particle ParticleSand();
-	inline Particle ParticleWater();
-	inline Particle ParticleStone();
-	inline Particle ParticleFire();
-	inline Particle ParticleSmoke();
-	inline Particle ParticleSteam();
-
-	// particle updates
-	void UpdateParticleSim(const GameTimer& gt);
-	void UpdateSand(uint32_t x, uint32_t y, const GameTimer& gt);
-	void UpdateWater(uint32_t x, uint32_t y, const GameTimer& gt);
-	void UpdateFire(uint32_t x, uint32_t y, const GameTimer& gt);
-	void UpdateSmoke(uint32_t x, uint32_t y, const GameTimer& gt);
-	void UpdateSteam(uint32_t x, uint32_t y, const GameTimer& gt);
+	// 1D automaton mode
+	void UpdateElementary();
+	void ToggleElementaryMode();
+	void HandleElementaryKey(WPARAM button);
+
+	// viewer of a streamed world
+	bool ConnectToServer();
+	void UpdateViewer();
 
 	// Utility functions
 	void ShowControls();
+	void ShowMemoryReport();
+	void CycleFastForward();
 	void ClearScreen();
 	void SelectMaterial(WPARAM button);
-	void WriteData(uint32_t idx, Particle);
-	inline int RandomVal(int lower, int upper);
-	inline int ComputeID(int x, int y);
-	bool InBounds(int x, int y);
-	bool IsEmpty(int x, int y);
-	Particle GetParticleAt(int x, int y);
-	bool CompletelySurrounded(int x, int y);
-	bool IsInWater(int x, int y, int* lx, int* ly);
-	inline float VectorDistance(Vector2 vec1, Vector2 vec2);
 	void UploadToTexture();
 
 	// texture related
@@ -142,6 +119,7 @@ private:
 	ComPtr<ID3D12Resource> mTextureBufferUploader = nullptr;
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 	ComPtr<ID3D12Resource> textureUploadHeap = nullptr;
+	UINT64 mUploadHeapBytes = 0;
 
 	ComPtr<ID3DBlob> VertexBufferCPU = nullptr;
 	ComPtr<ID3DBlob> IndexBufferCPU = nullptr;
@@ -161,6 +139,17 @@ private:
 	D3D12_INDEX_BUFFER_VIEW mIndexBufferView;
 
 	POINT mLastMousePos;
+
+	ParticleSim mSim{ textureWidth, textureHeight };
+	ElementaryAutomaton mElementary{ textureWidth };
+	WorldHistory mHistory{ rewindSeconds * rewindFramesPerSecond };
+	FrameGovernor mGovernor{ stepBudgetMs };
+
+	// window caption without the fast-forward speed
+	std::wstring mCaption;
+
+	StreamClient mStream;
+	bool mViewing = false;
 };
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
@@ -171,6 +160,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+	const char* connect = std::strstr(cmdLine, "--connect ");
+	if (connect != nullptr)
+		streamAddress = connect + std::strlen("--connect ");
+
+	// every shared object in the plugin directory adds its materials
+	std::error_code ec;
+	for (const auto& file : std::filesystem::directory_iterator(pluginDirectory, ec)) {
+		std::string error;
+		if (file.path().extension() == ".dll" && !LoadMaterialPlugin(file.path().string(), error))
+			MessageBoxA(nullptr, error.c_str(), "Material plugin", MB_OK);
+	}
+
 	try
 	{
 		CellularAutomata theApp(hInstance);
@@ -207,7 +208,14 @@ bool CellularAutomata::Initialize()
 	BuildShadersAndInputLayout();
 	BuildPSOs();
 	BuildBuffers();
-	ShowControls();
+
+	mHistory.SetBudget(historyBudgetBytes);
+	mCaption = mMainWndCaption;
+
+	if (!streamAddress.empty())
+		mViewing = ConnectToServer();
+	if (!mViewing)
+		ShowControls();
 
 	// Execute the initialization commands.
 	ThrowIfFailed(mCommandList->Close());
@@ -227,9 +235,33 @@ void CellularAutomata::OnResize()
 
 void CellularAutomata::Update(const GameTimer& gt)
 {
-	frameCounter = (frameCounter + 1) % UINT_MAX;
+	if (mViewing) {
+		UpdateViewer();
+		return;
+	}
+
+	if (elementaryMode) {
+		UpdateElementary();
+		return;
+	}
 
-	UpdateParticleSim(gt);
+	// holding backspace plays the simulation backwards, one frame per frame
+	if (GetAsyncKeyState(VK_BACK) & 0x8000) {
+		mHistory.Rewind(mSim, 1);
+		return;
+	}
+
+	// The governor is handed the time of the whole update, captures
+	// included, so a costly history shows up as a slow step.
+	const auto start = std::chrono::steady_clock::now();
+	const unsigned int speed = fastForwardSpeeds[fastForwardIndex];
+	if (speed > 1)
+		mSim.StepMany(speed, gt.DeltaTime());
+	else
+		mSim.Step(gt.DeltaTime());
+
+	mHistory.Capture(mSim);
+	mGovernor.Record(mSim, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), speed);
 }
 
 void CellularAutomata::Draw(const GameTimer& gt)
@@ -418,67 +450,32 @@ void CellularAutomata::BuildPSOs()
 
 void CellularAutomata::OnMouseDown(WPARAM btnState, int x, int y) 
 {
-	
+	if (mViewing)
+		return;
+
+	// painting only makes sense for the particle simulation
+	if (elementaryMode)
+		return;
+
 	if (btnState == VK_LBUTTON)
-	{		
-		unsigned int mp_x = std::clamp(static_cast<unsigned int>(x), 0u, textureWidth - 1);
-		unsigned int mp_y = std::clamp(static_cast<unsigned int>(y), 0u, textureHeight - 1);
-		unsigned int max_idx = (textureWidth * textureHeight) - 1;
-		unsigned int r_amt = RandomVal(1, 10000);
-		const float R = selectionRadius;
-
-		// Spawn in a circle around the mouse
-		for (unsigned int i = 0; i < r_amt; ++i)
-		{
-			float ran = (float)RandomVal(0, 100) / 100.f;
-			float r = R * sqrt(ran);
-			float theta = (float)RandomVal(0, 100) / 100.f * 2.f * MathHelper::Pi;
-			unsigned int rx = static_cast<unsigned int>(cos(theta) * r);
-			unsigned int ry = static_cast<unsigned int>(sin(theta) * r);
-			unsigned int mpx = std::clamp(mp_x + rx, 0u, textureWidth - 1);
-			unsigned int mpy = std::clamp(mp_y + ry, 0u, textureHeight - 1);
-			unsigned int idx = mpy * textureWidth + mpx;
-			idx = std::clamp(idx, 0u, max_idx);
-
-			if (IsEmpty(mpx, mpy))
-			{
-				Particle p = { 0 };
-				switch (selectedMaterial) {
-				case material_selection::mat_sel_sand: p = ParticleSand(); break;
-				case material_selection::mat_sel_water: p = ParticleWater(); break;
-				case material_selection::mat_sel_stone: p = ParticleStone(); break;
-				case material_selection::mat_sel_fire: p = ParticleFire(); break;
-				case material_selection::mat_sel_smoke: p = ParticleSmoke(); break;
-				case material_selection::mat_sel_steam: p = ParticleSteam(); break;					
-				}
-				p.velocity = Vector2{ static_cast<float>(RandomVal(-1, 1)), static_cast<float>(RandomVal(-2, 5)) };
-				WriteData(idx, p);
-			}
+	{
+		uint8_t material = mat_id_sand;
+		switch (selectedMaterial) {
+		case material_selection::mat_sel_sand: material = mat_id_sand; break;
+		case material_selection::mat_sel_water: material = mat_id_water; break;
+		case material_selection::mat_sel_stone: material = mat_id_stone; break;
+		case material_selection::mat_sel_fire: material = mat_id_fire; break;
+		case material_selection::mat_sel_smoke: material = mat_id_smoke; break;
+		case material_selection::mat_sel_steam: material = mat_id_steam; break;
+		case material_selection::mat_sel_plugin: material = selectedPluginMaterial; break;
 		}
+		mSim.Paint(x, y, selectionRadius, material);
 	}
 
 	// Solid Erase
 	if (btnState == VK_RBUTTON)
-	{		
-		unsigned int mp_x = std::clamp(static_cast<unsigned int>(x), 0u, textureWidth - 1);
-		unsigned int mp_y = std::clamp(static_cast<unsigned int>(y), 0u, textureHeight - 1);
-		unsigned int max_idx = (textureWidth * textureHeight) - 1;
-		const float R = selectionRadius;
-	
-		// Erase in a circle pattern
-		for (int i = -R; i < R; ++i)
-		{
-			for (int j = -R; j < R; ++j)
-			{
-				unsigned int rx = mp_x + j;
-				unsigned int ry = mp_y + i;
-				Vector2 r = Vector2{ static_cast<float>(rx), static_cast<float>(ry) };
-				Vector2 mp = Vector2{ static_cast<float>(x), static_cast<float>(y) };
-				if (InBounds(rx, ry) && VectorDistance(mp, r) <= R) {
-					WriteData(ComputeID(rx, ry), ParticleEmpty());
-				}
-			}
-		}
+	{
+		mSim.Erase(x, y, selectionRadius);
 	}
 }
 
@@ -503,539 +500,163 @@ void CellularAutomata::OnKeyUp(WPARAM button)
 		case 0x43: // 'C' button
 			ClearScreen();
 			break;
+		case 0x45: // 'E' button
+			ToggleElementaryMode();
+			break;
+		case 0x4D: // 'M' button
+			ShowMemoryReport();
+			break;
+		case 0x46: // 'F' button
+			if (!elementaryMode)
+				CycleFastForward();
+			break;
+		case 0x5A: // 'Z' button, undo the last second
+			if (!elementaryMode)
+				mHistory.Rewind(mSim, rewindFramesPerSecond);
+			break;
 		default:
 			break;
 	}
-	SelectMaterial(button);
-}
-
-inline Particle CellularAutomata::ParticleEmpty()
-{
-	Particle p = { 0 };
-	p.id = mat_id_empty;
-	p.color = mat_col_empty;
-	return p;
-}
 
-inline Particle CellularAutomata::ParticleSand()
-{
-	Particle p = { 0 };
-	p.id = mat_id_sand;
-	// Random sand color
-	p.color.r = 204;
-	p.color.g = 127;
-	p.color.b = 51;
-	p.color.a = 255;
-	return p;
+	if (elementaryMode)
+		HandleElementaryKey(button);
+	else
+		SelectMaterial(button);
 }
 
-inline Particle CellularAutomata::ParticleWater()
+void CellularAutomata::ShowControls()
 {
-	Particle p = { 0 };
-	p.id = mat_id_water;
-	p.color.r = 25;
-	p.color.g = 76;
-	p.color.b = 178;
-	p.color.a = 255;
-	return p;
+	std::wstring controls = L"Controls:\n"
+		"Press Left Mouse Button to put particles \n"
+		"Press Right Mouse Button to delete particles\n"
+		"Press 1 to select particle 'sand'\n"
+		"Press 2 to select particle 'water'\n"
+		"Press 3 to select particle 'stone'\n"
+		"Press 4 to select particle 'fire'\n"
+		"Press 5 to select particle 'smoke'\n"
+		"Press 6 to select particle 'steam'\n"
+		"Press 7 to 9 to select the materials of plugins in the 'plugins' folder\n"
+		"Press C to clear screen\n"
+		"Press Z to undo the last second, hold Backspace to rewind (up to 10 seconds)\n"
+		"Press F to fast-forward 4, 16 or 64 times, and back to normal speed\n"
+		"Press M to show the memory in use\n"
+		"Press E to toggle the 1D automaton\n"
+		"  [ / ] to change the Wolfram rule, T for a totalistic rule\n"
+		"  R to restart from random cells, S from a single cell\n";
+	MessageBox(nullptr, controls.c_str(), L"Controls", MB_OK);
 }
 
-inline Particle CellularAutomata::ParticleStone()
+void CellularAutomata::ShowMemoryReport()
 {
-	Particle p = { 0 };
-	p.id = mat_id_stone;
-	float r = (float)(RandomVal(0, 1)) / 2.f;
-	p.color.r = 128;
-	p.color.g = 128;
-	p.color.b = 128;
-	p.color.a = 255;
-	return p;
-}
+	MemoryReport report;
+	AddWorldMemory(report, mSim.GetWorld());
+	report.Add("occupancy pyramid", mSim.Occupancy().MemoryBytes());
+	report.Add("material census", mSim.Census().MemoryBytes());
+	report.Add("rewind history", mHistory.MemoryBytes() - mHistory.PackedBytes());
+	report.Add("rewind history, compressed", mHistory.PackedBytes());
+	report.Add("textures", size_t(SwapChainBufferCount) * textureWidth * textureHeight * sizeof(Color32));
+	report.Add("texture upload heap", static_cast<size_t>(mUploadHeapBytes));
 
-inline Particle CellularAutomata::ParticleFire()
-{
-	Particle p = { 0 };
-	p.id = mat_id_fire;
-	p.color = mat_col_fire;
-	return p;
+	std::string text = report.Format();
+	if (mHistory.FramesEvicted() > 0)
+		text += std::to_string(mHistory.FramesEvicted()) + " rewind frames dropped to stay within the budget\n";
+	MessageBoxA(nullptr, text.c_str(), "Memory", MB_OK);
 }
 
-inline Particle CellularAutomata::ParticleSmoke()
+void CellularAutomata::CycleFastForward()
 {
-	Particle p = { 0 };
-	p.id = mat_id_smoke;
-	p.color = mat_col_smoke;
-	return p;
+	fastForwardIndex = (fastForwardIndex + 1) % _countof(fastForwardSpeeds);
+	const unsigned int speed = fastForwardSpeeds[fastForwardIndex];
+	mMainWndCaption = speed > 1 ? mCaption + L"    fast-forward x" + std::to_wstring(speed) : mCaption;
 }
 
-inline Particle CellularAutomata::ParticleSteam()
+void CellularAutomata::ClearScreen()
 {
-	Particle p = { 0 };
-	p.id = mat_id_steam;
-	p.color = mat_col_steam;
-	return p;
+	mSim.Clear();
 }
 
-void CellularAutomata::UpdateParticleSim(const GameTimer& gt)
+void CellularAutomata::UpdateElementary()
 {
-	// Update frame counter ( loop back to 0 if we roll past unsigned int max )
-	bool frame_counter_even = ((frameCounter % 2) == 0);
-	unsigned int ran = frame_counter_even ? 0 : 1;
+	std::vector<Color32>& colors = mSim.GetWorld().colors;
+	const Color32 alive = mat_col_sand;
+	const Color32 dead = mat_col_empty;
 
-	const float dt = gt.DeltaTime();
-
-	// Rip through read data and update write buffer
-	// Note(John): We update "bottom up", since all the data is edited "in place". Double buffering all data would fix this 
-	// 	issue, however it requires double all of the data.
-	for (unsigned int y = textureHeight - 1; y > 0; --y)
-	{
-		for (unsigned int x = ran ? 0 : textureWidth - 1; ran ? x < textureWidth : x > 0; ran ? ++x : --x)
-		{
-			// Current particle idx
-			unsigned int read_idx = ComputeID(x, y);
-
-			// Get material of particle at point
-			uint8_t mat_id = GetParticleAt(x, y).id;
-
-			// Update particle's lifetime (I guess just use frames)? Or should I have sublife?
-			WorldData.at(read_idx).life_time += 1.f * dt;
-
-			switch (mat_id) {
-
-			case mat_id_sand:  UpdateSand(x, y, gt);  break;
-			case mat_id_water: UpdateWater(x, y, gt); break;
-			case mat_id_smoke: UpdateSmoke(x, y, gt); break;
-			case mat_id_steam: UpdateSteam(x, y, gt); break;
-			case mat_id_fire:  UpdateFire(x, y, gt);  break;
-				// Do nothing for empty or default case
-			default:
-			case mat_id_empty:
-			{
-			} break;
-			}
-		}
-	}
+	for (unsigned int i = 0; i < elementaryRowsPerFrame; ++i) {
+		mElementary.Step();
 
-	// Can remove this loop later on by keeping update structure and setting that for the particle as it moves, 
-	// then at the end of frame just memsetting the entire structure to 0.
-	for (unsigned int y = textureHeight - 1; y > 0; --y) {
-		for (unsigned int x = ran ? 0 : textureWidth - 1; ran ? x < textureWidth : x > 0; ran ? ++x : --x) {
-			// Set particle's update to false for next frame
-			WorldData.at(ComputeID(x, y)).has_been_updated_this_frame = false;
-		}
+		// scroll the diagram up by one row and append the new generation at the bottom
+		std::move(colors.begin() + textureWidth, colors.end(), colors.begin());
+		mElementary.ResolveRow(&colors[(textureHeight - 1) * textureWidth], alive, dead);
 	}
 }
 
-void CellularAutomata::UpdateFire(uint32_t x, uint32_t y, const GameTimer& gt)
+void CellularAutomata::ToggleElementaryMode()
 {
-	float dt = gt.DeltaTime();
-
-	// For water, same as sand, but we'll check immediate left and right as well
-	int read_idx = ComputeID(x, y);
-	Particle* p = &WorldData.at(read_idx);
-	uint32_t write_idx = read_idx;
-	uint32_t fall_rate = 4;
+	World& world = mSim.GetWorld();
+	elementaryMode = !elementaryMode;
 
-	if (p->has_been_updated_this_frame) {
+	if (elementaryMode) {
+		std::fill(world.colors.begin(), world.colors.end(), Color32(0, 0, 0, 0));
 		return;
 	}
 
-	p->has_been_updated_this_frame = true;
-
-	if (p->life_time > 0.2f) {
-		if (RandomVal(0, 100) == 0) {
-			WriteData(read_idx, ParticleEmpty());
-			return;
-		}
-	}
-
-	float st = sin(gt.TotalTime());
-	// float grav_mul = random_val( 0, 10 ) == 0 ? 2.f : 1.f;
-	p->velocity.y = std::clamp(p->velocity.y - ((gravity * dt)) * 0.2f, -5.0f, 0.f);
-	// p->velocity.x = std::clamp( st, -1.f, 1.f );
-	p->velocity.x = std::clamp(p->velocity.x + (float)RandomVal(-100, 100) / 200.f, -0.5f, 0.5f);
-
-	// Change color based on life_time
-
-	if (RandomVal(0, (int)(p->life_time * 100.f)) % 200 == 0) {
-		int ran = RandomVal(0, 3);
-		switch (ran) {
-		case 0: p->color = { 255, 80, 20, 255 }; break;
-		case 1: p->color = { 250, 150, 10, 255 }; break;
-		case 2: p->color = { 200, 150, 0, 255 }; break;
-		case 3: p->color = { 100, 50, 2, 255 }; break;
-		}
-	}
-
-	if (p->life_time < 0.02f) {
-		p->color.r = 200;
-	}
-	else {
-		p->color.r = 255;
-	}
-
-	// In water, so create steam and DIE
-	// Should also kill the water...
-	int lx, ly;
-	if (IsInWater(x, y, &lx, &ly)) {
-		if (RandomVal(0, 1) == 0) {
-			int ry = RandomVal(-5, -1);
-			int rx = RandomVal(-5, 5);
-			for (int i = ry; i > -5; --i) {
-				for (int j = rx; j < 5; ++j) {
-					Particle p = ParticleSteam();
-					if (InBounds(x + j, y + i) && IsEmpty(x + j, y + i)) {
-						Particle p = ParticleSteam();
-						WriteData(ComputeID(x + j, y + i), p);
-					}
-				}
-			}
-			Particle p = ParticleSteam();
-			WriteData(read_idx, ParticleEmpty());
-			WriteData(read_idx, p);
-			WriteData(ComputeID(lx, ly), ParticleEmpty());
-			return;
-		}
-	}
-
-	// Just check if you can move directly beneath you. If not, then reset your velocity. God, this is going to blow.
-	if (InBounds(x, y + 1) && !IsEmpty(x, y + 1) && (GetParticleAt(x, y + 1).id != mat_id_water || GetParticleAt(x, y + 1).id != mat_id_smoke)) {
-		p->velocity.y /= 2.f;
-	}
-
-	if (RandomVal(0, 10) == 0) {
-		// p->velocity.x = std::clamp( p->velocity.x + (float)random_val( -1, 1 ) / 2.f, -1.f, 1.f );
-	}
-	// p->velocity.x = std::clamp( p->velocity.x, -0.5f, 0.5f );
-
-	// Kill fire underneath
-	if (InBounds(x, y + 3) && GetParticleAt(x, y + 3).id == mat_id_fire && RandomVal(0, 100) == 0) {
-		WriteData(ComputeID(x, y + 3), *p);
-		WriteData(read_idx, ParticleEmpty());
-		return;
-	}
-
-	// Chance to kick itself up ( to simulate flames )
-	if (InBounds(x, y + 1) && GetParticleAt(x, y + 1).id == mat_id_fire &&
-		InBounds(x, y - 1) && GetParticleAt(x, y - 1).id == mat_id_empty) {
-		if (RandomVal(0, 10) == 0 * p->life_time < 10.f && p->life_time > 1.f) {
-			int r = RandomVal(0, 1);
-			int rh = RandomVal(-10, -1);
-			int spread = 3;
-			for (int i = rh; i < 0; ++i) {
-				for (int j = r ? -spread : spread; r ? j < spread : j > -spread; r ? ++j : --j) {
-					int rx = j, ry = i;
-					if (InBounds(x + rx, y + ry) && IsEmpty(x + rx, y + ry)) {
-						WriteData(ComputeID(x + rx, y + ry), *p);
-						WriteData(read_idx, ParticleEmpty());
-						break;
-					}
-				}
-			}
-		}
-		return;
-	}
-
-	int vi_x = x + (int)p->velocity.x;
-	int vi_y = y + (int)p->velocity.y;
-
-	// Check to see if you can swap first with other element below you
-	uint32_t b_idx = ComputeID(x, y + 1);
-	uint32_t br_idx = ComputeID(x + 1, y + 1);
-	uint32_t bl_idx = ComputeID(x - 1, y + 1);
-
-	const int wood_chance = 100;
-	const int gun_powder_chance = 1;
-	const int oil_chance = 5;
-
-	// Chance to spawn smoke above
-	for (uint32_t i = 0; i < RandomVal(1, 10); ++i) {
-		if (RandomVal(0, 500) == 0) {
-			if (InBounds(x, y - 1) && IsEmpty(x, y - 1)) {
-				WriteData(ComputeID(x, y - 1), ParticleSmoke());
-			}
-			else if (InBounds(x + 1, y - 1) && IsEmpty(x + 1, y - 1)) {
-				WriteData(ComputeID(x + 1, y - 1), ParticleSmoke());
-			}
-			else if (InBounds(x - 1, y - 1) && IsEmpty(x - 1, y - 1)) {
-				WriteData(ComputeID(x - 1, y - 1), ParticleSmoke());
-			}
-		}
-	}		
-
-	if (InBounds(vi_x, vi_y) && (IsEmpty(vi_x, vi_y) ||
-		GetParticleAt(vi_x, vi_y).id == mat_id_fire ||
-		GetParticleAt(vi_x, vi_y).id == mat_id_smoke))
-	{
-		// p->velocity.y -= (gravity * dt );
-		Particle tmp_b = WorldData.at(ComputeID(vi_x, vi_y));
-		WriteData(ComputeID(vi_x, vi_y), *p);
-		WriteData(read_idx, tmp_b);
-	}
-
-	// Simple falling, changing the velocity here ruins everything. I need to redo this entire simulation.
-	else if (InBounds(x, y + 1) && ((IsEmpty(x, y + 1) || (WorldData.at(b_idx).id == mat_id_water)))) {
-		// p->velocity.y -= (gravity * dt );
-		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
-		Particle tmp_b = WorldData.at(b_idx);
-		WriteData(b_idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x - 1, y + 1) && ((IsEmpty(x - 1, y + 1) || WorldData.at(bl_idx).id == mat_id_water))) {
-		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
-		// p->velocity.y -= (gravity * dt );
-		Particle tmp_b = WorldData.at(bl_idx);
-		WriteData(bl_idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x + 1, y + 1) && ((IsEmpty(x + 1, y + 1) || WorldData.at(br_idx).id == mat_id_water))) {
-		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
-		// p->velocity.y -= (gravity * dt );
-		Particle tmp_b = WorldData.at(br_idx);
-		WriteData(br_idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x - 1, y - 1) && (WorldData.at(ComputeID(x - 1, y - 1)).id == mat_id_water)) {
-		uint32_t idx = ComputeID(x - 1, y - 1);
-		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
-		Particle tmp_b = WorldData.at(idx);
-		WriteData(idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x + 1, y - 1) && (WorldData.at(ComputeID(x + 1, y - 1)).id == mat_id_water)) {
-		uint32_t idx = ComputeID(x + 1, y - 1);
-		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
-		Particle tmp_b = WorldData.at(idx);
-		WriteData(idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x, y - 1) && (WorldData.at(ComputeID(x, y - 1)).id == mat_id_water)) {
-		uint32_t idx = ComputeID(x, y - 1);
-		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
-		Particle tmp_b = WorldData.at(idx);
-		WriteData(idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else {
-		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
-		WriteData(read_idx, *p);
-	}
+	// restore the particle colors the diagram drew over
+	for (size_t i = 0; i < world.particles.size(); ++i)
+		world.colors[i] = world.particles[i].color;
 }
 
-void CellularAutomata::UpdateSmoke(uint32_t x, uint32_t y, const GameTimer& gt)
+void CellularAutomata::HandleElementaryKey(WPARAM button)
 {
-	float dt = gt.DeltaTime();
-
-	// For water, same as sand, but we'll check immediate left and right as well
-	uint32_t read_idx = ComputeID(x, y);
-	Particle* p = &WorldData.at(read_idx);
-	uint32_t write_idx = read_idx;
-	uint32_t fall_rate = 4;
-
-	if (p->life_time > 10.f) {
-		WriteData(read_idx, ParticleEmpty());
-		return;
-	}
-
-	if (p->has_been_updated_this_frame) {
-		return;
-	}
-
-	p->has_been_updated_this_frame = true;
-
-	// Smoke rises over time. This might cause issues, actually...
-	p->velocity.y = std::clamp(p->velocity.y - (gravity * dt), -2.f, 10.f);
-	p->velocity.x = std::clamp(p->velocity.x + (float)RandomVal(-100, 100) / 100.f, -1.f, 1.f);
-
-	// Just check if you can move directly beneath you. If not, then reset your velocity. God, this is going to blow.
-	if (InBounds(x, y - 1) && !IsEmpty(x, y - 1) && GetParticleAt(x, y - 1).id != mat_id_water) {
-		p->velocity.y /= 2.f;
-	}
-
-	int vi_x = x + (int)p->velocity.x;
-	int vi_y = y + (int)p->velocity.y;
-
-	// if ( in_bounds( vi_x, vi_y ) && ( (is_empty( vi_x, vi_y ) || get_particle_at( vi_x, vi_y ).id == mat_id_water || get_particle_at( vi_x, vi_y ).id == mat_id_fire ) ) ) {
-	if (InBounds(vi_x, vi_y) && GetParticleAt(vi_x, vi_y).id != mat_id_smoke) {
-
-		Particle tmp_b = WorldData.at(ComputeID(vi_x, vi_y));
-
-		// Try to throw water out
-		if (tmp_b.id == mat_id_water) {
-
-			tmp_b.has_been_updated_this_frame = true;
-
-			int rx = RandomVal(-2, 2);
-			tmp_b.velocity = { static_cast<float>(rx), -3.0f };
-
-			WriteData(ComputeID(vi_x, vi_y), *p);
-			WriteData(read_idx, tmp_b);
-
-		}
-		else if (IsEmpty(vi_x, vi_y)) {
-			WriteData(ComputeID(vi_x, vi_y), *p);
-			WriteData(read_idx, tmp_b);
-		}
-	}
-	// Simple falling, changing the velocity here ruins everything. I need to redo this entire simulation.
-	else if (InBounds(x, y - 1) && GetParticleAt(x, y - 1).id != mat_id_smoke &&
-		GetParticleAt(x, y - 1).id != mat_id_stone) {
-		p->velocity.y -= (gravity * dt);
-		Particle tmp_b = GetParticleAt(x, y - 1);
-		WriteData(ComputeID(x, y - 1), *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x - 1, y - 1) && GetParticleAt(x - 1, y - 1).id != mat_id_smoke &&
-		GetParticleAt(x - 1, y - 1).id != mat_id_stone) {
-		p->velocity.x = RandomVal(0, 1) == 0 ? -1.2f : 1.2f;
-		p->velocity.y -= (gravity * dt);
-		Particle tmp_b = GetParticleAt(x - 1, y - 1);
-		WriteData(ComputeID(x - 1, y - 1), *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x + 1, y - 1) && GetParticleAt(x + 1, y - 1).id != mat_id_smoke &&
-		GetParticleAt(x + 1, y - 1).id != mat_id_stone) {
-		p->velocity.x = RandomVal(0, 1) == 0 ? -1.2f : 1.2f;
-		p->velocity.y -= (gravity * dt);
-		Particle tmp_b = GetParticleAt(x + 1, y - 1);
-		WriteData(ComputeID(x + 1, y - 1), *p);
-		WriteData(read_idx, tmp_b);
-	}
-	// Can move if in liquid
-	else if (InBounds(x + 1, y) && GetParticleAt(x + 1, y).id != mat_id_smoke &&
-		GetParticleAt(x + 1, y).id != mat_id_stone) {
-		uint32_t idx = ComputeID(x + 1, y);
-		Particle tmp_b = WorldData.at(idx);
-		WriteData(idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x - 1, y) && GetParticleAt(x - 1, y).id != mat_id_smoke &&
-		GetParticleAt(x - 1, y).id != mat_id_stone) {
-		uint32_t idx = ComputeID(x - 1, y);
-		Particle tmp_b = WorldData.at(idx);
-		WriteData(idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else {
-		WriteData(read_idx, *p);
+	switch (button) {
+	case VK_OEM_4: // '[' button
+		mElementary.SetWolframRule(mElementary.WolframRule() - 1);
+		break;
+	case VK_OEM_6: // ']' button
+		mElementary.SetWolframRule(mElementary.WolframRule() + 1);
+		break;
+	case 0x54: // 'T' button, radius 2 rule with code 20
+		mElementary.SetTotalisticRule(2, 20);
+		mElementary.SeedSingle();
+		break;
+	case 0x52: // 'R' button
+		mElementary.SeedRandom(static_cast<uint32_t>(std::rand()));
+		break;
+	case 0x53: // 'S' button
+		mElementary.SeedSingle();
+		break;
 	}
 }
 
-void CellularAutomata::UpdateSteam(uint32_t x, uint32_t y, const GameTimer& gt)
+bool CellularAutomata::ConnectToServer()
 {
-	float dt = gt.DeltaTime();
-
-	// For water, same as sand, but we'll check immediate left and right as well
-	uint32_t read_idx = ComputeID(x, y);
-	Particle* p = &WorldData.at(read_idx);
-	uint32_t write_idx = read_idx;
-	uint32_t fall_rate = 4;
-
-	if (p->life_time > 10.f) {
-		WriteData(read_idx, ParticleEmpty());
-		return;
-	}
-
-	if (p->has_been_updated_this_frame) {
-		return;
-	}
-
-	p->has_been_updated_this_frame = true;
-
-	// Smoke rises over time. This might cause issues, actually...
-	p->velocity.y = std::clamp(p->velocity.y - (gravity * dt), -2.f, 10.f);
-	p->velocity.x = std::clamp(p->velocity.x + (float)RandomVal(-100, 100) / 100.f, -1.f, 1.f);
-
-	// Just check if you can move directly beneath you. If not, then reset your velocity. God, this is going to blow.
-	if (InBounds(x, y - 1) && !IsEmpty(x, y - 1) && GetParticleAt(x, y - 1).id != mat_id_water) {
-		p->velocity.y /= 2.f;
-	}
-
-	int vi_x = x + (int)p->velocity.x;
-	int vi_y = y + (int)p->velocity.y;
-
-	if (InBounds(vi_x, vi_y) && ((IsEmpty(vi_x, vi_y) || GetParticleAt(vi_x, vi_y).id == mat_id_water || GetParticleAt(vi_x, vi_y).id == mat_id_fire))) {
-
-		Particle tmp_b = WorldData.at(ComputeID(vi_x, vi_y));
-
-		// Try to throw water out
-		if (tmp_b.id == mat_id_water) {
-
-			tmp_b.has_been_updated_this_frame = true;
-
-			int rx = RandomVal(-2, 2);
-			tmp_b.velocity = { static_cast<float>(rx), -3.f };
+	const size_t colon = streamAddress.rfind(':');
+	const std::string host = colon == std::string::npos ? "127.0.0.1" : streamAddress.substr(0, colon);
+	const int port = std::atoi(colon == std::string::npos ? streamAddress.c_str() : streamAddress.c_str() + colon + 1);
 
-			WriteData(ComputeID(vi_x, vi_y), *p);
-			WriteData(read_idx, tmp_b);
-
-		}
-		else if (IsEmpty(vi_x, vi_y)) {
-			WriteData(ComputeID(vi_x, vi_y), *p);
-			WriteData(read_idx, tmp_b);
-		}
-	}
-	// Simple falling, changing the velocity here ruins everything. I need to redo this entire simulation.
-	else if (InBounds(x, y - 1) && ((IsEmpty(x, y - 1) || (GetParticleAt(x, y - 1).id == mat_id_water) || GetParticleAt(x, y - 1).id == mat_id_fire))) {
-		p->velocity.y -= (gravity * dt);
-		Particle tmp_b = GetParticleAt(x, y - 1);
-		WriteData(ComputeID(x, y - 1), *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x - 1, y - 1) && ((IsEmpty(x - 1, y - 1) || GetParticleAt(x - 1, y - 1).id == mat_id_water) || GetParticleAt(x - 1, y - 1).id == mat_id_fire)) {
-		p->velocity.x = RandomVal(0, 1) == 0 ? -1.2f : 1.2f;
-		p->velocity.y -= (gravity * dt);
-		Particle tmp_b = GetParticleAt(x - 1, y - 1);
-		WriteData(ComputeID(x - 1, y - 1), *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x + 1, y - 1) && ((IsEmpty(x + 1, y - 1) || GetParticleAt(x + 1, y - 1).id == mat_id_water) || GetParticleAt(x + 1, y - 1).id == mat_id_fire)) {
-		p->velocity.x = RandomVal(0, 1) == 0 ? -1.2f : 1.2f;
-		p->velocity.y -= (gravity * dt);
-		Particle tmp_b = GetParticleAt(x + 1, y - 1);
-		WriteData(ComputeID(x + 1, y - 1), *p);
-		WriteData(read_idx, tmp_b);
-	}
-	// Can move if in liquid
-	else if (InBounds(x + 1, y) && (GetParticleAt(x + 1, y).id == mat_id_water)) {
-		uint32_t idx = ComputeID(x + 1, y);
-		Particle tmp_b = WorldData.at(idx);
-		WriteData(idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x - 1, y) && (WorldData.at(ComputeID(x - 1, y)).id == mat_id_water)) {
-		uint32_t idx = ComputeID(x - 1, y);
-		Particle tmp_b = WorldData.at(idx);
-		WriteData(idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else {
-		WriteData(read_idx, *p);
+	if (!mStream.Connect(host, static_cast<uint16_t>(port))) {
+		std::wstring message = L"Could not connect to " + std::wstring(streamAddress.begin(), streamAddress.end());
+		MessageBox(nullptr, message.c_str(), L"Viewer", MB_OK);
+		return false;
 	}
+	return true;
 }
 
-void CellularAutomata::ShowControls()
+void CellularAutomata::UpdateViewer()
 {
-	std::wstring controls = L"Controls:\n"
-		"Press Left Mouse Button to put particles \n"
-		"Press Right Mouse Button to delete particles\n"
-		"Press 1 to select particle 'sand'\n"
-		"Press 2 to select particle 'water'\n"
-		"Press 3 to select particle 'stone'\n"
-		"Press 4 to select particle 'fire'\n"
-		"Press 5 to select particle 'smoke'\n"
-		"Press 6 to select particle 'steam'\n"
-		"Press C to clear screen\n";
-	MessageBox(nullptr, controls.c_str(), L"Controls", MB_OK);
-}
+	// the last picture stays up once the server is gone
+	if (!mStream.Poll())
+		mViewing = false;
 
-void CellularAutomata::ClearScreen()
-{
-	std::vector<Particle> tempData{ textureWidth * textureHeight }; // construct a new scene with default data
-	WorldData.assign(tempData.begin(), tempData.end()); // overwrite existing data
+	const World* remote = mStream.GetWorld();
+	if (remote == nullptr)
+		return;
 
-	std::vector<Color32> tempColor{ textureWidth * textureHeight, Color32(0, 0, 0, 0) };
-	ColorData.assign(tempColor.begin(), tempColor.end());
+	// show the top left of worlds larger than the texture
+	World& world = mSim.GetWorld();
+	const unsigned int w = (std::min)(remote->width, textureWidth);
+	const unsigned int h = (std::min)(remote->height, textureHeight);
+	for (unsigned int y = 0; y < h; ++y)
+		std::copy_n(&remote->colors[static_cast<size_t>(y) * remote->width], w, &world.colors[static_cast<size_t>(y) * textureWidth]);
 }
 
 void CellularAutomata::SelectMaterial(WPARAM button)
@@ -1059,331 +680,15 @@ void CellularAutomata::SelectMaterial(WPARAM button)
 	case 0x36: // button '6' pressed
 		selectedMaterial = material_selection::mat_sel_steam;
 		break;
-	}
-}
-
-void CellularAutomata::UpdateSand(uint32_t x, uint32_t y, const GameTimer& gt) {
-	float dt = gt.DeltaTime();
-
-	// For water, same as sand, but we'll check immediate left and right as well
-	unsigned int read_idx = ComputeID(x, y);
-	Particle* p = &WorldData.at(read_idx);
-	unsigned int write_idx = read_idx;
-	unsigned int fall_rate = 4;
-
-	p->velocity.y = std::clamp(p->velocity.y + (gravity * dt), -10.f, 10.f);
-
-	// Just check if you can move directly beneath you. If not, then reset your velocity. God, this is going to blow.
-	if (InBounds(x, y + 1) && !IsEmpty(x, y + 1) && GetParticleAt(x, y + 1).id != mat_id_water) {
-		p->velocity.y /= 2.f;
-	}
-
-	int vi_x = x + (int)p->velocity.x;
-	int vi_y = y + (int)p->velocity.y;
-
-	// Check to see if you can swap first with other element below you
-	unsigned int b_idx = ComputeID(x, y + 1);
-	unsigned int br_idx = ComputeID(x + 1, y + 1);
-	unsigned int bl_idx = ComputeID(x - 1, y + 1);
-
-	int lx{}, ly{};
-
-	Particle tmp_a = WorldData.at(read_idx);
-
-	// Physics (using velocity)
-	if (InBounds(vi_x, vi_y) && ((IsEmpty(vi_x, vi_y) ||
-		(((WorldData.at(ComputeID(vi_x, vi_y)).id == mat_id_water) &&
-			!WorldData.at(ComputeID(vi_x, vi_y)).has_been_updated_this_frame &&
-			(WorldData.at(ComputeID(vi_x, vi_y)).velocity.Length() - tmp_a.velocity.Length()) > 10.f))))) {
-
-		Particle tmp_b = WorldData.at(ComputeID(vi_x, vi_y));
-
-		// Try to throw water out
-		if (tmp_b.id == mat_id_water) {
-
-			int rx = RandomVal(-2, 2);
-			tmp_b.velocity = Vector2{ static_cast<float>(rx), -4.f };
-
-			WriteData(ComputeID(vi_x, vi_y), tmp_a);
-
-			for (int i = -10; i < 0; ++i) {
-				for (int j = -10; j < 10; ++j) {
-					if (IsEmpty(vi_x + j, vi_y + i)) {
-						WriteData(ComputeID(vi_x + j, vi_y + i), tmp_b);
-						break;
-					}
-				}
-			}
-
-			// Couldn't write there, so, uh, destroy it.
-			WriteData(read_idx, ParticleEmpty());
-		}
-		else if (IsEmpty(vi_x, vi_y)) {
-			WriteData(ComputeID(vi_x, vi_y), tmp_a);
-			WriteData(read_idx, tmp_b);
+	case 0x37: // buttons '7' to '9' pick the plugin materials in load order
+	case 0x38:
+	case 0x39:
+		if (mat_id_count + (button - 0x37) < MaterialCount()) {
+			selectedPluginMaterial = static_cast<uint8_t>(mat_id_count + (button - 0x37));
+			selectedMaterial = material_selection::mat_sel_plugin;
 		}
+		break;
 	}
-	// Simple falling, changing the velocity here ruins everything. I need to redo this entire simulation.
-	else if (InBounds(x, y + 1) && ((IsEmpty(x, y + 1) || (WorldData.at(b_idx).id == mat_id_water)))) {
-		p->velocity.y += (gravity * dt);
-		Particle tmp_b = GetParticleAt(x, y + 1);
-		WriteData(b_idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x - 1, y + 1) && ((IsEmpty(x - 1, y + 1) || WorldData.at(bl_idx).id == mat_id_water))) {
-		p->velocity.x = RandomVal(0, 1) == 0 ? -1.f : 1.f;
-		p->velocity.y += (gravity * dt);
-		Particle tmp_b = GetParticleAt(x - 1, y + 1);
-		WriteData(bl_idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x + 1, y + 1) && ((IsEmpty(x + 1, y + 1) || WorldData.at(br_idx).id == mat_id_water))) {
-		p->velocity.x = RandomVal(0, 1) == 0 ? -1.f : 1.f;
-		p->velocity.y += (gravity * dt);
-		Particle tmp_b = GetParticleAt(x + 1, y + 1);
-		WriteData(br_idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (RandomVal(0, 10) == 0) {
-		Particle tmp_b = GetParticleAt(lx, ly);
-		WriteData(ComputeID(lx, ly), *p);
-		WriteData(read_idx, tmp_b);
-	}
-}
-
-void CellularAutomata::UpdateWater(uint32_t x, uint32_t y, const GameTimer& gt) {
-	float dt = gt.DeltaTime();
-
-	unsigned int read_idx = ComputeID(x, y);
-	Particle* p = &WorldData.at(read_idx);
-	unsigned int write_idx = read_idx;
-	int fall_rate = 2;
-	int spread_rate = 5;
-
-	p->velocity.y = std::clamp(p->velocity.y + (gravity * dt), -10.f, 10.f);
-
-	p->has_been_updated_this_frame = true;
-
-	// Just check if you can move directly beneath you. If not, then reset your velocity. God, this is going to blow.
-	// if ( in_bounds( x, y + 1 ) && !is_empty( x, y + 1 ) && get_particle_at( x, y + 1 ).id != mat_id_water ) {
-	if (InBounds(x, y + 1) && !IsEmpty(x, y + 1)) {
-		p->velocity.y /= 2.f;
-	}
-
-	// Change color depending on pressure? Pressure would dictate how "deep" the water is, I suppose.
-	if (RandomVal(0, (int)(p->life_time * 100.f)) % 20 == 0) {
-		float r = (float)(RandomVal(0, 1)) / 2.f;
-		p->color.r = 25;
-		p->color.g = 76;
-		p->color.b = 178;
-	}
-
-	int ran = RandomVal(0, 1);
-	int r = ran ? spread_rate : -spread_rate;
-	int l = -r;
-	int u = fall_rate;
-	int v_idx = ComputeID(x + (int)p->velocity.x, y + (int)p->velocity.y);
-	int b_idx = ComputeID(x, y + u);
-	int bl_idx = ComputeID(x + l, y + u);
-	int br_idx = ComputeID(x + r, y + u);
-	int l_idx = ComputeID(x + l, y);
-	int r_idx = ComputeID(x + r, y);
-	int vx = (int)p->velocity.x, vy = (int)p->velocity.y;
-	int lx{}, ly{};
-
-	if (InBounds(x + vx, y + vy) && (IsEmpty(x + vx, y + vy))) {
-		WriteData(v_idx, *p);
-		WriteData(read_idx, ParticleEmpty());
-	}
-	else if (IsEmpty(x, y + u)) {
-		WriteData(b_idx, *p);
-		WriteData(read_idx, ParticleEmpty());
-	}
-	else if (IsEmpty(x + r, y + u)) {
-		WriteData(br_idx, *p);
-		WriteData(read_idx, ParticleEmpty());
-	}
-	else if (IsEmpty(x + l, y + u)) {
-		WriteData(bl_idx, *p);
-		WriteData(read_idx, ParticleEmpty());
-	}
-	// Simple falling, changing the velocity here ruins everything. I need to redo this entire simulation.
-	else if (InBounds(x, y + u) && (IsEmpty(x, y + u))) {
-		p->velocity.y += (gravity * dt);
-		Particle tmp_b = GetParticleAt(x, y + u);
-		WriteData(b_idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x + l, y + u) && (IsEmpty(x + l, y + u))) {
-		p->velocity.x = RandomVal(0, 1) == 0 ? -1.f : 1.f;
-		p->velocity.y += (gravity * dt);
-		Particle tmp_b = GetParticleAt(x + l, y + u);
-		WriteData(bl_idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (InBounds(x + r, y + u) && (IsEmpty(x + r, y + u) )) {
-		p->velocity.x = RandomVal(0, 1) == 0 ? -1.f : 1.f;
-		p->velocity.y += (gravity * dt);
-		Particle tmp_b = GetParticleAt(x + r, y + u);
-		WriteData(br_idx, *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else if (RandomVal(0, 10) == 0) {
-		Particle tmp_b = GetParticleAt(lx, ly);
-		WriteData(ComputeID(lx, ly), *p);
-		WriteData(read_idx, tmp_b);
-	}
-	else {
-		Particle tmp = *p;
-		bool found = false;
-
-		// Don't try to spread if something is directly above you?
-		if (CompletelySurrounded(x, y)) {
-			WriteData(read_idx, tmp);
-			return;
-		}
-		else {
-			for (unsigned int i = 0; i < fall_rate; ++i) {
-				for (int j = spread_rate; j > 0; --j)
-				{
-					if (InBounds(x - j, y + i) && (IsEmpty(x - j, y + i))) {
-						Particle tmp = GetParticleAt(x - j, y + i);
-						WriteData(ComputeID(x - j, y + i), *p);
-						WriteData(read_idx, tmp);
-						found = true;
-						break;
-					}
-					if (InBounds(x + j, y + i) && (IsEmpty(x + j, y + i))) {
-						Particle tmp = GetParticleAt(x + j, y + i);
-						WriteData(ComputeID(x + j, y + i), *p);
-						WriteData(read_idx, tmp);
-						found = true;
-						break;
-					}
-				}
-			}
-
-			if (!found) {
-				WriteData(read_idx, tmp);
-			}
-		}
-	}
-}
-
-void CellularAutomata::WriteData(uint32_t idx, Particle p) {
-	// Write into particle data for id value
-	WorldData.at(idx) = p;
-	ColorData.at(idx) = p.color;
-}
-
-inline int CellularAutomata::RandomVal(int lower, int upper) {
-	if (upper < lower) {
-		int tmp = lower;
-		lower = upper;
-		upper = tmp;
-	}
-
-	return (std::rand() % (upper - lower + 1) + lower);
-}
-
-inline int CellularAutomata::ComputeID(int x, int y) {
-	return (y * textureWidth + x);
-}
-
-bool CellularAutomata::InBounds(int x, int y) {
-	if (x < 0 || x >(textureWidth - 1) || y < 0 || y >(textureHeight - 1)) return false;
-	return true;
-}
-
-bool CellularAutomata::IsEmpty(int x, int y) {
-	return (InBounds(x, y) && WorldData.at(ComputeID(x, y)).id == mat_id_empty);
-}
-
-Particle CellularAutomata::GetParticleAt(int x, int y) {
-	return WorldData.at(ComputeID(x, y));
-}
-
-bool CellularAutomata::CompletelySurrounded(int x, int y) {
-	// Top
-	if (InBounds(x, y - 1) && !IsEmpty(x, y - 1)) {
-		return false;
-	}
-	// Bottom
-	if (InBounds(x, y + 1) && !IsEmpty(x, y + 1)) {
-		return false;
-	}
-	// Left
-	if (InBounds(x - 1, y) && !IsEmpty(x - 1, y)) {
-		return false;
-	}
-	// Right
-	if (InBounds(x + 1, y) && !IsEmpty(x + 1, y)) {
-		return false;
-	}
-	// Top Left
-	if (InBounds(x - 1, y - 1) && !IsEmpty(x - 1, y - 1)) {
-		return false;
-	}
-	// Top Right
-	if (InBounds(x + 1, y - 1) && !IsEmpty(x + 1, y - 1)) {
-		return false;
-	}
-	// Bottom Left
-	if (InBounds(x - 1, y + 1) && !IsEmpty(x - 1, y + 1)) {
-		return false;
-	}
-	// Bottom Right
-	if (InBounds(x + 1, y + 1) && !IsEmpty(x + 1, y + 1)) {
-		return false;
-	}
-
-	return true;
-}
-
-bool CellularAutomata::IsInWater(int x, int y, int* lx, int* ly) {
-	if (InBounds(x, y) && (GetParticleAt(x, y).id == mat_id_water)) {
-		*lx = x; *ly = y;
-		return true;
-	}
-	if (InBounds(x, y - 1) && (GetParticleAt(x, y - 1).id == mat_id_water)) {
-		*lx = x; *ly = y - 1;
-		return true;
-	}
-	if (InBounds(x, y + 1) && (GetParticleAt(x, y + 1).id == mat_id_water)) {
-		*lx = x; *ly = y + 1;
-		return true;
-	}
-	if (InBounds(x - 1, y) && (GetParticleAt(x - 1, y).id == mat_id_water)) {
-		*lx = x - 1; *ly = y;
-		return true;
-	}
-	if (InBounds(x - 1, y - 1) && (GetParticleAt(x - 1, y - 1).id == mat_id_water)) {
-		*lx = x - 1; *ly = y - 1;
-		return true;
-	}
-	if (InBounds(x - 1, y + 1) && (GetParticleAt(x - 1, y + 1).id == mat_id_water)) {
-		*lx = x - 1; *ly = y + 1;
-		return true;
-	}
-	if (InBounds(x + 1, y) && (GetParticleAt(x + 1, y).id == mat_id_water)) {
-		*lx = x + 1; *ly = y;
-		return true;
-	}
-	if (InBounds(x + 1, y - 1) && (GetParticleAt(x + 1, y - 1).id == mat_id_water)) {
-		*lx = x + 1; *ly = y - 1;
-		return true;
-	}
-	if (InBounds(x + 1, y + 1) && (GetParticleAt(x + 1, y + 1).id == mat_id_water)) {
-		*lx = x + 1; *ly = y + 1;
-		return true;
-	}
-	return false;
-}
-
-inline float CellularAutomata::VectorDistance(Vector2 vec1, Vector2 vec2) {
-	float dx = (vec1.x - vec2.x);
-	float dy = (vec1.y - vec2.y);
-	return (std::sqrt(dx * dx + dy * dy));
 }
 
 void CellularAutomata::UploadToTexture()
@@ -1418,9 +723,10 @@ void CellularAutomata::UploadToTexture()
 		D3D12_RESOURCE_STATE_GENERIC_READ,
 		nullptr,
 		IID_PPV_ARGS(&textureUploadHeap)));
+	mUploadHeapBytes = uploadBufferSize;
 
 	D3D12_SUBRESOURCE_DATA textureData = {};
-	textureData.pData = ColorData.data();
+	textureData.pData = mSim.GetWorld().colors.data();
 	textureData.RowPitch = textureWidth * (sizeof(Color32));
 	textureData.SlicePitch = textureData.RowPitch * textureHeight;
 
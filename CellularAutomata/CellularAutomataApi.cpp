@@ -0,0 +1,285 @@
+#define CA_BUILD_API
+#include "CellularAutomataApi.h"
+
+#include "ParticleSim.h"
+#include "Quiescence.h"
+#include "Raycast.h"
+#include "Scenes.h"
+#include "WorldFile.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+static_assert(CA_MATERIAL_EMPTY == mat_id_empty && CA_MATERIAL_SAND == mat_id_sand &&
+	CA_MATERIAL_WATER == mat_id_water && CA_MATERIAL_STONE == mat_id_stone &&
+	CA_MATERIAL_FIRE == mat_id_fire && CA_MATERIAL_SMOKE == mat_id_smoke &&
+	CA_MATERIAL_STEAM == mat_id_steam && CA_MATERIAL_COUNT == mat_id_count,
+	"material ids of the C API have to match the simulation's");
+
+struct ca_world
+{
+	ca_world(uint32_t width, uint32_t height, uint32_t seed) : sim(width, height, seed) {}
+
+	ParticleSim sim;
+};
+
+struct ca_snapshot
+{
+	uint32_t width;
+	uint32_t height;
+	unsigned int frame;
+	std::vector<Particle> particles;
+};
+
+namespace
+{
+	// Run fn, false when it ran out of memory. No exception may leave
+	// through the C interface.
+	template<typename Fn>
+	bool Guarded(Fn fn)
+	{
+		try {
+			fn();
+			return true;
+		}
+		catch (const std::bad_alloc&) {
+			return false;
+		}
+	}
+}
+
+uint32_t ca_api_version(void)
+{
+	return CA_API_VERSION;
+}
+
+ca_world* ca_create(uint32_t width, uint32_t height, uint32_t seed)
+{
+	if (width < 2 || height < 2)
+		return nullptr;
+
+	// The world's planes are allocated in the constructor. The occupancy
+	// pyramid and the census are built right away too, so the later calls
+	// only keep them up to date.
+	std::unique_ptr<ca_world> world;
+	const bool ok = Guarded([&] {
+		world = std::make_unique<ca_world>(width, height, seed);
+		world->sim.Occupancy();
+		world->sim.Census();
+	});
+	return ok ? world.release() : nullptr;
+}
+
+void ca_destroy(ca_world* world)
+{
+	delete world;
+}
+
+int ca_build_test_scene(ca_world* world, uint32_t seed)
+{
+	return Guarded([&] { BuildTestScene(world->sim, seed); }) ? 1 : 0;
+}
+
+int ca_step(ca_world* world, uint32_t ticks, float dt)
+{
+	// the views only show the state after the call, so the colors of the
+	// ticks in between are never resolved
+	return Guarded([&] { world->sim.StepMany(ticks, dt); }) ? 1 : 0;
+}
+
+int ca_run_until_settled(ca_world* world, uint32_t max_ticks, float dt, uint32_t* settle_tick)
+{
+	SettleResult result;
+	if (!Guarded([&] { result = RunUntilSettled(world->sim, dt, max_ticks); }))
+		return -1;
+	if (result.settled && settle_tick != nullptr)
+		*settle_tick = result.settleTick;
+	return result.settled ? 1 : 0;
+}
+
+void ca_paint(ca_world* world, int32_t x, int32_t y, float radius, uint8_t material)
+{
+	if (material < mat_id_count)
+		world->sim.Paint(x, y, radius, material);
+}
+
+void ca_erase(ca_world* world, int32_t x, int32_t y, float radius)
+{
+	world->sim.Erase(x, y, radius);
+}
+
+int ca_clear(ca_world* world)
+{
+	return Guarded([&] { world->sim.Clear(); }) ? 1 : 0;
+}
+
+uint32_t ca_width(const ca_world* world)
+{
+	return world->sim.GetWorld().width;
+}
+
+uint32_t ca_height(const ca_world* world)
+{
+	return world->sim.GetWorld().height;
+}
+
+uint32_t ca_frame(const ca_world* world)
+{
+	return world->sim.FrameCounter();
+}
+
+int ca_get_cell(const ca_world* world, int32_t x, int32_t y, ca_cell* out)
+{
+	const World& w = world->sim.GetWorld();
+	if (x < 0 || y < 0 || static_cast<uint32_t>(x) >= w.width || static_cast<uint32_t>(y) >= w.height)
+		return 0;
+
+	const Particle& p = w.particles[static_cast<size_t>(y) * w.width + x];
+	out->material = p.id;
+	out->color[0] = p.color.r;
+	out->color[1] = p.color.g;
+	out->color[2] = p.color.b;
+	out->color[3] = p.color.a;
+	out->lifetime = p.life_time;
+	out->velocity[0] = p.velocity.x;
+	out->velocity[1] = p.velocity.y;
+	return 1;
+}
+
+void ca_count_materials(const ca_world* world, uint64_t* counts)
+{
+	size_t c[mat_id_count];
+	CountMaterials(world->sim.GetWorld(), c);
+	for (int i = 0; i < mat_id_count; ++i)
+		counts[i] = c[i];
+}
+
+uint32_t ca_raycast(ca_world* world, const ca_ray* rays, uint32_t count, const uint8_t* targets, ca_ray_hit* hits)
+{
+	MaterialSet set = FilledMaterials();
+	if (targets != nullptr) {
+		set.reset();
+		for (unsigned int id = 0; id < maxMaterials; ++id)
+			set[id] = (targets[id / 8] >> (id % 8)) & 1;
+	}
+
+	// one sync for the whole batch
+	const OccupancyPyramid* occupancy = nullptr;
+	if (!Guarded([&] { occupancy = &world->sim.Occupancy(); }))
+		return UINT32_MAX;
+	const World& w = world->sim.GetWorld();
+
+	uint32_t hitCount = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		const RayHit hit = CastRay(w, occupancy, rays[i].x0, rays[i].y0, rays[i].x1, rays[i].y1, set);
+		hits[i].hit = hit.hit ? 1 : 0;
+		hits[i].x = hit.x;
+		hits[i].y = hit.y;
+		hits[i].material = hit.material;
+		hits[i].steps = hit.steps;
+		hitCount += hits[i].hit;
+	}
+	return hitCount;
+}
+
+uint64_t ca_count_rect(ca_world* world, uint8_t material, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+	uint64_t count = UINT64_MAX;
+	Guarded([&] { count = world->sim.Census().Count(world->sim.GetWorld(), material, x0, y0, x1, y1); });
+	return count;
+}
+
+uint64_t ca_checksum(const ca_world* world)
+{
+	return ComputeChecksum(world->sim.GetWorld());
+}
+
+int ca_get_plane(const ca_world* world, ca_plane plane, ca_plane_view* out)
+{
+	const World& w = world->sim.GetWorld();
+	const unsigned char* particles = reinterpret_cast<const unsigned char*>(w.particles.data());
+
+	// the particle plane interleaves the fields, the views stride over it
+	out->width = w.width;
+	out->height = w.height;
+	out->cell_stride = sizeof(Particle);
+	switch (plane) {
+	case CA_PLANE_MATERIAL:
+		out->data = particles + offsetof(Particle, id);
+		out->element_size = sizeof(uint8_t);
+		break;
+	case CA_PLANE_LIFETIME:
+		out->data = particles + offsetof(Particle, life_time);
+		out->element_size = sizeof(float);
+		break;
+	case CA_PLANE_VELOCITY:
+		out->data = particles + offsetof(Particle, velocity);
+		out->element_size = sizeof(Vec2);
+		break;
+	case CA_PLANE_COLOR:
+		// the render copy of the colors is packed
+		out->data = w.colors.data();
+		out->cell_stride = sizeof(Color32);
+		out->element_size = sizeof(Color32);
+		break;
+	default:
+		return 0;
+	}
+	out->row_stride = out->cell_stride * w.width;
+	return 1;
+}
+
+ca_snapshot* ca_snapshot_take(const ca_world* world)
+{
+	const World& w = world->sim.GetWorld();
+	std::unique_ptr<ca_snapshot> snapshot;
+	try {
+		snapshot = std::make_unique<ca_snapshot>();
+		snapshot->particles = w.particles;
+	}
+	catch (const std::bad_alloc&) {
+		return nullptr;
+	}
+
+	snapshot->width = w.width;
+	snapshot->height = w.height;
+	snapshot->frame = world->sim.FrameCounter();
+	return snapshot.release();
+}
+
+int ca_snapshot_restore(ca_world* world, const ca_snapshot* snapshot)
+{
+	World& w = world->sim.GetWorld();
+	if (snapshot->width != w.width || snapshot->height != w.height)
+		return 0;
+
+	// copy in place so plane views stay valid
+	std::copy(snapshot->particles.begin(), snapshot->particles.end(), w.particles.begin());
+	for (size_t i = 0; i < w.particles.size(); ++i)
+		w.colors[i] = w.particles[i].color;
+	w.TouchAll();
+	world->sim.SetFrameCounter(snapshot->frame);
+	return 1;
+}
+
+void ca_snapshot_free(ca_snapshot* snapshot)
+{
+	delete snapshot;
+}
+
+int ca_save(const ca_world* world, const char* path)
+{
+	bool saved = false;
+	Guarded([&] { saved = SaveWorld(world->sim, path); });
+	return saved ? 1 : 0;
+}
+
+int ca_load(ca_world* world, const char* path)
+{
+	// the file is read into a buffer of the world's size first
+	bool loaded = false;
+	Guarded([&] { loaded = LoadWorld(world->sim, path); });
+	return loaded ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+/* Plain C interface to the simulation, for tools that wrap the engine from
+ * other languages. Only C types cross the boundary and structs only ever grow
+ * at the end, so a tool built against an older header keeps working; check
+ * ca_api_version() against CA_API_VERSION to catch a too old library.
+ *
+ * Plane views point straight into the world. They stay valid as long as the
+ * world does, and show the state after the last call that changed it. */
+#ifndef CELLULAR_AUTOMATA_API_H
+#define CELLULAR_AUTOMATA_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(CA_BUILD_API)
+#define CA_API __declspec(dllexport)
+#else
+#define CA_API __declspec(dllimport)
+#endif
+#else
+#define CA_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CA_API_VERSION 5
+
+/* material ids, the same as the values of the material plane */
+enum
+{
+	CA_MATERIAL_EMPTY = 0,
+	CA_MATERIAL_SAND = 1,
+	CA_MATERIAL_WATER = 2,
+	CA_MATERIAL_STONE = 3,
+	CA_MATERIAL_FIRE = 4,
+	CA_MATERIAL_SMOKE = 5,
+	CA_MATERIAL_STEAM = 6,
+	CA_MATERIAL_COUNT = 7
+};
+
+typedef struct ca_world ca_world;
+typedef struct ca_snapshot ca_snapshot;
+
+typedef enum ca_plane
+{
+	CA_PLANE_MATERIAL = 0,	/* uint8_t material id */
+	CA_PLANE_LIFETIME = 1,	/* float seconds the particle has lived */
+	CA_PLANE_VELOCITY = 2,	/* float x, float y */
+	CA_PLANE_COLOR = 3		/* uint8_t r, g, b, a */
+} ca_plane;
+
+/* Cell (x, y) of a plane is at data + y * row_stride + x * cell_stride. */
+typedef struct ca_plane_view
+{
+	const void* data;
+	size_t cell_stride;		/* bytes from one cell to the next in a row */
+	size_t row_stride;		/* bytes from one row to the next */
+	uint32_t width;
+	uint32_t height;
+	uint32_t element_size;	/* bytes of the value of one cell */
+} ca_plane_view;
+
+typedef struct ca_cell
+{
+	uint8_t material;
+	uint8_t color[4];
+	float lifetime;
+	float velocity[2];
+} ca_cell;
+
+/* A path between two cells, both ends included. */
+typedef struct ca_ray
+{
+	int32_t x0;
+	int32_t y0;
+	int32_t x1;
+	int32_t y1;
+} ca_ray;
+
+typedef struct ca_ray_hit
+{
+	int32_t hit;		/* nonzero when a cell stopped the ray */
+	int32_t x;
+	int32_t y;
+	uint8_t material;
+	uint32_t steps;		/* cells on the path before the one hit */
+} ca_ray_hit;
+
+CA_API uint32_t ca_api_version(void);
+
+/* An empty world; NULL when the size is invalid or memory runs out. */
+CA_API ca_world* ca_create(uint32_t width, uint32_t height, uint32_t seed);
+CA_API void ca_destroy(ca_world* world);
+
+/* No call lets an exception through. Calls that need memory report running
+ * out of it as described for each; the world may then be left part way
+ * through the change. */
+
+/* Replace the world with the test scene built from seed. Returns 1, or 0 when
+ * memory ran out (since version 5). */
+CA_API int ca_build_test_scene(ca_world* world, uint32_t seed);
+
+/* Advance ticks frames of dt seconds each. The color plane is only resolved
+ * after the last one, so large counts fast-forward cheaply. Returns 1, or 0
+ * when memory ran out (since version 5). */
+CA_API int ca_step(ca_world* world, uint32_t ticks, float dt);
+
+/* Advance frames until at most 1% of the cells changed material in each of 60
+ * ticks in a row and no fire, smoke or steam is left, or max_ticks passed. Returns 1 once settled,
+ * with the tick the world came to rest (counted from the call) in
+ * *settle_tick if that is not NULL, 0 when max_ticks ran out first and -1
+ * when memory ran out. Since version 2. */
+CA_API int ca_run_until_settled(ca_world* world, uint32_t max_ticks, float dt, uint32_t* settle_tick);
+
+CA_API void ca_paint(ca_world* world, int32_t x, int32_t y, float radius, uint8_t material);
+CA_API void ca_erase(ca_world* world, int32_t x, int32_t y, float radius);
+/* Returns 1, or 0 when memory ran out (since version 5). */
+CA_API int ca_clear(ca_world* world);
+
+CA_API uint32_t ca_width(const ca_world* world);
+CA_API uint32_t ca_height(const ca_world* world);
+CA_API uint32_t ca_frame(const ca_world* world);
+
+/* Nonzero when (x, y) is inside the world and out was filled. */
+CA_API int ca_get_cell(const ca_world* world, int32_t x, int32_t y, ca_cell* out);
+
+/* Cast count rays, filling hits[i] with the first cell on the path of rays[i]
+ * whose material is in targets. targets holds 256 bits, material id i being
+ * bit i % 8 of byte i / 8; NULL stops at any material but empty. Paths step
+ * one cell at a time through the cells the line between the cell centers
+ * crosses, and skip empty space in large steps, so thousands of rays a frame
+ * are cheap. Returns the number of rays that hit something, UINT32_MAX with
+ * hits left unfilled when memory ran out. Since version 3. */
+CA_API uint32_t ca_raycast(ca_world* world, const ca_ray* rays, uint32_t count, const uint8_t* targets, ca_ray_hit* hits);
+
+/* Cells of each material, counts has CA_MATERIAL_COUNT entries. */
+CA_API void ca_count_materials(const ca_world* world, uint64_t* counts);
+
+/* Cells of material in [x0, x1) x [y0, y1), clipped to the world. Counts
+ * kept per tile as the world changes answer most of it; only the cells of the
+ * tiles the edges cut through are read, so many queries a tick are cheap.
+ * UINT64_MAX when memory ran out. Since version 4. */
+CA_API uint64_t ca_count_rect(ca_world* world, uint8_t material, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+
+/* Hash of the material plane, equal worlds hash equal. */
+CA_API uint64_t ca_checksum(const ca_world* world);
+
+/* Nonzero when plane is known and out was filled. No copy is made. */
+CA_API int ca_get_plane(const ca_world* world, ca_plane plane, ca_plane_view* out);
+
+/* In memory copies of the world to go back to; a snapshot only restores
+ * into a world of the same size. Taking one gives NULL when memory runs out. */
+CA_API ca_snapshot* ca_snapshot_take(const ca_world* world);
+CA_API int ca_snapshot_restore(ca_world* world, const ca_snapshot* snapshot);
+CA_API void ca_snapshot_free(ca_snapshot* snapshot);
+
+/* World files, see WorldFile.h. Loading needs a world of the file's size. */
+CA_API int ca_save(const ca_world* world, const char* path);
+CA_API int ca_load(ca_world* world, const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
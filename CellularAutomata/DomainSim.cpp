@@ -0,0 +1,611 @@
+#include "DomainSim.h"
+#include "SharedMemory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr uint32_t domainMagic = 0x4D4F4443; // "CDOM"
+	constexpr size_t sectionAlign = 64;
+
+	struct DomainHeader
+	{
+		uint32_t magic;
+		uint32_t width;
+		uint32_t height;
+		uint32_t columns;
+		uint32_t rows;
+		uint32_t ticks;
+		float dt;
+		uint32_t outboxCapacity;
+
+		// sense reversing barrier shared by all workers
+		std::atomic<uint32_t> barrierCount;
+		std::atomic<uint32_t> barrierGeneration;
+
+		// set by the launcher when a worker dies, so the others stop waiting
+		std::atomic<uint32_t> failed;
+
+		// steady clock nanoseconds at which the workers passed the first and
+		// the last barrier of the run, stamped by worker 0
+		int64_t loopStart;
+		int64_t loopEnd;
+	};
+
+	static_assert(std::atomic<uint32_t>::is_always_lock_free, "barrier must work across processes");
+
+	// A halo cell a worker wrote while updating its own cells. The entries of
+	// one update follow each other and form a claim on the cells' owner.
+	struct MigrationEntry
+	{
+		uint64_t index;			// cell index in the whole world
+		uint32_t count;			// entries of the claim, on its first entry
+		uint8_t seen;			// material the worker saw there before the tick
+		uint8_t accepted;		// set on the first entry by the owner taking the claim
+		Particle particle;		// what it left there
+	};
+
+	struct Outbox
+	{
+		uint32_t count;
+		uint32_t pad[15];
+		MigrationEntry entries[1];
+	};
+
+	struct Rect
+	{
+		unsigned int x0, x1, y0, y1;
+
+		unsigned int Width() const { return x1 - x0; }
+		unsigned int Height() const { return y1 - y0; }
+		bool Contains(unsigned int x, unsigned int y) const { return x >= x0 && x < x1 && y >= y0 && y < y1; }
+	};
+
+	int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	size_t Align(size_t v)
+	{
+		return (v + sectionAlign - 1) & ~(sectionAlign - 1);
+	}
+
+	Rect DomainRect(const DomainHeader& h, unsigned int index)
+	{
+		const unsigned int cx = index % h.columns;
+		const unsigned int cy = index / h.columns;
+		Rect r;
+		r.x0 = static_cast<unsigned int>(uint64_t(h.width) * cx / h.columns);
+		r.x1 = static_cast<unsigned int>(uint64_t(h.width) * (cx + 1) / h.columns);
+		r.y0 = static_cast<unsigned int>(uint64_t(h.height) * cy / h.rows);
+		r.y1 = static_cast<unsigned int>(uint64_t(h.height) * (cy + 1) / h.rows);
+		return r;
+	}
+
+	// domain owning the world cell (x, y), the inverse of DomainRect
+	unsigned int DomainOf(const DomainHeader& h, unsigned int x, unsigned int y)
+	{
+		const unsigned int cx = static_cast<unsigned int>((uint64_t(x + 1) * h.columns - 1) / h.width);
+		const unsigned int cy = static_cast<unsigned int>((uint64_t(y + 1) * h.rows - 1) / h.height);
+		return cy * h.columns + cx;
+	}
+
+	Rect WindowRect(const DomainHeader& h, const Rect& owned)
+	{
+		Rect r;
+		r.x0 = owned.x0 > (unsigned int)updateReachX ? owned.x0 - updateReachX : 0;
+		r.y0 = owned.y0 > (unsigned int)updateReachY ? owned.y0 - updateReachY : 0;
+		r.x1 = std::min(owned.x1 + updateReachX, h.width);
+		r.y1 = std::min(owned.y1 + updateReachY, h.height);
+		return r;
+	}
+
+	size_t HaloCells(const Rect& window, const Rect& owned)
+	{
+		return size_t(window.Width()) * window.Height() - size_t(owned.Width()) * owned.Height();
+	}
+
+	// where things live inside the shared region
+	struct SharedLayout
+	{
+		size_t planeOffset;
+		size_t outboxOffset;
+		size_t outboxStride;
+		size_t totalSize;
+	};
+
+	SharedLayout ComputeLayout(const DomainHeader& h)
+	{
+		SharedLayout l;
+		l.planeOffset = Align(sizeof(DomainHeader));
+		l.outboxOffset = Align(l.planeOffset + sizeof(Particle) * size_t(h.width) * h.height);
+		l.outboxStride = Align(offsetof(Outbox, entries) + sizeof(MigrationEntry) * h.outboxCapacity);
+		l.totalSize = l.outboxOffset + l.outboxStride * h.columns * h.rows;
+		return l;
+	}
+
+	Outbox* GetOutbox(void* base, const SharedLayout& l, unsigned int index)
+	{
+		return reinterpret_cast<Outbox*>(static_cast<uint8_t*>(base) + l.outboxOffset + l.outboxStride * index);
+	}
+
+	// Returns false when the run was aborted.
+	bool Barrier(DomainHeader& h)
+	{
+		const unsigned int domains = h.columns * h.rows;
+		const uint32_t generation = h.barrierGeneration.load(std::memory_order_acquire);
+
+		if (h.barrierCount.fetch_add(1, std::memory_order_acq_rel) + 1 == domains) {
+			h.barrierCount.store(0, std::memory_order_relaxed);
+			h.barrierGeneration.fetch_add(1, std::memory_order_acq_rel);
+			return h.failed.load() == 0;
+		}
+
+		while (h.barrierGeneration.load(std::memory_order_acquire) == generation) {
+			if (h.failed.load() != 0)
+				return false;
+			std::this_thread::yield();
+		}
+		return h.failed.load() == 0;
+	}
+
+	// Calls fn(y, xBegin, xEnd) for the spans of window cells outside owned, in window coordinates.
+	template<typename Fn>
+	void ForEachHaloSpan(const Rect& window, const Rect& owned, Fn fn)
+	{
+		const unsigned int ox0 = owned.x0 - window.x0, ox1 = owned.x1 - window.x0;
+		const unsigned int oy0 = owned.y0 - window.y0, oy1 = owned.y1 - window.y0;
+
+		for (unsigned int y = 0; y < window.Height(); ++y) {
+			if (y < oy0 || y >= oy1) {
+				fn(y, 0u, window.Width());
+				continue;
+			}
+			if (ox0 > 0)
+				fn(y, 0u, ox0);
+			if (ox1 < window.Width())
+				fn(y, ox1, window.Width());
+		}
+	}
+
+	// Calls fn(y, xBegin, xEnd) for the spans of owned cells that lie in some neighbour's halo.
+	template<typename Fn>
+	void ForEachBorderSpan(const DomainHeader& h, const Rect& window, const Rect& owned, Fn fn)
+	{
+		const unsigned int ox0 = owned.x0 - window.x0, ox1 = owned.x1 - window.x0;
+		const unsigned int oy0 = owned.y0 - window.y0, oy1 = owned.y1 - window.y0;
+
+		const unsigned int top = owned.y0 > 0 ? std::min<unsigned int>(updateReachY, owned.Height()) : 0;
+		const unsigned int bottom = owned.y1 < h.height ? std::min<unsigned int>(updateReachY, owned.Height()) : 0;
+		const unsigned int left = owned.x0 > 0 ? std::min<unsigned int>(updateReachX, owned.Width()) : 0;
+		const unsigned int right = owned.x1 < h.width ? std::min<unsigned int>(updateReachX, owned.Width()) : 0;
+
+		for (unsigned int y = oy0; y < oy1; ++y) {
+			if (y < oy0 + top || y >= oy1 - bottom) {
+				fn(y, ox0, ox1);
+				continue;
+			}
+			if (left > 0)
+				fn(y, ox0, ox0 + left);
+			if (right > 0)
+				fn(y, std::max(ox0 + left, ox1 - right), ox1);
+		}
+	}
+
+	void CopyIn(World& local, const Rect& window, const Particle* plane, unsigned int worldWidth,
+		unsigned int y, unsigned int xBegin, unsigned int xEnd)
+	{
+		const Particle* src = plane + size_t(window.y0 + y) * worldWidth + window.x0;
+		const size_t row = size_t(y) * local.width;
+		for (unsigned int x = xBegin; x < xEnd; ++x) {
+			local.particles[row + x] = src[x];
+			local.colors[row + x] = src[x].color;
+			local.Touch(x, y);
+		}
+	}
+
+	void CopyOut(const World& local, const Rect& window, Particle* plane, unsigned int worldWidth,
+		unsigned int y, unsigned int xBegin, unsigned int xEnd)
+	{
+		Particle* dst = plane + size_t(window.y0 + y) * worldWidth + window.x0;
+		const size_t row = size_t(y) * local.width;
+		std::copy(local.particles.begin() + row + xBegin, local.particles.begin() + row + xEnd, dst + xBegin);
+	}
+
+	// Watches the updates of a worker's Step. An update that wrote halo cells
+	// moved something across the border, so its halo writes go to the outbox as
+	// a claim on their owner, and every cell it wrote is held as stone, which no
+	// rule moves or replaces, until the owner answered. The claim is then
+	// completed or rolled back as a whole. An update reaching into two
+	// neighbours at once cannot be answered by one owner and is undone on the
+	// spot.
+	class BorderJournal : public SimWriteObserver
+	{
+	public:
+		struct Write
+		{
+			uint32_t idx;		// cell of the local window
+			Particle before;
+			Particle after;
+		};
+
+		struct Claim
+		{
+			uint32_t firstWrite;
+			uint32_t writeCount;
+			uint32_t firstEntry;
+		};
+
+		BorderJournal(ParticleSim& sim, const DomainHeader& header, const Rect& owned, const Rect& window, Outbox* outbox)
+			: mSim(sim), mHeader(header), mOwned(owned), mWindow(window), mOutbox(outbox),
+			  mHeld(size_t(window.Width()) * window.Height(), 0)
+		{
+		}
+
+		// Start a tick: forget the claims of the last one.
+		void Begin(uint32_t stamp)
+		{
+			mStamp = stamp;
+			mOutbox->count = 0;
+			writes.clear();
+			claims.clear();
+		}
+
+		// true if cell idx was written by a claim or handed to one this tick
+		bool Held(uint32_t idx) const { return mHeld[idx] == mStamp; }
+		void Hold(uint32_t idx) { mHeld[idx] = mStamp; }
+
+		void CellWritten(uint32_t idx, const Particle& before) override
+		{
+			for (const Write& w : mPending)
+				if (w.idx == idx)
+					return;
+			mPending.push_back({ idx, before, before });
+			mCrossing = mCrossing || !mOwned.Contains(mWindow.x0 + idx % mWindow.Width(), mWindow.y0 + idx / mWindow.Width());
+		}
+
+		void UpdateDone() override
+		{
+			if (mCrossing)
+				Settle();
+			mPending.clear();
+			mCrossing = false;
+		}
+
+		std::vector<Write> writes;
+		std::vector<Claim> claims;
+
+	private:
+		void Settle()
+		{
+			const World& local = mSim.GetWorld();
+			bool single = true;
+			unsigned int owner = 0;
+			uint32_t halo = 0;
+			for (Write& w : mPending) {
+				w.after = local.particles[w.idx];
+				const unsigned int gx = mWindow.x0 + w.idx % mWindow.Width();
+				const unsigned int gy = mWindow.y0 + w.idx / mWindow.Width();
+				if (mOwned.Contains(gx, gy))
+					continue;
+				const unsigned int d = DomainOf(mHeader, gx, gy);
+				single = single && (halo == 0 || d == owner);
+				owner = d;
+				++halo;
+			}
+
+			// the journal's own writes are not an update
+			mSim.SetWriteObserver(nullptr);
+			if (!single) {
+				for (const Write& w : mPending)
+					mSim.WriteData(w.idx, w.before);
+			}
+			else {
+				const Claim claim = { static_cast<uint32_t>(writes.size()), static_cast<uint32_t>(mPending.size()), mOutbox->count };
+				for (const Write& w : mPending) {
+					const unsigned int gx = mWindow.x0 + w.idx % mWindow.Width();
+					const unsigned int gy = mWindow.y0 + w.idx / mWindow.Width();
+					if (!mOwned.Contains(gx, gy)) {
+						MigrationEntry& e = mOutbox->entries[mOutbox->count++];
+						e.index = size_t(gy) * mHeader.width + gx;
+						e.count = 0;
+						e.seen = w.before.id;
+						e.accepted = 0;
+						e.particle = w.after;
+						e.particle.has_been_updated_this_frame = false;
+					}
+					writes.push_back(w);
+					mSim.WriteData(w.idx, ParticleSim::ParticleStone());
+					Hold(w.idx);
+				}
+				mOutbox->entries[claim.firstEntry].count = halo;
+				claims.push_back(claim);
+			}
+			mSim.SetWriteObserver(this);
+		}
+
+		ParticleSim& mSim;
+		const DomainHeader& mHeader;
+		Rect mOwned;
+		Rect mWindow;
+		Outbox* mOutbox;
+
+		// tick stamp of the last tick each cell was held in
+		std::vector<uint32_t> mHeld;
+		uint32_t mStamp = 0;
+
+		// writes of the running update, the first one of every cell
+		std::vector<Write> mPending;
+		bool mCrossing = false;
+	};
+
+	bool SpawnWorkers(const std::string& name, unsigned int domains, DomainHeader& header)
+	{
+#ifdef _WIN32
+		char path[MAX_PATH];
+		GetModuleFileNameA(nullptr, path, MAX_PATH);
+
+		std::vector<HANDLE> processes;
+		for (unsigned int i = 0; i < domains; ++i) {
+			std::string cmd = "\"" + std::string(path) + "\" --domain-worker " + name + " " + std::to_string(i);
+
+			STARTUPINFOA si = { sizeof(si) };
+			PROCESS_INFORMATION pi = {};
+			if (!CreateProcessA(nullptr, &cmd[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &si, &pi)) {
+				header.failed.store(1);
+				break;
+			}
+			CloseHandle(pi.hThread);
+			processes.push_back(pi.hProcess);
+		}
+
+		// wait for whichever worker finishes first, so a crash releases the others right away
+		bool ok = processes.size() == domains;
+		while (!processes.empty()) {
+			const DWORD r = WaitForMultipleObjects(static_cast<DWORD>(processes.size()), processes.data(), FALSE, INFINITE);
+			const size_t i = r - WAIT_OBJECT_0;
+			if (i >= processes.size()) {
+				header.failed.store(1);
+				ok = false;
+				break;
+			}
+
+			DWORD code = 1;
+			GetExitCodeProcess(processes[i], &code);
+			if (code != 0) {
+				header.failed.store(1);
+				ok = false;
+			}
+			CloseHandle(processes[i]);
+			processes.erase(processes.begin() + i);
+		}
+		return ok;
+#else
+		std::vector<pid_t> children;
+		for (unsigned int i = 0; i < domains; ++i) {
+			pid_t pid = fork();
+			if (pid == 0)
+				_exit(RunDomainWorker(name, i));
+			if (pid < 0) {
+				header.failed.store(1);
+				break;
+			}
+			children.push_back(pid);
+		}
+
+		bool ok = children.size() == domains;
+		for (size_t remaining = children.size(); remaining > 0; --remaining) {
+			int status = 0;
+			if (waitpid(-1, &status, 0) < 0)
+				break;
+			if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+				header.failed.store(1);
+				ok = false;
+			}
+		}
+		return ok;
+#endif
+	}
+}
+
+bool RunDomainLauncher(World& world, const DomainConfig& config, double* loopSeconds)
+{
+	const unsigned int domains = config.columns * config.rows;
+	if (domains == 0 || config.columns > world.width || config.rows > world.height)
+		return false;
+
+#ifdef _WIN32
+	// the launcher waits on all workers at once
+	if (domains > MAXIMUM_WAIT_OBJECTS)
+		return false;
+#endif
+
+	DomainHeader proto = {};
+	proto.magic = domainMagic;
+	proto.width = world.width;
+	proto.height = world.height;
+	proto.columns = config.columns;
+	proto.rows = config.rows;
+	proto.ticks = config.ticks;
+	proto.dt = config.dt;
+
+	size_t capacity = 0;
+	for (unsigned int i = 0; i < domains; ++i) {
+		const Rect owned = DomainRect(proto, i);
+		capacity = std::max(capacity, HaloCells(WindowRect(proto, owned), owned));
+	}
+	proto.outboxCapacity = static_cast<uint32_t>(capacity);
+
+	const SharedLayout layout = ComputeLayout(proto);
+
+#ifdef _WIN32
+	const std::string name = "CellularAutomataDomains" + std::to_string(GetCurrentProcessId());
+#else
+	const std::string name = "CellularAutomataDomains" + std::to_string(getpid());
+#endif
+
+	SharedMemory shared;
+	if (!shared.Create(name, layout.totalSize))
+		return false;
+
+	DomainHeader* header = new (shared.Data()) DomainHeader();
+	header->magic = proto.magic;
+	header->width = proto.width;
+	header->height = proto.height;
+	header->columns = proto.columns;
+	header->rows = proto.rows;
+	header->ticks = proto.ticks;
+	header->dt = proto.dt;
+	header->outboxCapacity = proto.outboxCapacity;
+
+	Particle* plane = reinterpret_cast<Particle*>(static_cast<uint8_t*>(shared.Data()) + layout.planeOffset);
+	std::memcpy(plane, world.particles.data(), sizeof(Particle) * world.particles.size());
+
+	const bool ok = SpawnWorkers(name, domains, *header);
+	if (ok && loopSeconds != nullptr)
+		*loopSeconds = double(header->loopEnd - header->loopStart) * 1e-9;
+
+	if (ok) {
+		std::memcpy(world.particles.data(), plane, sizeof(Particle) * world.particles.size());
+		for (size_t i = 0; i < world.particles.size(); ++i)
+			world.colors[i] = world.particles[i].color;
+		world.TouchAll();
+	}
+
+	return ok;
+}
+
+int RunDomainWorker(const std::string& sharedName, unsigned int index)
+{
+	SharedMemory shared;
+	if (!shared.Open(sharedName))
+		return 1;
+
+	DomainHeader& header = *static_cast<DomainHeader*>(shared.Data());
+	if (header.magic != domainMagic || index >= header.columns * header.rows)
+		return 1;
+
+	const SharedLayout layout = ComputeLayout(header);
+	const unsigned int domains = header.columns * header.rows;
+	Particle* plane = reinterpret_cast<Particle*>(static_cast<uint8_t*>(shared.Data()) + layout.planeOffset);
+	Outbox* outbox = GetOutbox(shared.Data(), layout, index);
+
+	const Rect owned = DomainRect(header, index);
+	const Rect window = WindowRect(header, owned);
+
+	ParticleSim sim(window.Width(), window.Height(), index + 1);
+	World& local = sim.GetWorld();
+
+	for (unsigned int y = 0; y < window.Height(); ++y)
+		CopyIn(local, window, plane, header.width, y, 0, window.Width());
+
+	BorderJournal journal(sim, header, owned, window, outbox);
+
+	for (unsigned int tick = 0; tick < header.ticks; ++tick) {
+		if (tick > 0) {
+			ForEachHaloSpan(window, owned, [&](unsigned int y, unsigned int x0, unsigned int x1) {
+				CopyIn(local, window, plane, header.width, y, x0, x1);
+			});
+		}
+		journal.Begin(tick + 1);
+
+		// everyone has read their halo, owned cells may change now
+		if (!Barrier(header))
+			return 1;
+		if (tick == 0 && index == 0)
+			header.loopStart = Now();
+
+		sim.SetWriteObserver(&journal);
+		sim.Step(header.dt, owned.x0 - window.x0, owned.x1 - window.x0, owned.y0 - window.y0, owned.y1 - window.y0);
+		sim.SetWriteObserver(nullptr);
+
+		// claims are out
+		if (!Barrier(header))
+			return 1;
+
+		// Take a claim if every cell it names still holds the material the
+		// neighbour saw and no other claim of this tick wrote it. The material
+		// is all that has to match: the neighbour's side of the move holds what
+		// the cell held, so whatever particle of that material is replaced,
+		// nothing is made or lost.
+		for (unsigned int d = 0; d < domains; ++d) {
+			if (d == index)
+				continue;
+
+			Outbox* in = GetOutbox(shared.Data(), layout, d);
+			for (uint32_t k = 0; k < in->count; k += in->entries[k].count) {
+				MigrationEntry* claim = &in->entries[k];
+				if (!owned.Contains(static_cast<unsigned int>(claim->index % header.width), static_cast<unsigned int>(claim->index / header.width)))
+					continue;
+
+				bool free = true;
+				for (uint32_t j = 0; j < claim->count && free; ++j) {
+					const unsigned int lx = static_cast<unsigned int>(claim[j].index % header.width) - window.x0;
+					const unsigned int ly = static_cast<unsigned int>(claim[j].index / header.width) - window.y0;
+					const uint32_t i = ly * local.width + lx;
+					free = !journal.Held(i) && local.particles[i].id == claim[j].seen;
+				}
+				if (!free)
+					continue;
+
+				for (uint32_t j = 0; j < claim->count; ++j) {
+					const unsigned int lx = static_cast<unsigned int>(claim[j].index % header.width) - window.x0;
+					const unsigned int ly = static_cast<unsigned int>(claim[j].index / header.width) - window.y0;
+					sim.WriteData(ly * local.width + lx, claim[j].particle);
+					journal.Hold(ly * local.width + lx);
+				}
+				claim->accepted = 1;
+			}
+		}
+
+		// answers are in
+		if (!Barrier(header))
+			return 1;
+
+		// complete the accepted claims, roll back the rest
+		for (const BorderJournal::Claim& claim : journal.claims) {
+			const bool accepted = outbox->entries[claim.firstEntry].accepted != 0;
+			for (uint32_t j = 0; j < claim.writeCount; ++j) {
+				const BorderJournal::Write& w = journal.writes[claim.firstWrite + j];
+				Particle p = accepted ? w.after : w.before;
+				p.has_been_updated_this_frame = false;
+				sim.WriteData(w.idx, p);
+
+				const unsigned int x = w.idx % local.width, y = w.idx / local.width;
+				if (owned.Contains(window.x0 + x, window.y0 + y))
+					plane[size_t(window.y0 + y) * header.width + window.x0 + x] = p;
+			}
+		}
+
+		ForEachBorderSpan(header, window, owned, [&](unsigned int y, unsigned int x0, unsigned int x1) {
+			CopyOut(local, window, plane, header.width, y, x0, x1);
+		});
+
+		// owned border cells are final for this tick
+		if (!Barrier(header))
+			return 1;
+	}
+	if (index == 0 && header.ticks > 0)
+		header.loopEnd = Now();
+
+	for (unsigned int y = owned.y0 - window.y0; y < owned.y1 - window.y0; ++y)
+		CopyOut(local, window, plane, header.width, y, owned.x0 - window.x0, owned.x1 - window.x0);
+
+	return 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ParticleSim.h"
+
+#include <string>
+
+// Domain decomposed simulation: the world is split into a grid of tiles (a
+// single column gives horizontal strips) and every tile is simulated by its
+// own worker process. The launcher places the world in a shared memory region
+// that stands in for the cluster interconnect.
+//
+// Each worker keeps a window of its tile plus a halo of updateReachX columns
+// and updateReachY rows, the furthest a single update can read or write. Per
+// tick a worker
+//   1. refreshes its halo from the neighbours' border cells,
+//   2. updates the cells it owns. An update that writes halo cells moves
+//      something across the border; its halo writes are published as a claim
+//      on the cells' owner and the cells it wrote are held until the owner
+//      answered,
+//   3. answers the claims on its cells: one is taken, and written, if every
+//      cell it names still holds the material the neighbour saw and no other
+//      claim took the cell this tick,
+//   4. completes its taken claims, rolls back the others and publishes its
+//      border cells.
+// A move across a border therefore happens on both sides or on neither, and
+// the domains together keep every particle the single world would.
+struct DomainConfig
+{
+	unsigned int columns = 1;
+	unsigned int rows = 1;
+	unsigned int ticks = 600;
+	float dt = 1.0f / 60.0f;
+};
+
+// Simulate world with one process per domain and gather the result back into it.
+// loopSeconds, when given, receives the time the workers spent ticking, from
+// the first barrier to the last, without starting up and copying the world.
+bool RunDomainLauncher(World& world, const DomainConfig& config, double* loopSeconds = nullptr);
+
+// Entry point of a worker process started by the launcher.
+int RunDomainWorker(const std::string& sharedName, unsigned int index);
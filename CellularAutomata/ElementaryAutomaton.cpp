@@ -0,0 +1,159 @@
+#include "ElementaryAutomaton.h"
+
+#include <algorithm>
+
+namespace
+{
+	// all ones when bit is set, zero otherwise
+	inline uint64_t Broadcast(uint64_t value, unsigned int bit)
+	{
+		return 0 - ((value >> bit) & 1);
+	}
+
+	// per bit: m ? a : b
+	inline uint64_t Select(uint64_t m, uint64_t a, uint64_t b)
+	{
+		return b ^ ((a ^ b) & m);
+	}
+}
+
+ElementaryAutomaton::ElementaryAutomaton(unsigned int width)
+	: mWidth(width)
+{
+	const size_t words = (static_cast<size_t>(width) + 63) / 64;
+	mCells.assign(words, 0);
+	mNext.assign(words, 0);
+
+	const unsigned int tail = width & 63;
+	mLastWordMask = tail ? ((uint64_t(1) << tail) - 1) : ~uint64_t(0);
+
+	SeedSingle();
+}
+
+void ElementaryAutomaton::SetWolframRule(uint8_t rule)
+{
+	mType = RuleType::Wolfram;
+	mWolframRule = rule;
+	mRadius = 1;
+}
+
+void ElementaryAutomaton::SetTotalisticRule(unsigned int radius, uint64_t code)
+{
+	mType = RuleType::Totalistic;
+	mRadius = radius > MaxRadius ? MaxRadius : radius;
+	mTotalisticCode = code;
+}
+
+void ElementaryAutomaton::SeedSingle()
+{
+	std::fill(mCells.begin(), mCells.end(), 0);
+	const unsigned int mid = mWidth / 2;
+	mCells[mid >> 6] |= uint64_t(1) << (mid & 63);
+	mGeneration = 0;
+}
+
+void ElementaryAutomaton::SeedRandom(uint32_t seed)
+{
+	// splitmix64, one word of random bits per 64 cells
+	uint64_t state = seed;
+	for (auto& word : mCells) {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		word = z ^ (z >> 31);
+	}
+	mCells.back() &= mLastWordMask;
+	mGeneration = 0;
+}
+
+void ElementaryAutomaton::Step()
+{
+	if (mType == RuleType::Wolfram)
+		StepWolfram();
+	else
+		StepTotalistic();
+
+	mNext.back() &= mLastWordMask;
+	mCells.swap(mNext);
+	++mGeneration;
+}
+
+inline uint64_t ElementaryAutomaton::Neighbour(size_t i, int offset) const
+{
+	const uint64_t cur = mCells[i];
+	if (offset == 0)
+		return cur;
+
+	if (offset > 0) {
+		const uint64_t next = (i + 1 < mCells.size()) ? mCells[i + 1] : 0;
+		return (cur >> offset) | (next << (64 - offset));
+	}
+
+	const uint64_t prev = (i > 0) ? mCells[i - 1] : 0;
+	return (cur << -offset) | (prev >> (64 + offset));
+}
+
+void ElementaryAutomaton::StepWolfram()
+{
+	// Expand the eight rule bits into masks once, then every word is a
+	// three level multiplexer: right neighbour, centre, left neighbour.
+	uint64_t r[8];
+	for (unsigned int k = 0; k < 8; ++k)
+		r[k] = Broadcast(mWolframRule, k);
+
+	const size_t words = mCells.size();
+	for (size_t i = 0; i < words; ++i) {
+		const uint64_t L = Neighbour(i, -1);
+		const uint64_t C = mCells[i];
+		const uint64_t R = Neighbour(i, 1);
+
+		const uint64_t lc00 = Select(R, r[1], r[0]);
+		const uint64_t lc01 = Select(R, r[3], r[2]);
+		const uint64_t lc10 = Select(R, r[5], r[4]);
+		const uint64_t lc11 = Select(R, r[7], r[6]);
+
+		const uint64_t l0 = Select(C, lc01, lc00);
+		const uint64_t l1 = Select(C, lc11, lc10);
+
+		mNext[i] = Select(L, l1, l0);
+	}
+}
+
+void ElementaryAutomaton::StepTotalistic()
+{
+	// Bit sliced counter: plane b holds bit b of the neighbourhood sum for all
+	// 64 cells of a word. The sum is at most 2r + 1 <= 63, so six planes do.
+	const unsigned int n = 2 * mRadius + 1;
+	unsigned int planes = 1;
+	while ((1u << planes) <= n)
+		++planes;
+	mSum.assign(planes, 0);
+
+	const size_t words = mCells.size();
+	for (size_t i = 0; i < words; ++i) {
+		std::fill(mSum.begin(), mSum.end(), 0);
+
+		for (int d = -static_cast<int>(mRadius); d <= static_cast<int>(mRadius); ++d) {
+			uint64_t carry = Neighbour(i, d);
+			for (unsigned int b = 0; b < planes && carry; ++b) {
+				const uint64_t s = mSum[b];
+				mSum[b] = s ^ carry;
+				carry &= s;
+			}
+		}
+
+		// OR together the cells whose sum equals a live entry of the code
+		uint64_t out = 0;
+		for (unsigned int sum = 0; sum <= n; ++sum) {
+			if (!((mTotalisticCode >> sum) & 1))
+				continue;
+
+			uint64_t eq = ~uint64_t(0);
+			for (unsigned int b = 0; b < planes; ++b)
+				eq &= ((sum >> b) & 1) ? mSum[b] : ~mSum[b];
+			out |= eq;
+		}
+
+		mNext[i] = out;
+	}
+}
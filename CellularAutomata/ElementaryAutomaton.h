@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One dimensional, two state cellular automaton.
+//
+// Cells are packed 64 per word (bit j of word i is cell 64 * i + j) and every
+// step evaluates a whole word at once: neighbours are produced with shifts and
+// the new state is looked up from the rule with bitwise selects, so there are
+// no per-cell branches. Cells outside the row are treated as dead.
+class ElementaryAutomaton
+{
+public:
+	enum class RuleType
+	{
+		Wolfram = 0,	// elementary rules 0..255 (radius 1)
+		Totalistic		// totalistic rules of arbitrary radius, the centre cell counted in the sum
+	};
+
+	// Largest supported totalistic radius. The neighbourhood sum (2r + 1 cells)
+	// has to fit into the 64 bit rule code.
+	static constexpr unsigned int MaxRadius = 31;
+
+	explicit ElementaryAutomaton(unsigned int width);
+
+	// Wolfram code: bit (l << 2 | c << 1 | r) is the next state of the pattern.
+	void SetWolframRule(uint8_t rule);
+
+	// Totalistic code: bit n is the next state when n cells of the 2r + 1
+	// neighbourhood (the cell included) are alive.
+	void SetTotalisticRule(unsigned int radius, uint64_t code);
+
+	void SeedSingle();				// one live cell in the middle
+	void SeedRandom(uint32_t seed);	// each cell alive with probability 1/2
+
+	void Step();
+
+	// Writes the current row as colors (alive / dead), width entries.
+	template<typename T>
+	void ResolveRow(T* dst, const T& alive, const T& dead) const
+	{
+		for (unsigned int x = 0; x < mWidth; ++x)
+			dst[x] = ((mCells[x >> 6] >> (x & 63)) & 1) ? alive : dead;
+	}
+
+	unsigned int Width() const { return mWidth; }
+	RuleType Type() const { return mType; }
+	uint8_t WolframRule() const { return mWolframRule; }
+	unsigned int Radius() const { return mRadius; }
+	uint64_t TotalisticCode() const { return mTotalisticCode; }
+	uint64_t Generation() const { return mGeneration; }
+
+private:
+	void StepWolfram();
+	void StepTotalistic();
+
+	// Word i of the row shifted so that bit j holds cell (64 * i + j + offset).
+	uint64_t Neighbour(size_t i, int offset) const;
+
+	unsigned int mWidth;
+	uint64_t mLastWordMask;
+
+	std::vector<uint64_t> mCells;
+	std::vector<uint64_t> mNext;
+
+	// bit planes of the neighbourhood sum used by the totalistic step
+	std::vector<uint64_t> mSum;
+
+	RuleType mType = RuleType::Wolfram;
+	uint8_t mWolframRule = 30;
+	unsigned int mRadius = 1;
+	uint64_t mTotalisticCode = 0;
+	uint64_t mGeneration = 0;
+};
@@ -0,0 +1,79 @@
+#include "FrameGovernor.h"
+
+#include <chrono>
+
+namespace
+{
+	// weight of the newest step in the moving average
+	constexpr double averageWeight = 0.1;
+
+	// steps to wait after a change before degrading further, and before restoring
+	constexpr unsigned int degradeDelay = 10;
+	constexpr unsigned int restoreDelay = 60;
+
+	// a level is restored once the average falls below this share of the budget
+	constexpr double restoreHeadroom = 0.6;
+}
+
+FrameGovernor::FrameGovernor(double budgetMs)
+	: mBudgetMs(budgetMs)
+{
+}
+
+SimQuality FrameGovernor::QualityForLevel(unsigned int level)
+{
+	SimQuality quality;
+	if (level >= 1) {
+		quality.quietChunkDivisor = 2;
+		quality.colorChurn = false;
+	}
+	if (level >= 2) {
+		quality.quietChunkDivisor = 4;
+		quality.quietMoves = 4;
+		quality.quietChunkBudget = 256;
+		quality.maxEmissions = 512;
+	}
+	if (level >= 3) {
+		quality.quietChunkDivisor = 8;
+		quality.quietMoves = 16;
+		quality.quietChunkBudget = 64;
+		quality.maxEmissions = 64;
+	}
+	return quality;
+}
+
+void FrameGovernor::Step(ParticleSim& sim, float dt)
+{
+	const auto start = std::chrono::steady_clock::now();
+	sim.Step(dt);
+	Record(sim, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+void FrameGovernor::StepMany(ParticleSim& sim, unsigned int ticks, float dt)
+{
+	const auto start = std::chrono::steady_clock::now();
+	sim.StepMany(ticks, dt);
+	Record(sim, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), ticks);
+}
+
+void FrameGovernor::Record(ParticleSim& sim, double ms, unsigned int steps)
+{
+	if (steps == 0)
+		return;
+	mStepsAtLevel[mLevel] += steps;
+	ms /= steps;
+	mAverageMs = mAverageMs == 0.0 ? ms : mAverageMs + (ms - mAverageMs) * averageWeight;
+	++mSinceChange;
+
+	unsigned int level = mLevel;
+	if (mAverageMs > mBudgetMs && level + 1 < levelCount && mSinceChange >= degradeDelay)
+		++level;
+	else if (mAverageMs < mBudgetMs * restoreHeadroom && level > 0 && mSinceChange >= restoreDelay)
+		--level;
+
+	if (level != mLevel) {
+		mLevel = level;
+		mSinceChange = 0;
+		sim.SetQuality(QualityForLevel(level));
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ParticleSim.h"
+
+// Keeps the time a Step takes within a budget. While the average step runs
+// over it, the governor lowers the sim's quality one level at a time: quiet
+// chunks update less often, the cosmetic colour flicker stops and reactions
+// spawn fewer particles. Once steps fit comfortably again it restores the
+// levels one by one.
+class FrameGovernor
+{
+public:
+	static constexpr unsigned int levelCount = 4;
+
+	explicit FrameGovernor(double budgetMs = 8.0);
+
+	void SetBudget(double ms) { mBudgetMs = ms; }
+	double Budget() const { return mBudgetMs; }
+
+	// Step sim once, timing it, and choose the quality of its next step.
+	void Step(ParticleSim& sim, float dt);
+
+	// The same for a fast-forwarded frame of ticks steps (see ParticleSim::StepMany).
+	void StepMany(ParticleSim& sim, unsigned int ticks, float dt);
+
+	// Account for steps steps that took ms milliseconds together, timed by
+	// the caller. The budget and the average are per step.
+	void Record(ParticleSim& sim, double ms, unsigned int steps = 1);
+
+	// 0 is full quality, levelCount - 1 the cheapest
+	unsigned int Level() const { return mLevel; }
+	static SimQuality QualityForLevel(unsigned int level);
+
+	// moving average of the step time
+	double AverageMs() const { return mAverageMs; }
+
+	// steps taken at each level so far
+	unsigned int StepsAtLevel(unsigned int level) const { return mStepsAtLevel[level]; }
+
+private:
+	double mBudgetMs;
+	double mAverageMs = 0.0;
+	unsigned int mLevel = 0;
+
+	// steps since the level last changed, so a change shows in the average
+	// before the next one
+	unsigned int mSinceChange = 0;
+	unsigned int mStepsAtLevel[levelCount] = {};
+};
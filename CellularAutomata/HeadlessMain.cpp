@@ -0,0 +1,1119 @@
+// Console front end for running the simulation without a window.
+//
+//   CellularAutomataHeadless [--width W] [--height H] [--ticks N] [--seed S] [--scene NAME]
+//                            [--domains N | --tiles CxR] [--history N] [--history-every N]
+//                            [--load FILE] [--snapshot-every N] [--snapshot FILE]
+//                            [--export NAME] [--serve PORT]
+//                            [--plugin FILE] [--drop MATERIAL] [--counters]
+//                            [--memory] [--history-budget MB] [--budget MS]
+//                            [--fast-forward N] [--until-settled] [--sparse-map SIZE]
+//                            [--occupancy] [--rays N] [--rect-counts N]
+//   CellularAutomataHeadless --bench-kernels [--passes N]
+//   CellularAutomataHeadless --scaling [--threads N] [--sizes WxH,...] [--ticks N] [--out FILE]
+//   CellularAutomataHeadless --watch NAME
+//   CellularAutomataHeadless --view HOST:PORT
+//   CellularAutomataHeadless --lockstep-host PORT [--clients N] [--width W] [--height H] [--ticks N] [--seed S]
+//   CellularAutomataHeadless --lockstep HOST:PORT [--desync-at T]
+//   CellularAutomataHeadless --sweep key=values [--sweep ...] [--threads N] [--out dir]
+
+#include "AsyncSnapshot.h"
+#include "BatchRunner.h"
+#include "DomainSim.h"
+#include "FrameGovernor.h"
+#include "KernelBench.h"
+#include "Lockstep.h"
+#include "MaterialTable.h"
+#include "MemoryReport.h"
+#include "ParticleSim.h"
+#include "PerfCounters.h"
+#include "QuadtreeWorld.h"
+#include "Quiescence.h"
+#include "Raycast.h"
+#include "ScalingBench.h"
+#include "Scenes.h"
+#include "ThreadPool.h"
+#include "WorldExport.h"
+#include "WorldFile.h"
+#include "WorldHistory.h"
+#include "WorldStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		unsigned int width = 800;
+		unsigned int height = 600;
+		unsigned int ticks = 600;
+		unsigned int seed = 1;
+		std::string scene = "test";
+		unsigned int columns = 1;
+		unsigned int rows = 1;
+		unsigned int history = 0;
+		unsigned int historyEvery = 1;	// ticks between captures
+		size_t historyBudget = 0;		// bytes, 0 for no limit
+		bool memory = false;
+		bool occupancy = false;			// draw the occupancy pyramid at the end
+		unsigned int rays = 0;			// random rays to cast at the end
+		unsigned int rectCounts = 0;	// random rectangles to count materials in at the end
+		double budgetMs = 0.0;			// step time the governor keeps to, 0 for full quality
+		unsigned int fastForward = 1;	// ticks per published frame
+		bool untilSettled = false;		// stop once the world stopped changing, with ticks as the cap
+		unsigned int sparseMap = 0;		// side of a quadtree map the world is simulated as a window of
+
+		// material plugins, and a material to drop over the scene
+		std::vector<std::string> plugins;
+		std::string drop;
+
+		// hardware counters per phase of the frame
+		bool counters = false;
+
+		// scaling benchmark
+		bool scaling = false;
+		std::string sizes = "800x600,1600x1200,4096x4096,8192x8192,16384x16384";
+		bool ticksGiven = false;
+		bool outGiven = false;
+
+		// world files
+		std::string load;
+		std::string snapshot = "snapshot.caw";
+		bool snapshotGiven = false;
+		unsigned int snapshotEvery = 0;
+
+		// shared memory export of the live world
+		std::string exportName;
+
+		// TCP stream of the world, paced to real time
+		unsigned int servePort = 0;
+
+		// lockstep session, hosted or joined
+		unsigned int lockstepHostPort = 0;
+		unsigned int lockstepClients = 2;
+		std::string lockstepAddress;
+		long long desyncAt = -1;
+
+		// parameter sweep
+		struct Sweep
+		{
+			std::string key;
+			std::vector<double> values;
+		};
+		std::vector<Sweep> sweeps;
+		bool sweepSizeGiven = false;
+		unsigned int threads = 0;
+		float settleFraction = BatchJob().settleFraction;
+		std::string out = "sweep";
+	};
+
+	// Parse "v1,v2,v3" or "first:last:step" into values.
+	bool ParseValues(const char* text, std::vector<double>& values)
+	{
+		double first, last, step;
+		char tail;
+		if (std::sscanf(text, "%lf:%lf:%lf%c", &first, &last, &step, &tail) == 3) {
+			if (step <= 0.0 || last < first)
+				return false;
+			for (int i = 0; first + i * step <= last + step * 1e-6; ++i)
+				values.push_back(first + i * step);
+			return true;
+		}
+
+		const char* p = text;
+		while (*p) {
+			char* end;
+			values.push_back(std::strtod(p, &end));
+			if (end == p || (*end != ',' && *end != 0))
+				return false;
+			p = *end ? end + 1 : end;
+		}
+		return !values.empty();
+	}
+
+	// Apply one swept value to a job, false for an unknown key.
+	bool ApplySweepValue(BatchJob& job, const std::string& key, double value)
+	{
+		MaterialParams& mp = job.materials;
+
+		if (key == "gravity") job.gravity = static_cast<float>(value);
+		else if (key == "seed") job.seed = static_cast<unsigned int>(value);
+		else if (key == "water_fall_rate") mp.waterFallRate = static_cast<int>(value);
+		else if (key == "water_spread_rate") mp.waterSpreadRate = static_cast<int>(value);
+		else if (key == "fire_burnout_age") mp.fireBurnoutAge = static_cast<float>(value);
+		else if (key == "fire_burnout_chance") mp.fireBurnoutChance = static_cast<int>(value);
+		else if (key == "smoke_lifetime") mp.smokeLifetime = static_cast<float>(value);
+		else if (key == "steam_lifetime") mp.steamLifetime = static_cast<float>(value);
+		else
+			return false;
+		return true;
+	}
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: CellularAutomataHeadless [options]\n"
+			"  --width W       world width in cells (800)\n"
+			"  --height H      world height in cells (600)\n"
+			"  --ticks N       frames to simulate (600)\n"
+			"  --seed S        seed of the scene (1)\n"
+			"  --scene NAME    test (hand placed blobs) or terrain (generated landscape)\n"
+			"  --domains N     simulate N horizontal strips in separate processes\n"
+			"  --tiles CxR     simulate C x R tiles in separate processes\n"
+			"  --history N     keep the last N frames for rewind and check rewinding at the end\n"
+			"  --history-every N  capture a history frame every N ticks (1)\n"
+			"  --history-budget MB  compress, then drop, history frames beyond MB megabytes\n"
+			"  --memory        print the memory each part of the run holds at the end\n"
+			"  --occupancy     draw the world from a coarse level of its occupancy pyramid at the end\n"
+			"  --rays N        time N random rays through the final world, with and without the pyramid\n"
+			"  --rect-counts N  time N material counts of random rectangles, from the census and by reading cells\n"
+			"  --budget MS     lower the sim's quality while steps take longer than MS\n"
+			"  --fast-forward N  run N ticks per published frame, resolving colors only for that frame\n"
+			"  --until-settled stop as soon as the world settled, running at most --ticks ticks\n"
+			"  --sparse-map SIZE  keep the world as a window in the middle of a SIZE x SIZE quadtree map\n"
+			"  --load FILE     start from a world file instead of the test scene\n"
+			"  --snapshot-every N  save the world every N ticks in the background\n"
+			"  --snapshot FILE file the background snapshots go to (snapshot.caw)\n"
+			"  --plugin FILE   load the materials of a material plugin (repeatable)\n"
+			"  --drop MATERIAL drop blobs of the named material over the scene\n"
+			"  --counters      measure cycles, instructions, cache and branch misses per phase\n"
+			"  --export NAME   publish every tick in shared memory region NAME\n"
+			"  --watch NAME    follow the world another run exports as NAME\n"
+			"  --serve PORT    stream every tick to viewers on localhost:PORT, at 60 ticks/s\n"
+			"  --view H:P      follow the world a server streams from H:P\n"
+			"  --bench-kernels [--passes N]  time every particle rule on its own (500 passes)\n"
+			"\n"
+			"lockstep session (every client simulates, only inputs travel):\n"
+			"  --lockstep-host PORT  relay a session for --clients N clients (2) of --ticks\n"
+			"                  ticks, starting from the test scene of --seed in --width x --height\n"
+			"  --lockstep H:P  join the session at H:P as a client painting at random\n"
+			"  --desync-at T   change cells behind the session's back after tick T (testing)\n"
+			"\n"
+			"parameter sweep (one world per combination of the swept values):\n"
+			"  --sweep K=V     sweep key K over V = v1,v2,... or first:last:step\n"
+			"                  keys: gravity seed water_fall_rate water_spread_rate\n"
+			"                  fire_burnout_age fire_burnout_chance smoke_lifetime steam_lifetime\n"
+			"  --threads N     worlds simulated at once (hardware threads)\n"
+			"  --settle F      settled once at most F of the cells change per tick for a second (0.01)\n"
+			"  --out DIR       directory for summary.csv and the population curves (sweep)\n"
+			"  sweeps default to 200x150 worlds and stop after --ticks or once settled\n"
+			"\n"
+			"scaling benchmark (domain decomposed runs of the test scene):\n"
+			"  --scaling       strong scaling over 1..--threads strips for every size, and weak\n"
+			"                  scaling with one strip of the first size per thread\n"
+			"  --sizes LIST    world sizes WxH,WxH,... (800x600 doubling up to 16384x16384)\n"
+			"                  sizes that do not fit into memory are skipped\n"
+			"  scaling runs --ticks ticks (30) and writes --out (scaling.json)\n");
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& o)
+	{
+		for (int i = 1; i < argc; ++i) {
+			const char* arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+
+			if (!std::strcmp(arg, "--width") && hasValue) { o.width = std::atoi(argv[++i]); o.sweepSizeGiven = true; }
+			else if (!std::strcmp(arg, "--height") && hasValue) { o.height = std::atoi(argv[++i]); o.sweepSizeGiven = true; }
+			else if (!std::strcmp(arg, "--ticks") && hasValue) { o.ticks = std::atoi(argv[++i]); o.ticksGiven = true; }
+			else if (!std::strcmp(arg, "--seed") && hasValue) o.seed = std::atoi(argv[++i]);
+			else if (!std::strcmp(arg, "--scene") && hasValue) o.scene = argv[++i];
+			else if (!std::strcmp(arg, "--domains") && hasValue) { o.columns = 1; o.rows = std::atoi(argv[++i]); }
+			else if (!std::strcmp(arg, "--tiles") && hasValue) {
+				if (std::sscanf(argv[++i], "%ux%u", &o.columns, &o.rows) != 2)
+					return false;
+			}
+			else if (!std::strcmp(arg, "--sweep") && hasValue) {
+				const char* spec = argv[++i];
+				const char* eq = std::strchr(spec, '=');
+				if (eq == nullptr)
+					return false;
+
+				Options::Sweep sweep;
+				sweep.key.assign(spec, eq);
+				BatchJob probe;
+				if (!ApplySweepValue(probe, sweep.key, 0.0) || !ParseValues(eq + 1, sweep.values))
+					return false;
+				o.sweeps.push_back(sweep);
+			}
+			else if (!std::strcmp(arg, "--settle") && hasValue) o.settleFraction = static_cast<float>(std::atof(argv[++i]));
+			else if (!std::strcmp(arg, "--load") && hasValue) o.load = argv[++i];
+			else if (!std::strcmp(arg, "--snapshot") && hasValue) { o.snapshot = argv[++i]; o.snapshotGiven = true; }
+			else if (!std::strcmp(arg, "--snapshot-every") && hasValue) o.snapshotEvery = std::atoi(argv[++i]);
+			else if (!std::strcmp(arg, "--export") && hasValue) o.exportName = argv[++i];
+			else if (!std::strcmp(arg, "--serve") && hasValue) o.servePort = std::atoi(argv[++i]);
+			else if (!std::strcmp(arg, "--lockstep-host") && hasValue) o.lockstepHostPort = std::atoi(argv[++i]);
+			else if (!std::strcmp(arg, "--clients") && hasValue) o.lockstepClients = std::atoi(argv[++i]);
+			else if (!std::strcmp(arg, "--lockstep") && hasValue) o.lockstepAddress = argv[++i];
+			else if (!std::strcmp(arg, "--desync-at") && hasValue) o.desyncAt = std::atoll(argv[++i]);
+			else if (!std::strcmp(arg, "--plugin") && hasValue) o.plugins.push_back(argv[++i]);
+			else if (!std::strcmp(arg, "--drop") && hasValue) o.drop = argv[++i];
+			else if (!std::strcmp(arg, "--counters")) o.counters = true;
+			else if (!std::strcmp(arg, "--memory")) o.memory = true;
+			else if (!std::strcmp(arg, "--occupancy")) o.occupancy = true;
+			else if (!std::strcmp(arg, "--rect-counts") && hasValue) o.rectCounts = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+			else if (!std::strcmp(arg, "--rays") && hasValue) o.rays = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+			else if (!std::strcmp(arg, "--budget") && hasValue) o.budgetMs = std::atof(argv[++i]);
+			else if (!std::strcmp(arg, "--until-settled")) o.untilSettled = true;
+			else if (!std::strcmp(arg, "--sparse-map") && hasValue) o.sparseMap = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+			else if (!std::strcmp(arg, "--fast-forward") && hasValue) o.fastForward = std::max(std::atoi(argv[++i]), 1);
+			else if (!std::strcmp(arg, "--history-every") && hasValue) o.historyEvery = std::max(std::atoi(argv[++i]), 1);
+			else if (!std::strcmp(arg, "--history-budget") && hasValue) o.historyBudget = static_cast<size_t>(std::atof(argv[++i]) * 1048576.0);
+			else if (!std::strcmp(arg, "--history") && hasValue) o.history = std::atoi(argv[++i]);
+			else if (!std::strcmp(arg, "--threads") && hasValue) o.threads = std::atoi(argv[++i]);
+			else if (!std::strcmp(arg, "--out") && hasValue) { o.out = argv[++i]; o.outGiven = true; }
+			else if (!std::strcmp(arg, "--scaling")) o.scaling = true;
+			else if (!std::strcmp(arg, "--sizes") && hasValue) o.sizes = argv[++i];
+			else
+				return false;
+		}
+		return o.width > 1 && o.height > 1 && o.columns > 0 && o.rows > 0;
+	}
+
+	void PrintSummary(const World& world, unsigned int ticks, double seconds)
+	{
+		size_t counts[mat_id_count] = {};
+		CountMaterials(world, counts);
+
+		const double cells = double(world.width) * world.height * ticks;
+		std::printf("%u ticks of %ux%u in %.3f s (%.1f ticks/s, %.1f Mcells/s)\n",
+			ticks, world.width, world.height, seconds, ticks / seconds, cells / seconds / 1e6);
+		std::printf("sand %zu water %zu stone %zu fire %zu smoke %zu steam %zu\n",
+			counts[mat_id_sand], counts[mat_id_water], counts[mat_id_stone],
+			counts[mat_id_fire], counts[mat_id_smoke], counts[mat_id_steam]);
+		std::printf("checksum %016llx\n", static_cast<unsigned long long>(ComputeChecksum(world)));
+	}
+
+	// The world zoomed out to the first pyramid level at most 100 nodes wide,
+	// read from the node flags alone: blank where a node holds nothing, '#'
+	// where it holds only stone and '~' where something can move.
+	void PrintOccupancy(const OccupancyPyramid& occupancy)
+	{
+		unsigned int level = 0;
+		while (level + 1 < occupancy.Levels() && occupancy.LevelWidth(level) > 100)
+			++level;
+
+		const unsigned int side = OccupancyPyramid::tileSize << level;
+		std::printf("occupancy level %u of %u, %ux%u cells per character\n", level, occupancy.Levels(), side, side);
+		std::string line;
+		for (unsigned int ny = 0; ny < occupancy.LevelHeight(level); ++ny) {
+			line.clear();
+			for (unsigned int nx = 0; nx < occupancy.LevelWidth(level); ++nx) {
+				const uint8_t flags = occupancy.Node(level, nx, ny);
+				line += (flags & OccupancyPyramid::dynamic) ? '~' : (flags & OccupancyPyramid::filled) ? '#' : ' ';
+			}
+			std::printf("|%s|\n", line.c_str());
+		}
+	}
+
+	// Cast count rays between random cells at anything filled, once skipping
+	// through the occupancy pyramid and once reading every cell, which have to
+	// agree.
+	void BenchRays(ParticleSim& sim, unsigned int count, uint32_t seed)
+	{
+		const World& world = sim.GetWorld();
+		std::mt19937 random(seed);
+		std::vector<int> ends(size_t(count) * 4);
+		for (size_t i = 0; i < ends.size(); i += 2) {
+			ends[i] = static_cast<int>(random() % world.width);
+			ends[i + 1] = static_cast<int>(random() % world.height);
+		}
+
+		const MaterialSet targets = FilledMaterials();
+		const OccupancyPyramid* modes[2] = { &sim.Occupancy(), nullptr };
+		std::vector<RayHit> hits[2];
+		double seconds[2];
+		for (int m = 0; m < 2; ++m) {
+			const auto begin = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < ends.size(); i += 4)
+				hits[m].push_back(CastRay(world, modes[m], ends[i], ends[i + 1], ends[i + 2], ends[i + 3], targets));
+			seconds[m] = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		}
+
+		size_t hitCount = 0;
+		size_t steps = 0;
+		bool agree = true;
+		for (size_t i = 0; i < hits[0].size(); ++i) {
+			const RayHit& a = hits[0][i];
+			const RayHit& b = hits[1][i];
+			agree = agree && a.hit == b.hit && a.x == b.x && a.y == b.y && a.steps == b.steps;
+			hitCount += a.hit;
+			steps += a.steps;
+		}
+		std::printf("%u rays, %zu hit after %.1f cells on average: %.3f us per ray with the pyramid, %.3f us reading every cell, %s\n",
+			count, hitCount, double(steps) / count, seconds[0] * 1e6 / count, seconds[1] * 1e6 / count,
+			agree ? "same hits" : "HITS DIFFER");
+	}
+
+	// Count a random material in count random rectangles, once from the census
+	// and once reading the cells, which have to agree.
+	void BenchRectCounts(ParticleSim& sim, unsigned int count, uint32_t seed)
+	{
+		const World& world = sim.GetWorld();
+		std::mt19937 random(seed);
+		std::vector<int> rects(size_t(count) * 5);
+		for (size_t i = 0; i < rects.size(); i += 5) {
+			rects[i] = static_cast<int>(random() % world.width);
+			rects[i + 1] = static_cast<int>(random() % world.height);
+			rects[i + 2] = rects[i] + 1 + static_cast<int>(random() % (world.width - rects[i]));
+			rects[i + 3] = rects[i + 1] + 1 + static_cast<int>(random() % (world.height - rects[i + 1]));
+			rects[i + 4] = static_cast<int>(1 + random() % (mat_id_count - 1));
+		}
+
+		const auto begin = std::chrono::steady_clock::now();
+		const MaterialCensus& census = sim.Census();
+		std::vector<size_t> counted;
+		for (size_t i = 0; i < rects.size(); i += 5)
+			counted.push_back(census.Count(world, uint8_t(rects[i + 4]), rects[i], rects[i + 1], rects[i + 2], rects[i + 3]));
+		const auto middle = std::chrono::steady_clock::now();
+
+		bool agree = true;
+		size_t cells = 0;
+		for (size_t i = 0, k = 0; i < rects.size(); i += 5, ++k) {
+			size_t n = 0;
+			for (int y = rects[i + 1]; y < rects[i + 3]; ++y)
+				for (int x = rects[i]; x < rects[i + 2]; ++x)
+					n += world.particles[size_t(y) * world.width + x].id == rects[i + 4];
+			agree = agree && n == counted[k];
+			cells += size_t(rects[i + 2] - rects[i]) * (rects[i + 3] - rects[i + 1]);
+		}
+		const auto end = std::chrono::steady_clock::now();
+
+		const double censusUs = std::chrono::duration<double, std::micro>(middle - begin).count() / count;
+		const double scanUs = std::chrono::duration<double, std::micro>(end - middle).count() / count;
+		std::printf("%u rectangles of %.0f cells on average: %.3f us per count from the census, %.3f us reading cells, %s\n",
+			count, double(cells) / count, censusUs, scanUs, agree ? "same counts" : "COUNTS DIFFER");
+	}
+
+	// One line per phase: time, counts and what they mean per cell.
+	void PrintPhaseCounters(const PerfCounters& counters, const std::string& name, const CounterSample& sample, double frames, double cells)
+	{
+		std::printf("  %-14s %8.3f ms", name.c_str(), sample.seconds * 1e3 / frames);
+		if (counters.Available(counterCycles))
+			std::printf("  %7.2f cyc/cell", sample.values[counterCycles] / frames / cells);
+		if (counters.Available(counterCycles) && counters.Available(counterInstructions) && sample.values[counterCycles] != 0)
+			std::printf("  IPC %4.2f", double(sample.values[counterInstructions]) / sample.values[counterCycles]);
+		const PerfCounter misses[] = { counterL1DMisses, counterLLCMisses, counterBranchMisses };
+		for (PerfCounter counter : misses)
+			if (counters.Available(counter))
+				std::printf("  %s %.2f/kcell", PerfCounters::Name(counter), sample.values[counter] / frames / cells * 1e3);
+		std::printf("\n");
+	}
+
+	// The alternative runs, of which at most one applies, the first one
+	// given; null for the plain run.
+	const char* RunMode(const Options& o, unsigned int* count)
+	{
+		const std::pair<bool, const char*> modes[] = {
+			{ o.columns * o.rows > 1, o.columns > 1 ? "--tiles" : "--domains" },
+			{ o.sparseMap > 0, "--sparse-map" },
+			{ o.untilSettled, "--until-settled" },
+			{ o.history > 0, "--history" },
+		};
+		const char* mode = nullptr;
+		*count = 0;
+		for (const auto& m : modes)
+			if (m.first && (*count)++ == 0)
+				mode = m.second;
+		return mode;
+	}
+
+	// An option only the plain run uses that is given, null when there is none.
+	// --memory is also reported by the --history run.
+	const char* PlainRunOption(const Options& o, const char* mode)
+	{
+		if (!o.exportName.empty()) return "--export";
+		if (o.servePort != 0) return "--serve";
+		if (o.budgetMs > 0.0) return "--budget";
+		if (o.fastForward > 1) return "--fast-forward";
+		if (o.snapshotEvery > 0) return "--snapshot-every";
+		if (o.counters) return "--counters";
+		if (o.rays > 0) return "--rays";
+		if (o.rectCounts > 0) return "--rect-counts";
+		if (o.occupancy) return "--occupancy";
+		if (o.memory && std::strcmp(mode, "--history") != 0) return "--memory";
+		return nullptr;
+	}
+
+	// Print why the options do not go together, false when they do: the
+	// alternative runs step the world their own way and would silently ignore
+	// each other, the plain run's options and options of another run.
+	bool CheckRunOptions(const Options& o)
+	{
+		unsigned int modes = 0;
+		const char* mode = RunMode(o, &modes);
+		if (modes > 1) {
+			std::fprintf(stderr, "%s cannot be combined with another kind of run\n", mode);
+			return false;
+		}
+		const char* plain = mode != nullptr ? PlainRunOption(o, mode) : nullptr;
+		if (plain != nullptr) {
+			std::fprintf(stderr, "%s cannot be combined with %s\n", plain, mode);
+			return false;
+		}
+
+		const std::pair<const char*, const char*> needs[] = {
+			{ o.historyEvery > 1 ? "--history-every" : nullptr, o.history > 0 ? nullptr : "--history" },
+			{ o.historyBudget > 0 ? "--history-budget" : nullptr, o.history > 0 ? nullptr : "--history" },
+			{ o.snapshotGiven ? "--snapshot" : nullptr, o.snapshotEvery > 0 ? nullptr : "--snapshot-every" },
+		};
+		for (const auto& n : needs)
+			if (n.first != nullptr && n.second != nullptr) {
+				std::fprintf(stderr, "%s has no effect without %s\n", n.first, n.second);
+				return false;
+			}
+		return true;
+	}
+
+	// Cartesian product of all swept values, one job each.
+	std::vector<BatchJob> BuildSweepJobs(const Options& options)
+	{
+		BatchJob base;
+		if (options.sweepSizeGiven) {
+			base.width = options.width;
+			base.height = options.height;
+		}
+		base.seed = options.seed;
+		base.maxTicks = options.ticks;
+		base.settleFraction = options.settleFraction;
+
+		std::vector<BatchJob> jobs;
+		std::vector<size_t> digit(options.sweeps.size(), 0);
+		for (;;) {
+			BatchJob job = base;
+			job.name = "world";
+			for (size_t s = 0; s < options.sweeps.size(); ++s) {
+				const Options::Sweep& sweep = options.sweeps[s];
+				ApplySweepValue(job, sweep.key, sweep.values[digit[s]]);
+
+				char part[64];
+				std::snprintf(part, sizeof(part), "_%s%g", sweep.key.c_str(), sweep.values[digit[s]]);
+				job.name += part;
+			}
+			jobs.push_back(job);
+
+			size_t s = 0;
+			while (s < digit.size() && ++digit[s] == options.sweeps[s].values.size())
+				digit[s++] = 0;
+			if (s == digit.size())
+				break;
+		}
+		return jobs;
+	}
+
+	int RunSweep(const Options& options)
+	{
+		const std::vector<BatchJob> jobs = BuildSweepJobs(options);
+		ThreadPool pool(options.threads);
+
+		std::printf("sweeping %zu worlds of %ux%u on %u threads\n",
+			jobs.size(), jobs[0].width, jobs[0].height, pool.ThreadCount());
+
+		const auto start = std::chrono::steady_clock::now();
+		const std::vector<BatchResult> results = RunBatch(jobs, pool);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		for (size_t i = 0; i < jobs.size(); ++i) {
+			const BatchResult& r = results[i];
+			if (r.settleTick >= 0)
+				std::printf("%-48s settled at %5d  checksum %016llx\n", jobs[i].name.c_str(), r.settleTick,
+					static_cast<unsigned long long>(r.checksum));
+			else
+				std::printf("%-48s active after %u   checksum %016llx\n", jobs[i].name.c_str(), r.ticks,
+					static_cast<unsigned long long>(r.checksum));
+		}
+		std::printf("%zu worlds in %.3f s\n", jobs.size(), seconds);
+
+		if (!WriteBatchReport(options.out, jobs, results)) {
+			std::fprintf(stderr, "could not write the report to %s\n", options.out.c_str());
+			return 1;
+		}
+		std::printf("report written to %s\n", options.out.c_str());
+		return 0;
+	}
+
+	// Run the scaling benchmark and write its JSON report.
+	int RunScaling(const Options& options)
+	{
+		ScalingConfig config;
+		config.maxThreads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+		config.ticks = options.ticksGiven ? options.ticks : 30;
+		config.seed = options.seed;
+		config.scene = options.scene;
+
+		const char* p = options.sizes.c_str();
+		while (*p) {
+			unsigned int w, h;
+			int used = 0;
+			if (std::sscanf(p, "%ux%u%n", &w, &h, &used) != 2 || w < 2 || h < 2) {
+				std::fprintf(stderr, "bad size list %s\n", options.sizes.c_str());
+				return 1;
+			}
+			config.sizes.emplace_back(w, h);
+			p += used;
+			if (*p == ',')
+				++p;
+		}
+
+		const std::vector<ScalingPoint> points = RunScalingBench(config);
+		const std::string out = options.outGiven ? options.out : "scaling.json";
+		if (!WriteScalingJson(out, config, points)) {
+			std::fprintf(stderr, "could not write %s\n", out.c_str());
+			return 1;
+		}
+		std::printf("report written to %s\n", out.c_str());
+		return 0;
+	}
+
+	// Rewind half of the recorded frames and compare with the checksum recorded
+	// for that frame.
+	bool CheckRewind(ParticleSim& sim, WorldHistory& history, const std::deque<uint64_t>& checksums)
+	{
+		const World& world = sim.GetWorld();
+		const double fullCopies = double(history.Size()) * world.particles.size() * sizeof(Particle);
+		std::printf("history of %zu frames holds %.1f MB (%.1f MB as full copies)\n",
+			history.Size(), history.MemoryBytes() / 1e6, fullCopies / 1e6);
+
+		const size_t frames = history.Size() / 2;
+		const uint64_t expected = checksums[checksums.size() - 1 - frames];
+
+		const auto start = std::chrono::steady_clock::now();
+		history.Rewind(sim, frames);
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		const bool ok = ComputeChecksum(world) == expected;
+		std::printf("rewound %zu frames in %.3f ms, %s\n", frames, ms, ok ? "checksum matches" : "CHECKSUM MISMATCH");
+		return ok;
+	}
+
+	// Follow an exported world and print its population once a second of
+	// simulation, until the publisher closes the region.
+	int RunWatcher(const std::string& name)
+	{
+		WorldExportReader reader;
+		for (int attempt = 0; !reader.Open(name); ++attempt) {
+			if (attempt == 50) {
+				std::fprintf(stderr, "no world exported as %s\n", name.c_str());
+				return 1;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+
+		const WorldExportHeader& header = reader.Header();
+		const size_t cells = static_cast<size_t>(header.width) * header.height;
+		std::printf("watching %ux%u world %s\n", header.width, header.height, name.c_str());
+
+		uint64_t lastFrame = 0;
+		unsigned int frames = 0;
+		while (!reader.PublisherClosed()) {
+			size_t counts[mat_id_count];
+			uint64_t frame = 0;
+
+			const bool read = reader.ReadLatest([&](uint64_t f, const uint8_t* ids, const Color32*) {
+				std::fill(counts, counts + mat_id_count, size_t(0));
+				for (size_t i = 0; i < cells; ++i)
+					if (ids[i] < mat_id_count)
+						++counts[ids[i]];
+				frame = f;
+			});
+
+			if (!read || frame == lastFrame) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+
+			if (lastFrame / 60 != frame / 60)
+				std::printf("frame %llu  sand %zu water %zu fire %zu smoke %zu steam %zu\n",
+					static_cast<unsigned long long>(frame), counts[mat_id_sand], counts[mat_id_water],
+					counts[mat_id_fire], counts[mat_id_smoke], counts[mat_id_steam]);
+			lastFrame = frame;
+			++frames;
+		}
+
+		std::printf("publisher closed after frame %llu, %u frames seen\n",
+			static_cast<unsigned long long>(lastFrame), frames);
+		return 0;
+	}
+
+	// Split "host:port", a bare port means localhost.
+	void ParseAddress(const std::string& address, std::string& host, int& port)
+	{
+		const size_t colon = address.rfind(':');
+		host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+		port = std::atoi(colon == std::string::npos ? address.c_str() : address.c_str() + colon + 1);
+	}
+
+	// Follow a streamed world, printing its population once a second of
+	// simulation and its checksum when the server goes away.
+	int RunViewer(const std::string& address)
+	{
+		std::string host;
+		int port;
+		ParseAddress(address, host, port);
+
+		StreamClient client;
+		for (int attempt = 0; !client.Connect(host, static_cast<uint16_t>(port)); ++attempt) {
+			if (attempt == 50) {
+				std::fprintf(stderr, "could not connect to %s:%d\n", host.c_str(), port);
+				return 1;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+
+		uint64_t lastFrame = 0;
+		while (client.Poll()) {
+			const World* world = client.GetWorld();
+			if (world != nullptr && client.Frame() / 60 != lastFrame / 60) {
+				size_t counts[mat_id_count];
+				CountMaterials(*world, counts);
+				std::printf("frame %llu  sand %zu water %zu fire %zu smoke %zu steam %zu\n",
+					static_cast<unsigned long long>(client.Frame()), counts[mat_id_sand], counts[mat_id_water],
+					counts[mat_id_fire], counts[mat_id_smoke], counts[mat_id_steam]);
+			}
+			lastFrame = client.Frame();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		std::printf("server closed after frame %llu, %llu frames in %.1f KB\n",
+			static_cast<unsigned long long>(client.Frame()), static_cast<unsigned long long>(client.FramesReceived()),
+			client.BytesReceived() / 1024.0);
+		if (client.GetWorld() != nullptr)
+			std::printf("checksum %016llx\n", static_cast<unsigned long long>(ComputeChecksum(*client.GetWorld())));
+		return 0;
+	}
+
+	// Time every particle rule on its own and print a table.
+	int RunKernelBench(int passes)
+	{
+		if (passes <= 0)
+			return 1;
+
+		const KernelBenchReport report = RunKernelBenchmarks(static_cast<unsigned int>(passes));
+		std::printf("%-8s %-10s %10s %12s\n", "rule", "scenario", "ns/cell", report.cycleSource);
+		for (const KernelBenchResult& r : report.results)
+			std::printf("%-8s %-10s %10.1f %12.1f\n", r.material.c_str(), r.scenario.c_str(), r.nsPerCell, r.cyclesPerCell);
+		return 0;
+	}
+
+	// Relay a lockstep session until every client simulated its last tick.
+	int RunLockstepHost(const Options& options)
+	{
+		lockstep::Session session;
+		session.width = options.width;
+		session.height = options.height;
+		session.seed = options.seed;
+		session.ticks = options.ticks;
+
+		LockstepHost host;
+		if (!host.Start(static_cast<uint16_t>(options.lockstepHostPort), options.lockstepClients, session)) {
+			std::fprintf(stderr, "could not listen on port %u\n", options.lockstepHostPort);
+			return 1;
+		}
+		std::printf("waiting for %u clients on port %u\n", options.lockstepClients, options.lockstepHostPort);
+
+		bool started = false;
+		while (host.Update()) {
+			if (!started && host.Started()) {
+				std::printf("all clients joined, running %u ticks\n", session.ticks);
+				started = true;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		if (host.TicksChecked() < session.ticks) {
+			std::fprintf(stderr, "a client left at tick %u\n", host.Tick());
+			return 1;
+		}
+
+		std::printf("%u ticks checked, %.1f KB relayed\n", host.TicksChecked(), host.BytesRelayed() / 1024.0);
+		if (host.FirstDesync() >= 0) {
+			std::printf("clients desynced at tick %lld\n", host.FirstDesync());
+			return 2;
+		}
+		std::printf("clients stayed in sync\n");
+		return 0;
+	}
+
+	// Join a lockstep session as a bot that drops material at random spots.
+	int RunLockstepClient(const Options& options)
+	{
+		std::string hostName;
+		int port;
+		ParseAddress(options.lockstepAddress, hostName, port);
+
+		LockstepClient client;
+		for (int attempt = 0; !client.Connect(hostName, static_cast<uint16_t>(port)); ++attempt) {
+			if (attempt == 50) {
+				std::fprintf(stderr, "could not connect to %s:%d\n", hostName.c_str(), port);
+				return 1;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+
+		while (!client.Joined())
+			if (!client.Poll()) {
+				std::fprintf(stderr, "host closed the connection\n");
+				return 1;
+			}
+
+		const lockstep::Session& session = client.Session();
+		ParticleSim sim(session.width, session.height);
+		BuildTestScene(sim, session.seed);
+		std::printf("client %u joined a %ux%u session\n", client.ClientIndex(), session.width, session.height);
+
+		// the bot's own choices, not part of the shared simulation
+		std::mt19937 bot(client.ClientIndex() + 1);
+		const uint8_t materials[] = { mat_id_sand, mat_id_water, mat_id_fire, mat_id_stone };
+
+		while (!client.Finished()) {
+			if (!client.Poll())
+				break;
+
+			const uint32_t tick = client.Tick();
+			if (!client.Advance(sim)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+
+			if (bot() % 20 == 0) {
+				lockstep::Command cmd = {};
+				cmd.type = lockstep::commandPaint;
+				cmd.material = materials[bot() % 4];
+				cmd.x = static_cast<int32_t>(bot() % session.width);
+				cmd.y = static_cast<int32_t>(bot() % (session.height / 2));
+				cmd.radius = 4.0f + bot() % 8;
+				client.Submit(cmd);
+			}
+
+			if (options.desyncAt == tick)
+				sim.Paint(session.width / 2, session.height / 2, 3.0f, mat_id_stone);
+		}
+
+		// let the last checksum and a possible desync notice through
+		for (int i = 0; i < 100 && client.Poll(); ++i)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		std::printf("client %u simulated %u ticks, sent %.1f KB\n", client.ClientIndex(), client.Tick(), client.BytesSent() / 1024.0);
+		if (client.Desync() >= 0)
+			std::printf("desync reported at tick %lld\n", client.Desync());
+		std::printf("checksum %016llx\n", static_cast<unsigned long long>(ComputeChecksum(sim.GetWorld())));
+		return client.Finished() ? 0 : 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	// worker processes of a domain decomposed run
+	if (argc == 4 && !std::strcmp(argv[1], "--domain-worker"))
+		return RunDomainWorker(argv[2], std::atoi(argv[3]));
+
+	if (argc >= 2 && !std::strcmp(argv[1], "--bench-kernels"))
+		return RunKernelBench(argc == 4 && !std::strcmp(argv[2], "--passes") ? std::atoi(argv[3]) : 500);
+
+	if (argc == 3 && !std::strcmp(argv[1], "--watch"))
+		return RunWatcher(argv[2]);
+
+	if (argc == 3 && !std::strcmp(argv[1], "--view"))
+		return RunViewer(argv[2]);
+
+	Options options;
+	if (!ParseOptions(argc, argv, options)) {
+		PrintUsage();
+		return 1;
+	}
+
+	for (const std::string& plugin : options.plugins) {
+		std::string error;
+		if (!LoadMaterialPlugin(plugin, error)) {
+			std::fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+	}
+
+	// domain workers are separate processes that never load the plugins
+	if (!options.plugins.empty() && options.columns * options.rows > 1) {
+		std::fprintf(stderr, "plugin materials are not supported in domain decomposed runs\n");
+		return 1;
+	}
+
+	uint8_t dropMaterial = mat_id_empty;
+	if (!options.drop.empty() && (dropMaterial = FindMaterial(options.drop)) == mat_id_empty) {
+		std::fprintf(stderr, "no material called %s\n", options.drop.c_str());
+		return 1;
+	}
+
+	if (!options.sweeps.empty())
+		return RunSweep(options);
+	if (options.scaling)
+		return RunScaling(options);
+
+	if (options.lockstepHostPort != 0)
+		return RunLockstepHost(options);
+	if (!options.lockstepAddress.empty())
+		return RunLockstepClient(options);
+
+	if (!CheckRunOptions(options))
+		return 1;
+
+	WorldFileHeader loadHeader;
+	if (!options.load.empty()) {
+		if (!ReadWorldFileHeader(options.load, loadHeader)) {
+			std::fprintf(stderr, "%s is not a world file of this build\n", options.load.c_str());
+			return 1;
+		}
+		options.width = loadHeader.width;
+		options.height = loadHeader.height;
+	}
+
+	ParticleSim sim(options.width, options.height);
+	if (options.load.empty()) {
+		ThreadPool pool(options.threads);
+		const auto buildStart = std::chrono::steady_clock::now();
+		if (!BuildScene(sim, options.scene, options.seed, pool)) {
+			std::fprintf(stderr, "no scene called %s\n", options.scene.c_str());
+			return 1;
+		}
+		std::printf("built %s scene in %.1f ms on %u threads\n", options.scene.c_str(),
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count(), pool.ThreadCount());
+	}
+	else if (!LoadWorld(sim, options.load)) {
+		std::fprintf(stderr, "could not load %s\n", options.load.c_str());
+		return 1;
+	}
+	if (dropMaterial != mat_id_empty)
+		for (unsigned int i = 1; i < 8; ++i)
+			sim.Paint(options.width * i / 8, options.height / 8, options.width / 40.0f, dropMaterial);
+
+	const float dt = 1.0f / 60.0f;
+	const auto start = std::chrono::steady_clock::now();
+
+	if (options.columns * options.rows > 1) {
+		DomainConfig config;
+		config.columns = options.columns;
+		config.rows = options.rows;
+		config.ticks = options.ticks;
+		config.dt = dt;
+
+		if (!RunDomainLauncher(sim.GetWorld(), config)) {
+			std::fprintf(stderr, "domain decomposed run failed\n");
+			return 1;
+		}
+	}
+	else if (options.sparseMap > 0) {
+		if (options.sparseMap < options.width || options.sparseMap < options.height) {
+			std::fprintf(stderr, "the map has to be at least as large as the world\n");
+			return 1;
+		}
+
+		// the map holds the world between runs, the sim only ever sees the window
+		QuadtreeWorld map(options.sparseMap, options.sparseMap);
+		const uint32_t x0 = (options.sparseMap - options.width) / 2;
+		const uint32_t y0 = (options.sparseMap - options.height) / 2;
+		map.Write(sim.GetWorld(), x0, y0);
+		map.Read(sim.GetWorld(), x0, y0);
+
+		for (unsigned int i = 0; i < options.ticks; ++i)
+			sim.Step(dt);
+		map.Write(sim.GetWorld(), x0, y0);
+
+		World check(options.width, options.height);
+		map.Read(check, x0, y0);
+		const double flat = double(options.sparseMap) * options.sparseMap * sizeof(Particle);
+		std::printf("%ux%u map: %zu nodes, %zu of %zu window chunks dense, %.2f MB (%.0f MB flat), %s\n",
+			options.sparseMap, options.sparseMap, map.NodeCount(), map.DenseChunks(), sim.GetWorld().chunkStamps.size(),
+			map.MemoryBytes() / 1048576.0, flat / 1048576.0,
+			ComputeChecksum(check) == ComputeChecksum(sim.GetWorld()) ? "window reads back" : "WINDOW MISMATCH");
+	}
+	else if (options.untilSettled) {
+		const SettleResult result = RunUntilSettled(sim, dt, options.ticks);
+		if (result.settled)
+			std::printf("settled at tick %u, stable for %u ticks\n", result.settleTick, result.ticks - result.settleTick);
+		else
+			std::printf("still changing after %u ticks\n", result.ticks);
+		PrintSummary(sim.GetWorld(), result.ticks, result.seconds);
+		return result.settled ? 0 : 2;
+	}
+	else if (options.history > 0) {
+		WorldHistory history(options.history);
+		history.SetBudget(options.historyBudget);
+		std::deque<uint64_t> checksums;
+		double captureSeconds = 0.0;
+
+		for (unsigned int i = 0; i < options.ticks; ++i) {
+			sim.Step(dt);
+			if ((i + 1) % options.historyEvery != 0)
+				continue;
+
+			const auto captureStart = std::chrono::steady_clock::now();
+			history.Capture(sim);
+			captureSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - captureStart).count();
+
+			checksums.push_back(ComputeChecksum(sim.GetWorld()));
+			if (checksums.size() > options.history)
+				checksums.pop_front();
+		}
+
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		PrintSummary(sim.GetWorld(), options.ticks, seconds);
+		std::printf("captures took %.3f s, %.2f ms per tick\n", captureSeconds, captureSeconds * 1000.0 / std::max(options.ticks, 1u));
+		if (options.memory) {
+			MemoryReport report;
+			AddWorldMemory(report, sim.GetWorld());
+			report.Add("occupancy pyramid", sim.Occupancy().MemoryBytes());
+			report.Add("material census", sim.Census().MemoryBytes());
+			report.Add("history chunks", history.MemoryBytes() - history.PackedBytes());
+			report.Add("history chunks, compressed", history.PackedBytes());
+			std::printf("%s", report.Format().c_str());
+		}
+		if (history.FramesEvicted() > 0)
+			std::printf("%zu frames dropped to stay within the history budget\n", history.FramesEvicted());
+
+		// frames evicted for the budget have no history to rewind into
+		while (checksums.size() > history.Size())
+			checksums.pop_front();
+		return CheckRewind(sim, history, checksums) ? 0 : 1;
+	}
+	else {
+		AsyncSnapshot snapshot;
+		unsigned int skipped = 0;
+
+		WorldExport exporter;
+		if (!options.exportName.empty()) {
+			if (!exporter.Create(options.exportName, options.width, options.height)) {
+				std::fprintf(stderr, "could not create shared memory region %s\n", options.exportName.c_str());
+				return 1;
+			}
+			exporter.Publish(sim.GetWorld(), sim.FrameCounter());
+		}
+
+		StreamServer server;
+		if (options.servePort != 0 && !server.Start(static_cast<uint16_t>(options.servePort), options.width, options.height)) {
+			std::fprintf(stderr, "could not listen on port %u\n", options.servePort);
+			return 1;
+		}
+		auto nextTick = std::chrono::steady_clock::now();
+		if (options.snapshotEvery > 0)
+			snapshot.UseHugePages(sim.GetWorld());
+
+		// per frame: the sim's phases, then population statistics and publishing
+		enum { phaseStats = static_cast<int>(SimPhase::colorResolve) + 1, phasePublish };
+		PerfCounters counters;
+		PhaseCounters phases(counters, { "stats", "publish" });
+		const double cells = double(options.width) * options.height;
+		if (options.counters) {
+			if (!counters.Open())
+				std::printf("hardware counters unavailable, timing phases only\n");
+			sim.SetProfiler(&phases);
+		}
+
+		FrameGovernor governor(options.budgetMs);
+
+		for (unsigned int i = 0; i < options.ticks; ) {
+			// a fast-forwarded frame runs several ticks and only resolves the colors of the last
+			const unsigned int frameTicks = std::min(options.fastForward, options.ticks - i);
+			if (options.budgetMs > 0.0 && frameTicks > 1)
+				governor.StepMany(sim, frameTicks, dt);
+			else if (options.budgetMs > 0.0)
+				governor.Step(sim, dt);
+			else if (frameTicks > 1)
+				sim.StepMany(frameTicks, dt);
+			else
+				sim.Step(dt);
+			i += frameTicks;
+
+			if (options.counters) {
+				phases.Begin(phaseStats);
+				size_t counts[mat_id_count];
+				CountMaterials(sim.GetWorld(), counts);
+				ComputeChecksum(sim.GetWorld());
+				phases.End(phaseStats);
+				phases.Begin(phasePublish);
+			}
+
+			if (!options.exportName.empty())
+				exporter.Publish(sim.GetWorld(), sim.FrameCounter());
+
+			if (options.servePort != 0) {
+				server.Publish(sim.GetWorld(), sim.FrameCounter());
+				nextTick += std::chrono::microseconds(static_cast<long long>(dt * 1e6f));
+				std::this_thread::sleep_until(nextTick);
+			}
+
+			// a snapshot still being written makes the next one wait for the next interval
+			if (options.snapshotEvery > 0 && i / options.snapshotEvery > (i - frameTicks) / options.snapshotEvery && !snapshot.Begin(sim, options.snapshot))
+				++skipped;
+
+			if (options.counters) {
+				phases.End(phasePublish);
+				phases.EndFrame();
+				if (phases.Frames() % 60 == 0) {
+					std::printf("frame %u\n", sim.FrameCounter());
+					for (size_t p = 0; p < phases.PhaseCount(); ++p)
+						PrintPhaseCounters(counters, phases.PhaseName(p), phases.LastFrame(p), 1.0, cells);
+				}
+			}
+		}
+		snapshot.Wait();
+		sim.SetProfiler(nullptr);
+
+		if (options.counters && phases.Frames() > 0) {
+			std::printf("average of %u frames\n", phases.Frames());
+			for (size_t p = 0; p < phases.PhaseCount(); ++p)
+				PrintPhaseCounters(counters, phases.PhaseName(p), phases.Total(p), phases.Frames(), cells);
+		}
+
+		if (options.budgetMs > 0.0) {
+			std::printf("steps per quality level:");
+			for (unsigned int level = 0; level < FrameGovernor::levelCount; ++level)
+				std::printf(" %u", governor.StepsAtLevel(level));
+			std::printf(", %.2f ms per step on average at the end\n", governor.AverageMs());
+		}
+
+		if (options.servePort != 0) {
+			// give viewers that fell behind a moment to receive the final frame
+			for (int i = 0; i < 100; ++i) {
+				server.Publish(sim.GetWorld(), sim.FrameCounter());
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			std::printf("streamed %llu frames (%llu dropped for slow viewers), %.1f KB\n",
+				static_cast<unsigned long long>(server.FramesSent()), static_cast<unsigned long long>(server.FramesDropped()),
+				server.BytesSent() / 1024.0);
+		}
+
+		if (options.snapshotEvery > 0)
+			std::printf("%u snapshots to %s (%s), pause %.3f ms max, %u skipped while busy\n",
+				snapshot.Completed(), options.snapshot.c_str(), snapshot.LastSucceeded() ? "ok" : "FAILED",
+				snapshot.MaxPauseMs(), skipped);
+
+		if (options.occupancy)
+			PrintOccupancy(sim.Occupancy());
+		if (options.rays > 0)
+			BenchRays(sim, options.rays, options.seed);
+		if (options.rectCounts > 0)
+			BenchRectCounts(sim, options.rectCounts, options.seed);
+
+		if (options.memory) {
+			MemoryReport report;
+			AddWorldMemory(report, sim.GetWorld());
+			report.Add("occupancy pyramid", sim.Occupancy().MemoryBytes());
+			report.Add("material census", sim.Census().MemoryBytes());
+			if (!options.exportName.empty())
+				report.Add("shared memory export", exporter.MemoryBytes());
+			if (options.servePort != 0)
+				report.Add("stream buffers", server.MemoryBytes());
+			std::printf("%s", report.Format().c_str());
+		}
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	PrintSummary(sim.GetWorld(), options.ticks, seconds);
+	return 0;
+}
@@ -0,0 +1,143 @@
+#include "KernelBench.h"
+
+#include "ParticleSim.h"
+#include "PerfCounters.h"
+
+#include <chrono>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define KERNEL_BENCH_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define KERNEL_BENCH_TSC 1
+#endif
+
+namespace
+{
+	// Each neighbourhood reaches as far as one update can, so copies never interact.
+	constexpr unsigned int tileWidth = 2 * updateReachX + 1;
+	constexpr unsigned int tileHeight = 2 * updateReachY + 1;
+	constexpr unsigned int tilesX = 16;
+	constexpr unsigned int tilesY = 8;
+
+	enum Scenario
+	{
+		scenarioFreeFall,	// nothing around, the particle falls or rises freely
+		scenarioResting,	// on a stone floor, among its own material
+		scenarioBlocked,	// enclosed in stone
+		scenarioInWater,	// surrounded by water
+		scenarioCount
+	};
+
+	const char* scenarioNames[scenarioCount] = { "free fall", "resting", "blocked", "in water" };
+
+	struct Kernel
+	{
+		const char* name;
+		uint8_t material;
+	};
+
+	const Kernel kernels[] = {
+		{ "sand", mat_id_sand },
+		{ "water", mat_id_water },
+		{ "fire", mat_id_fire },
+		{ "smoke", mat_id_smoke },
+		{ "steam", mat_id_steam },
+	};
+
+	void FillTile(World& world, unsigned int tx, unsigned int ty, Scenario scenario, uint8_t material)
+	{
+		const unsigned int x0 = tx * tileWidth;
+		const unsigned int y0 = ty * tileHeight;
+		const unsigned int cx = x0 + tileWidth / 2;
+		const unsigned int cy = y0 + tileHeight / 2;
+
+		for (unsigned int y = y0; y < y0 + tileHeight; ++y) {
+			for (unsigned int x = x0; x < x0 + tileWidth; ++x) {
+				uint8_t id = mat_id_empty;
+				switch (scenario) {
+				case scenarioFreeFall: break;
+				case scenarioResting: id = y > cy ? mat_id_stone : (y == cy ? material : mat_id_empty); break;
+				case scenarioBlocked: id = mat_id_stone; break;
+				case scenarioInWater: id = mat_id_water; break;
+				default: break;
+				}
+				if (x == cx && y == cy)
+					id = material;
+
+				const size_t i = static_cast<size_t>(y) * world.width + x;
+				world.particles[i] = ParticleSim::CreateParticle(id);
+				world.colors[i] = world.particles[i].color;
+			}
+		}
+	}
+
+	uint64_t ReadTsc()
+	{
+#ifdef KERNEL_BENCH_TSC
+		return __rdtsc();
+#else
+		return 0;
+#endif
+	}
+}
+
+KernelBenchReport RunKernelBenchmarks(unsigned int passes)
+{
+	const float dt = 1.0f / 60.0f;
+	const unsigned int width = tilesX * tileWidth;
+	const unsigned int height = tilesY * tileHeight;
+	const size_t cellsPerPass = static_cast<size_t>(tilesX) * tilesY;
+
+	PerfCounters counters;
+	const bool haveCycles = counters.Open() && counters.Available(counterCycles);
+
+	KernelBenchReport report;
+#ifdef KERNEL_BENCH_TSC
+	report.cycleSource = haveCycles ? "cycles" : "TSC";
+#else
+	report.cycleSource = haveCycles ? "cycles" : "none";
+#endif
+
+	for (const Kernel& kernel : kernels) {
+		for (int s = 0; s < scenarioCount; ++s) {
+			ParticleSim sim(width, height);
+			World& world = sim.GetWorld();
+			for (unsigned int ty = 0; ty < tilesY; ++ty)
+				for (unsigned int tx = 0; tx < tilesX; ++tx)
+					FillTile(world, tx, ty, static_cast<Scenario>(s), kernel.material);
+			const std::vector<Particle> initial = world.particles;
+
+			double seconds = 0.0;
+			uint64_t cycles = 0;
+			for (unsigned int pass = 0; pass < passes; ++pass) {
+				std::memcpy(world.particles.data(), initial.data(), initial.size() * sizeof(Particle));
+				world.TouchAll();
+				sim.Occupancy();
+
+				const CounterSample before = counters.Read();
+				const uint64_t tscBefore = ReadTsc();
+
+				// bottom up like the sweep
+				for (unsigned int ty = tilesY; ty-- > 0;)
+					for (unsigned int tx = 0; tx < tilesX; ++tx)
+						sim.UpdateParticle(tx * tileWidth + tileWidth / 2, ty * tileHeight + tileHeight / 2, dt);
+
+				const uint64_t tscAfter = ReadTsc();
+				const CounterSample after = counters.Read();
+				seconds += after.seconds - before.seconds;
+				cycles += haveCycles ? after.values[counterCycles] - before.values[counterCycles] : tscAfter - tscBefore;
+			}
+
+			KernelBenchResult result;
+			result.material = kernel.name;
+			result.scenario = scenarioNames[s];
+			result.nsPerCell = seconds * 1e9 / (double(cellsPerPass) * passes);
+			result.cyclesPerCell = double(cycles) / (double(cellsPerPass) * passes);
+			report.results.push_back(result);
+		}
+	}
+	return report;
+}
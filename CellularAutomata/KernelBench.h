@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Micro benchmarks of the single particle rules. Every benchmark fills a world
+// with copies of one small neighbourhood, runs the rule on the centre cell of
+// each copy, and restores the world between passes outside the timed part.
+// The neighbourhoods are far enough apart that no update reaches the next.
+struct KernelBenchResult
+{
+	std::string material;
+	std::string scenario;	// free fall, resting, blocked, in water
+	double nsPerCell = 0.0;
+	double cyclesPerCell = 0.0;
+};
+
+struct KernelBenchReport
+{
+	std::vector<KernelBenchResult> results;
+	const char* cycleSource = "";	// "cycles" from the counters, "TSC" or "none"
+};
+
+// Run every rule in every scenario, passes times each.
+KernelBenchReport RunKernelBenchmarks(unsigned int passes);
@@ -0,0 +1,270 @@
+#include "Lockstep.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr uint8_t messageWelcome = 1;	// host -> client: index, session
+	constexpr uint8_t messageInput = 2;		// client -> host: tick, commands
+	constexpr uint8_t messageTick = 3;		// host -> client: tick, commands of all clients
+	constexpr uint8_t messageChecksum = 4;	// client -> host: tick, checksum
+	constexpr uint8_t messageDesync = 5;	// host -> client: tick
+
+	struct Welcome
+	{
+		uint32_t index;
+		lockstep::Session session;
+	};
+
+	struct ChecksumReport
+	{
+		uint32_t tick;
+		uint32_t pad;
+		uint64_t checksum;
+	};
+
+	void WriteCommands(MessageChannel& channel, uint8_t type, uint32_t tick, const std::vector<lockstep::Command>& commands)
+	{
+		channel.BeginMessage(type);
+		channel.Write(tick);
+		if (!commands.empty())
+			channel.Write(commands.data(), commands.size() * sizeof(lockstep::Command));
+		channel.EndMessage();
+	}
+
+	bool ReadCommands(const uint8_t* data, size_t size, uint32_t& tick, std::vector<lockstep::Command>& commands)
+	{
+		if (size < sizeof(tick) || (size - sizeof(tick)) % sizeof(lockstep::Command) != 0)
+			return false;
+
+		std::memcpy(&tick, data, sizeof(tick));
+		commands.resize((size - sizeof(tick)) / sizeof(lockstep::Command));
+		if (!commands.empty())
+			std::memcpy(commands.data(), data + sizeof(tick), size - sizeof(tick));
+		return true;
+	}
+}
+
+void lockstep::Apply(ParticleSim& sim, const Command& cmd)
+{
+	switch (cmd.type) {
+	case commandPaint: sim.Paint(cmd.x, cmd.y, cmd.radius, cmd.material); break;
+	case commandErase: sim.Erase(cmd.x, cmd.y, cmd.radius); break;
+	case commandClear: sim.Clear(); break;
+	}
+}
+
+bool LockstepHost::Start(uint16_t port, unsigned int clientCount, const lockstep::Session& session)
+{
+	mClients.clear();
+	mChecksums.clear();
+	mStarted = false;
+	mNextTick = 0;
+	mTicksChecked = 0;
+	mFirstDesync = -1;
+
+	if (clientCount == 0 || !mListener.Listen(port))
+		return false;
+
+	mClientCount = clientCount;
+	mSession = session;
+	return true;
+}
+
+uint64_t LockstepHost::BytesRelayed() const
+{
+	uint64_t bytes = 0;
+	for (const auto& client : mClients)
+		bytes += client->channel.BytesSent();
+	return bytes;
+}
+
+void LockstepHost::Broadcast(uint32_t tick)
+{
+	std::vector<lockstep::Command> commands;
+	for (auto& client : mClients) {
+		auto it = client->inputs.find(tick);
+		if (it != client->inputs.end()) {
+			commands.insert(commands.end(), it->second.begin(), it->second.end());
+			client->inputs.erase(it);
+		}
+	}
+
+	for (auto& client : mClients)
+		WriteCommands(client->channel, messageTick, tick, commands);
+}
+
+bool LockstepHost::HandleMessage(size_t client, uint8_t type, const uint8_t* data, size_t size)
+{
+	if (type == messageInput) {
+		uint32_t tick;
+		std::vector<lockstep::Command> commands;
+		if (!ReadCommands(data, size, tick, commands) || tick < mNextTick)
+			return false;
+		mClients[client]->inputs[tick] = std::move(commands);
+		return true;
+	}
+
+	if (type == messageChecksum) {
+		ChecksumReport report;
+		if (size < sizeof(report))
+			return false;
+		std::memcpy(&report, data, sizeof(report));
+
+		std::vector<uint64_t>& reports = mChecksums[report.tick];
+		reports.push_back(report.checksum);
+		if (reports.back() != reports.front() && mFirstDesync < 0) {
+			mFirstDesync = report.tick;
+			for (auto& c : mClients) {
+				c->channel.BeginMessage(messageDesync);
+				c->channel.Write(report.tick);
+				c->channel.EndMessage();
+			}
+		}
+		if (reports.size() == mClients.size()) {
+			mChecksums.erase(report.tick);
+			++mTicksChecked;
+		}
+		return true;
+	}
+
+	return true;
+}
+
+bool LockstepHost::Update()
+{
+	if (!mStarted) {
+		Socket socket;
+		while (mClients.size() < mClientCount && mListener.Accept(socket)) {
+			auto client = std::make_unique<Client>();
+			client->channel = MessageChannel(std::move(socket));
+			client->channel.BeginMessage(messageWelcome);
+			client->channel.Write(Welcome{ static_cast<uint32_t>(mClients.size()), mSession });
+			client->channel.EndMessage();
+			client->channel.Flush();
+			mClients.push_back(std::move(client));
+		}
+		if (mClients.size() < mClientCount)
+			return true;
+
+		// nobody can have sent commands for the first inputDelay ticks
+		mStarted = true;
+		mListener.Close();
+		for (; mNextTick < mSession.inputDelay; ++mNextTick)
+			Broadcast(mNextTick);
+	}
+
+	for (size_t i = 0; i < mClients.size(); ++i) {
+		const bool open = mClients[i]->channel.Receive([this, i](uint8_t type, const uint8_t* data, size_t size) {
+			return HandleMessage(i, type, data, size);
+		});
+		if (!open)
+			return false;
+	}
+
+	// relay every tick all clients sent their commands for
+	for (;;) {
+		if (mSession.ticks != 0 && mNextTick >= mSession.ticks)
+			break;
+		const bool complete = std::all_of(mClients.begin(), mClients.end(),
+			[this](const std::unique_ptr<Client>& c) { return c->inputs.count(mNextTick) != 0; });
+		if (!complete)
+			break;
+		Broadcast(mNextTick++);
+	}
+
+	for (auto& client : mClients)
+		if (!client->channel.Flush())
+			return false;
+
+	// done once every client reported its last checksum
+	return mSession.ticks == 0 || mTicksChecked < mSession.ticks;
+}
+
+bool LockstepClient::Connect(const std::string& host, uint16_t port)
+{
+	mJoined = false;
+	mTick = 0;
+	mTicks.clear();
+	mLocal.clear();
+	mDesync = -1;
+	return mChannel.Connect(host, port);
+}
+
+bool LockstepClient::HandleMessage(uint8_t type, const uint8_t* data, size_t size)
+{
+	switch (type) {
+	case messageWelcome: {
+		Welcome welcome;
+		if (size < sizeof(welcome))
+			return false;
+		std::memcpy(&welcome, data, sizeof(welcome));
+		mIndex = welcome.index;
+		mSession = welcome.session;
+		mJoined = true;
+		return true;
+	}
+	case messageTick: {
+		uint32_t tick;
+		std::vector<lockstep::Command> commands;
+		if (!ReadCommands(data, size, tick, commands))
+			return false;
+		mTicks[tick] = std::move(commands);
+		return true;
+	}
+	case messageDesync:
+		if (size < sizeof(uint32_t))
+			return false;
+		if (mDesync < 0) {
+			uint32_t tick;
+			std::memcpy(&tick, data, sizeof(tick));
+			mDesync = tick;
+		}
+		return true;
+	default:
+		return true;
+	}
+}
+
+bool LockstepClient::Poll()
+{
+	const bool open = mChannel.Receive([this](uint8_t type, const uint8_t* data, size_t size) {
+		return HandleMessage(type, data, size);
+	});
+	return mChannel.Flush() && open;
+}
+
+void LockstepClient::SendInputs(uint32_t tick)
+{
+	WriteCommands(mChannel, messageInput, tick, mLocal);
+	mLocal.clear();
+}
+
+bool LockstepClient::Advance(ParticleSim& sim)
+{
+	if (!mJoined || Finished())
+		return false;
+
+	auto it = mTicks.find(mTick);
+	if (it == mTicks.end())
+		return false;
+
+	// commands issued now apply inputDelay ticks from now
+	if (mSession.ticks == 0 || mTick + mSession.inputDelay < mSession.ticks)
+		SendInputs(mTick + mSession.inputDelay);
+
+	for (const lockstep::Command& cmd : it->second)
+		lockstep::Apply(sim, cmd);
+	mTicks.erase(it);
+
+	sim.Step(lockstep::fixedDt);
+
+	mChannel.BeginMessage(messageChecksum);
+	mChannel.Write(ChecksumReport{ mTick, 0, ComputeChecksum(sim.GetWorld()) });
+	mChannel.EndMessage();
+	mChannel.Flush();
+
+	++mTick;
+	return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "MessageChannel.h"
+#include "ParticleSim.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+// Deterministic lockstep: every client runs the same simulation from the same
+// seed with a fixed time step, and only the input commands travel.
+//
+// A host relays. Clients send their commands for tick t + inputDelay while
+// simulating tick t. Once every client's commands for a tick are in, the host
+// broadcasts them in client order, so every client applies the same commands
+// in the same order before stepping. After stepping, each client reports the
+// world checksum. The host compares the reports and tells everyone about the
+// first tick on which they disagree. Traffic is a few bytes per client and
+// tick, whatever the size of the world.
+namespace lockstep
+{
+	constexpr float fixedDt = 1.0f / 60.0f;
+
+	enum CommandType : uint8_t
+	{
+		commandPaint = 1,
+		commandErase = 2,
+		commandClear = 3,
+	};
+
+	struct Command
+	{
+		uint8_t type;
+		uint8_t material;
+		uint16_t pad;
+		int32_t x;
+		int32_t y;
+		float radius;
+	};
+
+	struct Session
+	{
+		uint32_t width = 800;
+		uint32_t height = 600;
+		uint32_t seed = 1;
+		uint32_t ticks = 0;			// session length, 0 runs until the host stops
+		uint32_t inputDelay = 2;	// ticks between issuing a command and applying it
+	};
+
+	// Apply cmd to sim; the same on every client.
+	void Apply(ParticleSim& sim, const Command& cmd);
+}
+
+class LockstepHost
+{
+public:
+	bool Start(uint16_t port, unsigned int clientCount, const lockstep::Session& session);
+
+	// Accept clients until all joined, then relay commands and compare
+	// checksums. False once the session is over or a client left.
+	bool Update();
+
+	bool Started() const { return mStarted; }
+	uint32_t Tick() const { return mNextTick; }
+	uint32_t TicksChecked() const { return mTicksChecked; }
+
+	// first tick the clients disagreed on, -1 if they never did
+	long long FirstDesync() const { return mFirstDesync; }
+	uint64_t BytesRelayed() const;
+
+private:
+	struct Client
+	{
+		MessageChannel channel;
+		std::map<uint32_t, std::vector<lockstep::Command>> inputs;	// by tick
+	};
+
+	bool HandleMessage(size_t client, uint8_t type, const uint8_t* data, size_t size);
+	void Broadcast(uint32_t tick);
+
+	Socket mListener;
+	std::vector<std::unique_ptr<Client>> mClients;
+	unsigned int mClientCount = 0;
+	lockstep::Session mSession;
+	bool mStarted = false;
+	uint32_t mNextTick = 0;
+
+	// checksums reported for each tick, until every client reported
+	std::map<uint32_t, std::vector<uint64_t>> mChecksums;
+	uint32_t mTicksChecked = 0;
+	long long mFirstDesync = -1;
+};
+
+class LockstepClient
+{
+public:
+	bool Connect(const std::string& host, uint16_t port);
+
+	// Handle what arrived. False once the host went away.
+	bool Poll();
+
+	// The session parameters arrive shortly after connecting.
+	bool Joined() const { return mJoined; }
+	const lockstep::Session& Session() const { return mSession; }
+	uint32_t ClientIndex() const { return mIndex; }
+
+	// Queue a command, it goes out with the next tick this client simulates.
+	void Submit(const lockstep::Command& cmd) { mLocal.push_back(cmd); }
+
+	// Simulate the next tick if its commands arrived. sim has to be built from
+	// the session seed. True when a tick was simulated.
+	bool Advance(ParticleSim& sim);
+
+	bool Finished() const { return mSession.ticks != 0 && mTick >= mSession.ticks; }
+	uint32_t Tick() const { return mTick; }
+	long long Desync() const { return mDesync; }
+	uint64_t BytesSent() const { return mChannel.BytesSent(); }
+
+private:
+	bool HandleMessage(uint8_t type, const uint8_t* data, size_t size);
+	void SendInputs(uint32_t tick);
+
+	MessageChannel mChannel;
+	lockstep::Session mSession;
+	uint32_t mIndex = 0;
+	bool mJoined = false;
+	uint32_t mTick = 0;
+	std::vector<lockstep::Command> mLocal;
+	std::map<uint32_t, std::vector<lockstep::Command>> mTicks;	// commands by tick, from the host
+	long long mDesync = -1;
+};
@@ -0,0 +1,186 @@
+#include "MaterialCensus.h"
+
+#include "MaterialTable.h"
+#include "ParticleSim.h"
+
+#include <algorithm>
+
+void MaterialCensus::Build(World& world)
+{
+	mWidth = world.width;
+	mHeight = world.height;
+	mMaterials = MaterialCount();
+	mTilesX = (mWidth + tileSize - 1) >> tileShift;
+	mTilesY = (mHeight + tileSize - 1) >> tileShift;
+	mChunksX = world.chunksX;
+
+	mTiles.assign(static_cast<size_t>(mTilesX) * mTilesY * mMaterials, 0);
+	mChunks.assign(world.chunkStamps.size() * mMaterials, 0);
+	mTotals.assign(mMaterials, 0);
+	mTable.assign(static_cast<size_t>(mTilesX + 1) * (mTilesY + 1) * mMaterials, 0);
+	mTableRow = 0;
+	mRebuild = false;
+
+	for (unsigned int ty = 0; ty < mTilesY; ++ty)
+		for (unsigned int tx = 0; tx < mTilesX; ++tx)
+			Recount(world, tx, ty);
+
+	mCheckpoint = world.Checkpoint();
+}
+
+void MaterialCensus::Sync(World& world)
+{
+	if (mRebuild || mMaterials == 0 || mWidth != world.width || mHeight != world.height) {
+		Build(world);
+		return;
+	}
+
+	constexpr unsigned int tilesPerChunk = chunkSize >> tileShift;
+	for (unsigned int cy = 0; cy < world.chunksY; ++cy) {
+		for (unsigned int cx = 0; cx < world.chunksX; ++cx) {
+			if (!world.ChangedSince(cy * world.chunksX + cx, mCheckpoint))
+				continue;
+
+			const unsigned int tx1 = std::min((cx + 1) * tilesPerChunk, mTilesX);
+			const unsigned int ty1 = std::min((cy + 1) * tilesPerChunk, mTilesY);
+			for (unsigned int ty = cy * tilesPerChunk; ty < ty1; ++ty)
+				for (unsigned int tx = cx * tilesPerChunk; tx < tx1; ++tx)
+					Recount(world, tx, ty);
+		}
+	}
+
+	// a material registered since the last Build
+	if (mRebuild) {
+		Build(world);
+		return;
+	}
+	mCheckpoint = world.Checkpoint();
+}
+
+void MaterialCensus::Skip(World& world)
+{
+	mCheckpoint = world.Checkpoint();
+}
+
+void MaterialCensus::Change(unsigned int x, unsigned int y, uint8_t from, uint8_t to)
+{
+	if (from >= mMaterials || to >= mMaterials) {
+		mRebuild = true;
+		return;
+	}
+
+	const unsigned int ty = y >> tileShift;
+	const size_t tile = (static_cast<size_t>(ty) * mTilesX + (x >> tileShift)) * mMaterials;
+	const size_t chunk = (static_cast<size_t>(y >> chunkShift) * mChunksX + (x >> chunkShift)) * mMaterials;
+	--mTiles[tile + from];
+	++mTiles[tile + to];
+	--mChunks[chunk + from];
+	++mChunks[chunk + to];
+	--mTotals[from];
+	++mTotals[to];
+	mTableRow = std::min(mTableRow, ty);
+}
+
+void MaterialCensus::Recount(const World& world, unsigned int tx, unsigned int ty)
+{
+	uint8_t* counts = &mTiles[(static_cast<size_t>(ty) * mTilesX + tx) * mMaterials];
+	const unsigned int x0 = tx << tileShift;
+	const unsigned int y0 = ty << tileShift;
+	const size_t chunk = (static_cast<size_t>(y0 >> chunkShift) * mChunksX + (x0 >> chunkShift)) * mMaterials;
+
+	// take the old counts out of the chunk and the totals, then add the new
+	for (unsigned int m = 0; m < mMaterials; ++m) {
+		mChunks[chunk + m] -= counts[m];
+		mTotals[m] -= counts[m];
+		counts[m] = 0;
+	}
+
+	const unsigned int x1 = std::min(x0 + tileSize, mWidth);
+	const unsigned int y1 = std::min(y0 + tileSize, mHeight);
+	for (unsigned int y = y0; y < y1; ++y) {
+		const Particle* row = &world.particles[static_cast<size_t>(y) * mWidth];
+		for (unsigned int x = x0; x < x1; ++x) {
+			if (row[x].id >= mMaterials) {
+				mRebuild = true;
+				continue;
+			}
+			++counts[row[x].id];
+		}
+	}
+
+	for (unsigned int m = 0; m < mMaterials; ++m) {
+		mChunks[chunk + m] += counts[m];
+		mTotals[m] += counts[m];
+	}
+	mTableRow = std::min(mTableRow, ty);
+}
+
+void MaterialCensus::BuildTable()
+{
+	// row r of corners sums the tile rows above it, so rows up to mTableRow still hold
+	const size_t cornerRow = static_cast<size_t>(mTilesX + 1) * mMaterials;
+	std::vector<uint32_t> rowSums(mMaterials);
+	for (unsigned int ty = mTableRow; ty < mTilesY; ++ty) {
+		std::fill(rowSums.begin(), rowSums.end(), 0);
+		const uint32_t* above = &mTable[ty * cornerRow];
+		uint32_t* below = &mTable[(ty + 1) * cornerRow];
+		for (unsigned int tx = 0; tx < mTilesX; ++tx) {
+			const uint8_t* counts = &mTiles[(static_cast<size_t>(ty) * mTilesX + tx) * mMaterials];
+			const size_t corner = static_cast<size_t>(tx + 1) * mMaterials;
+			for (unsigned int m = 0; m < mMaterials; ++m) {
+				rowSums[m] += counts[m];
+				below[corner + m] = above[corner + m] + rowSums[m];
+			}
+		}
+	}
+	mTableRow = mTilesY;
+}
+
+size_t MaterialCensus::Count(const World& world, uint8_t material, int x0, int y0, int x1, int y1) const
+{
+	x0 = std::max(x0, 0);
+	y0 = std::max(y0, 0);
+	x1 = std::min(x1, static_cast<int>(mWidth));
+	y1 = std::min(y1, static_cast<int>(mHeight));
+	if (material >= mMaterials || x0 >= x1 || y0 >= y1)
+		return 0;
+
+	// the tiles inside the rectangle; a tile cut short by the world's edge
+	// counts as inside when the rectangle reaches the edge
+	const unsigned int tx0 = (unsigned(x0) + tileSize - 1) >> tileShift;
+	const unsigned int ty0 = (unsigned(y0) + tileSize - 1) >> tileShift;
+	const unsigned int tx1 = unsigned(x1) == mWidth ? mTilesX : unsigned(x1) >> tileShift;
+	const unsigned int ty1 = unsigned(y1) == mHeight ? mTilesY : unsigned(y1) >> tileShift;
+	if (tx0 >= tx1 || ty0 >= ty1)
+		return CountCells(world, material, x0, y0, x1, y1);
+
+	const size_t cornerRow = static_cast<size_t>(mTilesX + 1) * mMaterials;
+	auto corner = [&](unsigned int tx, unsigned int ty) { return size_t(mTable[ty * cornerRow + size_t(tx) * mMaterials + material]); };
+	size_t count = corner(tx1, ty1) - corner(tx0, ty1) - corner(tx1, ty0) + corner(tx0, ty0);
+
+	// the cells around the inner tiles: full rows above and below, the sides between
+	const unsigned int ix0 = std::min(tx0 << tileShift, mWidth), iy0 = std::min(ty0 << tileShift, mHeight);
+	const unsigned int ix1 = std::min(tx1 << tileShift, mWidth), iy1 = std::min(ty1 << tileShift, mHeight);
+	count += CountCells(world, material, x0, y0, x1, iy0);
+	count += CountCells(world, material, x0, iy1, x1, y1);
+	count += CountCells(world, material, x0, iy0, ix0, iy1);
+	count += CountCells(world, material, ix1, iy0, x1, iy1);
+	return count;
+}
+
+size_t MaterialCensus::CountCells(const World& world, uint8_t material, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const
+{
+	size_t count = 0;
+	for (unsigned int y = y0; y < y1; ++y) {
+		const Particle* row = &world.particles[static_cast<size_t>(y) * mWidth];
+		for (unsigned int x = x0; x < x1; ++x)
+			count += row[x].id == material;
+	}
+	return count;
+}
+
+size_t MaterialCensus::MemoryBytes() const
+{
+	return mTiles.size() * sizeof(uint8_t) + mChunks.size() * sizeof(uint16_t) +
+		mTotals.size() * sizeof(size_t) + mTable.size() * sizeof(uint32_t);
+}
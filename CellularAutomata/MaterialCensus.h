@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct World;
+
+// Cells of each material per chunk and per tileSize x tileSize tile, and a
+// summed-area table over the tile counts, so the cells of a material in a
+// rectangle are known without reading the cells it covers.
+//
+// Like the occupancy pyramid, the owning sim reports every change of material
+// through Change() and Sync() recounts the chunks edited through the world
+// directly. The table costs a pass over the tiles to bring up to date, so it
+// is only rebuilt by BuildTable(), from the first row of tiles that changed.
+class MaterialCensus
+{
+public:
+	static constexpr unsigned int tileShift = 3;
+	static constexpr unsigned int tileSize = 1u << tileShift;
+
+	// Count every tile of world afresh, for the materials registered by now.
+	void Build(World& world);
+
+	// Recount the chunks changed since the last Build or Sync, rebuilding all
+	// when the size of world changed or a material registered later showed up.
+	void Sync(World& world);
+
+	// Ignore the changes made to world so far, Change() reported them all.
+	void Skip(World& world);
+
+	// the cell at (x, y) turned from material from into to
+	void Change(unsigned int x, unsigned int y, uint8_t from, uint8_t to);
+
+	// Bring the summed-area table up to date with the tile counts.
+	void BuildTable();
+
+	// materials counted, ids from 0 up
+	unsigned int Materials() const { return mMaterials; }
+
+	// cells of material in the whole world, and in a chunk of it
+	size_t Total(uint8_t material) const { return material < mMaterials ? mTotals[material] : 0; }
+	unsigned int InChunk(size_t chunk, uint8_t material) const { return material < mMaterials ? mChunks[chunk * mMaterials + material] : 0; }
+
+	// Cells of material in [x0, x1) x [y0, y1), clipped to the world, with the
+	// table built. The tiles the rectangle covers whole come from the table
+	// in constant time; only the cells of the tiles cut by its edges are read.
+	size_t Count(const World& world, uint8_t material, int x0, int y0, int x1, int y1) const;
+
+	size_t MemoryBytes() const;
+
+private:
+	void Recount(const World& world, unsigned int tx, unsigned int ty);
+	size_t CountCells(const World& world, uint8_t material, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const;
+
+	unsigned int mWidth = 0;
+	unsigned int mHeight = 0;
+	unsigned int mMaterials = 0;
+	unsigned int mTilesX = 0;
+	unsigned int mTilesY = 0;
+	unsigned int mChunksX = 0;
+
+	// counts per tile and per chunk, mMaterials entries each
+	std::vector<uint8_t> mTiles;
+	std::vector<uint16_t> mChunks;
+	std::vector<size_t> mTotals;
+
+	// (mTilesX + 1) x (mTilesY + 1) sums of the tiles above and left of each
+	// corner, valid up to row mTableRow of tiles
+	std::vector<uint32_t> mTable;
+	unsigned int mTableRow = 0;
+
+	bool mRebuild = false;
+	uint64_t mCheckpoint = 0;
+};
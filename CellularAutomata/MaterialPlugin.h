@@ -0,0 +1,83 @@
+#pragma once
+
+#include "ParticleSim.h"
+
+// Interface between the simulation and material plugins, shared objects that
+// add materials without touching the simulation sources.
+//
+// A plugin exports RegisterMaterials (see MATERIAL_PLUGIN_EXPORT), which adds
+// its materials to the table through the registry it is handed. Each material
+// brings a kernel. The sweep hands a kernel whole runs of neighbouring cells
+// of its material at once, in sweep order, so a kernel pays for one call per
+// run rather than one per cell. Cells earlier in the run may have been changed
+// by the time a later one comes up, a kernel has to check the id and the
+// updated flag of every cell.
+//
+// Kernels cannot call into the simulation binary. They go through the context
+// for randomness and writes, which also keeps runs reproducible and lets
+// change tracking see every write. Like the built in materials they must not
+// reach further than updateReachX / updateReachY from the cell they update,
+// or domain decomposed runs go wrong.
+#define MATERIAL_PLUGIN_VERSION 2
+
+struct MaterialKernelContext
+{
+	Particle* particles;	// row major, width * height
+	uint32_t width;
+	uint32_t height;
+	float gravity;
+
+	void* sim;
+	uint32_t (*random)(void* sim);
+	void (*write)(void* sim, uint32_t idx, const Particle* p);
+};
+
+// Update count cells of row y, starting at x and moving by step (1 or -1).
+typedef void (*MaterialKernel)(const MaterialKernelContext* ctx, uint32_t x, uint32_t y, uint32_t count, int step, float dt);
+
+enum MaterialTraits : uint32_t
+{
+	materialAges = 1,	// life_time advances every frame
+	materialExpires = 2,	// dies of old age, a world holding it has not settled
+};
+
+struct MaterialDesc
+{
+	const char* name;
+	uint8_t color[4];
+	uint32_t traits;
+	MaterialKernel kernel;
+
+	// The material updates every updateDivisor-th tick, and every
+	// restingDivisor-th while nothing moved in its chunk, with dt scaled to
+	// match. 0 or 1 for every tick.
+	uint8_t updateDivisor;
+	uint8_t restingDivisor;
+};
+
+struct MaterialRegistry
+{
+	uint32_t version;
+	void* table;
+
+	// id given to the material, mat_id_empty when the table is full
+	uint8_t (*add)(void* table, const MaterialDesc* desc);
+};
+
+typedef bool (*RegisterMaterialsFunc)(MaterialRegistry* registry);
+
+#ifdef _WIN32
+#define MATERIAL_PLUGIN_EXPORT extern "C" __declspec(dllexport)
+#else
+#define MATERIAL_PLUGIN_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// inline helpers for kernels
+inline uint32_t KernelRandom(const MaterialKernelContext* ctx, uint32_t range) { return ctx->random(ctx->sim) % range; }
+inline bool KernelInBounds(const MaterialKernelContext* ctx, int x, int y) { return x >= 0 && y >= 0 && uint32_t(x) < ctx->width && uint32_t(y) < ctx->height; }
+inline Particle& KernelCell(const MaterialKernelContext* ctx, int x, int y) { return ctx->particles[size_t(y) * ctx->width + x]; }
+inline void KernelWrite(const MaterialKernelContext* ctx, int x, int y, const Particle& p) { ctx->write(ctx->sim, uint32_t(y) * ctx->width + x, &p); }
+
+// Kernels live outside the simulation's binary and cannot call into it, this
+// stands in for ParticleSim::ParticleEmpty().
+inline Particle KernelEmpty() { Particle p{}; return p; }
@@ -0,0 +1,156 @@
+#include "MaterialTable.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace
+{
+	struct Table
+	{
+		Table()
+		{
+			// only the materials whose rules read life_time age, so resting sand
+			// and stone leave their chunks clean
+			const char* names[mat_id_count] = { "empty", "sand", "water", "stone", "fire", "smoke", "steam" };
+			for (uint8_t id = 0; id < mat_id_count; ++id) {
+				entries[id] = std::make_unique<MaterialEntry>();
+				entries[id]->name = names[id];
+				entries[id]->spawn = ParticleSim::CreateParticle(id);
+			}
+			entries[mat_id_water]->traits = materialAges;
+			entries[mat_id_fire]->traits = materialAges | materialExpires;
+			entries[mat_id_smoke]->traits = materialAges | materialExpires;
+			entries[mat_id_steam]->traits = materialAges | materialExpires;
+
+			// powders and fire update every tick, gases every 2nd and resting water every 4th
+			entries[mat_id_water]->rate = { 1, 4 };
+			entries[mat_id_smoke]->rate = { 2, 2 };
+			entries[mat_id_steam]->rate = { 2, 2 };
+
+			for (unsigned int id = 0; id < maxMaterials; ++id) {
+				ages[id] = entries[id] && (entries[id]->traits & materialAges);
+				expires[id] = entries[id] && (entries[id]->traits & materialExpires);
+				rates[id] = entries[id] ? entries[id]->rate : MaterialRate();
+			}
+			count = mat_id_count;
+		}
+
+		std::array<std::unique_ptr<MaterialEntry>, maxMaterials> entries;
+		std::array<bool, maxMaterials> ages;
+		std::array<bool, maxMaterials> expires;
+		std::array<MaterialRate, maxMaterials> rates;
+		unsigned int count;
+	};
+
+	Table& GetTable()
+	{
+		static Table table;
+		return table;
+	}
+
+	uint8_t AddFromPlugin(void*, const MaterialDesc* desc)
+	{
+		return RegisterMaterial(*desc);
+	}
+}
+
+const MaterialEntry* FindMaterial(uint8_t id)
+{
+	return GetTable().entries[id].get();
+}
+
+uint8_t FindMaterial(const std::string& name)
+{
+	const Table& table = GetTable();
+	for (unsigned int id = 1; id < table.count; ++id)
+		if (table.entries[id]->name == name)
+			return static_cast<uint8_t>(id);
+	return mat_id_empty;
+}
+
+unsigned int MaterialCount()
+{
+	return GetTable().count;
+}
+
+bool MaterialAges(uint8_t id)
+{
+	return GetTable().ages[id];
+}
+
+const bool* MaterialAgeFlags()
+{
+	return GetTable().ages.data();
+}
+
+const bool* MaterialExpireFlags()
+{
+	return GetTable().expires.data();
+}
+
+const MaterialRate* MaterialRates()
+{
+	return GetTable().rates.data();
+}
+
+uint8_t RegisterMaterial(const MaterialDesc& desc)
+{
+	Table& table = GetTable();
+	if (table.count == maxMaterials || desc.kernel == nullptr)
+		return mat_id_empty;
+
+	const uint8_t id = static_cast<uint8_t>(table.count++);
+	auto entry = std::make_unique<MaterialEntry>();
+	entry->name = desc.name != nullptr ? desc.name : "material " + std::to_string(id);
+	entry->spawn = ParticleSim::ParticleEmpty();
+	entry->spawn.id = id;
+	entry->spawn.color = Color32(desc.color[0], desc.color[1], desc.color[2], desc.color[3]);
+	entry->traits = desc.traits;
+	entry->rate.every = (std::max)(desc.updateDivisor, uint8_t(1));
+	entry->rate.resting = (std::max)(desc.restingDivisor, entry->rate.every);
+	entry->kernel = desc.kernel;
+	table.ages[id] = (desc.traits & materialAges) != 0;
+	table.expires[id] = (desc.traits & materialExpires) != 0;
+	table.rates[id] = entry->rate;
+	table.entries[id] = std::move(entry);
+	return id;
+}
+
+bool LoadMaterialPlugin(const std::string& path, std::string& error)
+{
+#ifdef _WIN32
+	HMODULE module = LoadLibraryA(path.c_str());
+	if (module == nullptr) {
+		error = "could not load " + path;
+		return false;
+	}
+	auto entry = reinterpret_cast<RegisterMaterialsFunc>(GetProcAddress(module, "RegisterMaterials"));
+#else
+	void* module = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (module == nullptr) {
+		error = dlerror();
+		return false;
+	}
+	auto entry = reinterpret_cast<RegisterMaterialsFunc>(dlsym(module, "RegisterMaterials"));
+#endif
+
+	MaterialRegistry registry = { MATERIAL_PLUGIN_VERSION, nullptr, AddFromPlugin };
+	if (entry != nullptr && entry(&registry))
+		return true;
+
+	error = entry == nullptr ? path + " does not export RegisterMaterials" : path + " refused to register its materials";
+#ifdef _WIN32
+	FreeLibrary(module);
+#else
+	dlclose(module);
+#endif
+	return false;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "MaterialPlugin.h"
+
+#include <string>
+
+// How often a material updates: every nth tick, and every nth while nothing
+// moved in its chunk during the last tick. resting is never below every.
+struct MaterialRate
+{
+	uint8_t every = 1;
+	uint8_t resting = 1;
+};
+
+// Every material the simulation knows: the built in ones, which the sweep
+// updates directly, followed by the ones plugins registered, which it updates
+// through their kernels. Register materials at startup, before simulating.
+struct MaterialEntry
+{
+	std::string name;
+	Particle spawn;				// particle Paint places
+	uint32_t traits = 0;
+	MaterialRate rate;
+	MaterialKernel kernel = nullptr;	// null for built in materials
+};
+
+constexpr unsigned int maxMaterials = 256;
+
+// Entry of material id, null for ids nobody registered.
+const MaterialEntry* FindMaterial(uint8_t id);
+
+// Id of the material called name, mat_id_empty when there is none.
+uint8_t FindMaterial(const std::string& name);
+
+// Ids in use, the built in ones included.
+unsigned int MaterialCount();
+
+// Add a material, returns its id or mat_id_empty when the table is full.
+uint8_t RegisterMaterial(const MaterialDesc& desc);
+
+// True when the material's life_time advances every frame.
+bool MaterialAges(uint8_t id);
+
+// The same for every id at once, maxMaterials flags for hot loops.
+const bool* MaterialAgeFlags();
+
+// maxMaterials flags, true for the materials that die of old age
+const bool* MaterialExpireFlags();
+
+// The rate of every id at once, maxMaterials entries for hot loops.
+const MaterialRate* MaterialRates();
+
+// Load a plugin and let it register its materials. Plugins stay loaded for
+// the rest of the run. On failure error says why.
+bool LoadMaterialPlugin(const std::string& path, std::string& error);
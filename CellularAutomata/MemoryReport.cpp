@@ -0,0 +1,35 @@
+#include "MemoryReport.h"
+
+#include <cstdio>
+
+size_t MemoryReport::Total() const
+{
+	size_t total = 0;
+	for (const MemoryItem& item : mItems)
+		total += item.bytes;
+	return total;
+}
+
+std::string MemoryReport::Format() const
+{
+	std::string text;
+	char line[128];
+	for (const MemoryItem& item : mItems) {
+		std::snprintf(line, sizeof(line), "%-28s %10.2f MB\n", item.name.c_str(), item.bytes / 1048576.0);
+		text += line;
+	}
+	std::snprintf(line, sizeof(line), "%-28s %10.2f MB\n", "total", Total() / 1048576.0);
+	return text + line;
+}
+
+void AddWorldMemory(MemoryReport& report, const World& world)
+{
+	const size_t fieldBytes = sizeof(Particle::id) + sizeof(Particle::life_time) + sizeof(Particle::velocity)
+		+ sizeof(Particle::color) + sizeof(Particle::has_been_updated_this_frame);
+	const size_t cells = world.particles.size();
+
+	report.Add("particles", cells * fieldBytes);
+	report.Add("particle padding", cells * (sizeof(Particle) - fieldBytes));
+	report.Add("colors (render copy)", world.colors.size() * sizeof(Color32));
+	report.Add("chunk stamps", world.chunkStamps.size() * sizeof(uint64_t));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "ParticleSim.h"
+
+#include <string>
+#include <vector>
+
+// Bytes held by the parts of a run, to see what a world size costs.
+struct MemoryItem
+{
+	std::string name;
+	size_t bytes;
+};
+
+class MemoryReport
+{
+public:
+	void Add(const std::string& name, size_t bytes) { mItems.push_back({ name, bytes }); }
+
+	const std::vector<MemoryItem>& Items() const { return mItems; }
+	size_t Total() const;
+
+	// one line per item and the total, in MB
+	std::string Format() const;
+
+private:
+	std::vector<MemoryItem> mItems;
+};
+
+// The planes of world. The particle plane is split into the bytes the fields
+// use and the padding the compiler put between them.
+void AddWorldMemory(MemoryReport& report, const World& world);
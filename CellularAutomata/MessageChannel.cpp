@@ -0,0 +1,72 @@
+#include "MessageChannel.h"
+
+bool MessageChannel::Connect(const std::string& host, uint16_t port)
+{
+	mOutbox.clear();
+	mInbox.clear();
+	mSent = 0;
+	return mSocket.Connect(host, port);
+}
+
+void MessageChannel::BeginMessage(uint8_t type)
+{
+	// drop what was sent already before the outbox grows again
+	if (mSent == mOutbox.size()) {
+		mOutbox.clear();
+		mSent = 0;
+	}
+
+	mMessageStart = mOutbox.size();
+	const uint32_t length = 0;
+	Write(length);
+	mOutbox.push_back(type);
+}
+
+void MessageChannel::Write(const void* data, size_t size)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	mOutbox.insert(mOutbox.end(), p, p + size);
+}
+
+void MessageChannel::Patch(size_t payloadOffset, const void* data, size_t size)
+{
+	std::memcpy(&mOutbox[mMessageStart + headerSize + payloadOffset], data, size);
+}
+
+void MessageChannel::EndMessage()
+{
+	const uint32_t length = static_cast<uint32_t>(mOutbox.size() - mMessageStart - sizeof(uint32_t));
+	std::memcpy(&mOutbox[mMessageStart], &length, sizeof(length));
+}
+
+bool MessageChannel::Flush()
+{
+	while (mSent < mOutbox.size()) {
+		const long long sent = mSocket.SendSome(mOutbox.data() + mSent, mOutbox.size() - mSent);
+		if (sent < 0) {
+			mSocket.Close();
+			return false;
+		}
+		if (sent == 0)
+			break;
+		mSent += static_cast<size_t>(sent);
+		mBytesSent += static_cast<uint64_t>(sent);
+	}
+	return mSocket.Valid();
+}
+
+bool MessageChannel::Fill()
+{
+	uint8_t buffer[64 * 1024];
+	for (;;) {
+		const long long received = mSocket.ReceiveSome(buffer, sizeof(buffer));
+		if (received < 0) {
+			mSocket.Close();
+			return false;
+		}
+		if (received == 0)
+			return true;
+		mInbox.insert(mInbox.end(), buffer, buffer + received);
+		mBytesReceived += static_cast<uint64_t>(received);
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Socket.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Length prefixed messages over a non-blocking socket. Every message is a
+// uint32 length (of what follows), a type byte and the payload. Outgoing
+// messages collect in an outbox that Flush() pushes out as far as the socket
+// takes it, so a slow peer never blocks the caller.
+class MessageChannel
+{
+public:
+	MessageChannel() = default;
+	explicit MessageChannel(Socket socket) : mSocket(std::move(socket)) {}
+
+	bool Connect(const std::string& host, uint16_t port);
+	void Close() { mSocket.Close(); }
+	bool Open() const { return mSocket.Valid(); }
+
+	// Start a message, append its payload with Write(), then EndMessage().
+	void BeginMessage(uint8_t type);
+	void Write(const void* data, size_t size);
+	template <typename T> void Write(const T& value) { Write(&value, sizeof(T)); }
+	void EndMessage();
+
+	// Overwrite bytes of the message being built, at an offset into its payload.
+	void Patch(size_t payloadOffset, const void* data, size_t size);
+	size_t PayloadSize() const { return mOutbox.size() - mMessageStart - headerSize; }
+
+	// Send what the socket takes now. False once the connection failed.
+	bool Flush();
+	bool HasPending() const { return mSent < mOutbox.size(); }
+
+	// Receive what arrived and call handle(type, data, size) for every complete
+	// message. False once the connection closed or handle returned false.
+	template <typename Handle>
+	bool Receive(Handle&& handle);
+
+	// bytes the outgoing and incoming buffers hold on to
+	size_t MemoryBytes() const { return mOutbox.capacity() + mInbox.capacity(); }
+
+	uint64_t BytesSent() const { return mBytesSent; }
+	uint64_t BytesReceived() const { return mBytesReceived; }
+
+private:
+	static constexpr size_t headerSize = sizeof(uint32_t) + 1;
+
+	// largest message accepted, guards against a corrupt length
+	static constexpr uint32_t maxMessageSize = 1u << 30;
+
+	bool Fill();
+
+	Socket mSocket;
+	std::vector<uint8_t> mOutbox;
+	size_t mSent = 0;
+	size_t mMessageStart = 0;
+	std::vector<uint8_t> mInbox;
+	uint64_t mBytesSent = 0;
+	uint64_t mBytesReceived = 0;
+};
+
+template <typename Handle>
+bool MessageChannel::Receive(Handle&& handle)
+{
+	const bool open = Fill();
+
+	size_t offset = 0;
+	bool ok = true;
+	while (ok && mInbox.size() - offset >= headerSize) {
+		uint32_t length;
+		std::memcpy(&length, &mInbox[offset], sizeof(length));
+		if (length == 0 || length > maxMessageSize) {
+			ok = false;
+			break;
+		}
+		if (mInbox.size() - offset - sizeof(uint32_t) < length)
+			break;
+
+		const uint8_t* message = &mInbox[offset + sizeof(uint32_t)];
+		ok = handle(message[0], message + 1, static_cast<size_t>(length - 1));
+		offset += sizeof(uint32_t) + length;
+	}
+	mInbox.erase(mInbox.begin(), mInbox.begin() + offset);
+
+	if (!ok)
+		mSocket.Close();
+	return ok && open;
+}
@@ -0,0 +1,250 @@
+#include "OccupancyPyramid.h"
+
+#include "ParticleSim.h"
+
+#include <algorithm>
+
+namespace
+{
+	// every material but stone has an update rule
+	bool IsDynamic(uint8_t id)
+	{
+		return id != mat_id_empty && id != mat_id_stone;
+	}
+
+	bool HasFlag(const Particle& p, OccupancyPyramid::Flag flag)
+	{
+		switch (flag) {
+		case OccupancyPyramid::filled: return p.id != mat_id_empty;
+		case OccupancyPyramid::empty: return p.id == mat_id_empty;
+		default: return IsDynamic(p.id);
+		}
+	}
+}
+
+void OccupancyPyramid::Build(World& world)
+{
+	mWidth = world.width;
+	mHeight = world.height;
+
+	mLevels.clear();
+	unsigned int w = (mWidth + tileSize - 1) >> tileShift;
+	unsigned int h = (mHeight + tileSize - 1) >> tileShift;
+	for (;;) {
+		Level level;
+		level.width = w;
+		level.height = h;
+		level.flags.assign(static_cast<size_t>(w) * h, 0);
+		mLevels.push_back(std::move(level));
+		if (w == 1 && h == 1)
+			break;
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+
+	const size_t tiles = mLevels[0].flags.size();
+	mFilled.assign(tiles, 0);
+	mDynamic.assign(tiles, 0);
+	for (unsigned int ty = 0; ty < mLevels[0].height; ++ty)
+		for (unsigned int tx = 0; tx < mLevels[0].width; ++tx)
+			Recount(world, tx, ty);
+
+	mCheckpoint = world.Checkpoint();
+}
+
+void OccupancyPyramid::Sync(World& world)
+{
+	if (mLevels.empty() || mWidth != world.width || mHeight != world.height) {
+		Build(world);
+		return;
+	}
+
+	constexpr unsigned int tilesPerChunk = chunkSize >> tileShift;
+	for (unsigned int cy = 0; cy < world.chunksY; ++cy) {
+		for (unsigned int cx = 0; cx < world.chunksX; ++cx) {
+			if (!world.ChangedSince(cy * world.chunksX + cx, mCheckpoint))
+				continue;
+
+			const unsigned int tx1 = std::min((cx + 1) * tilesPerChunk, mLevels[0].width);
+			const unsigned int ty1 = std::min((cy + 1) * tilesPerChunk, mLevels[0].height);
+			for (unsigned int ty = cy * tilesPerChunk; ty < ty1; ++ty)
+				for (unsigned int tx = cx * tilesPerChunk; tx < tx1; ++tx)
+					Recount(world, tx, ty);
+		}
+	}
+
+	mCheckpoint = world.Checkpoint();
+}
+
+void OccupancyPyramid::Skip(World& world)
+{
+	mCheckpoint = world.Checkpoint();
+}
+
+void OccupancyPyramid::Change(unsigned int x, unsigned int y, uint8_t from, uint8_t to)
+{
+	if (mLevels.empty())
+		return;
+
+	const unsigned int tx = x >> tileShift;
+	const unsigned int ty = y >> tileShift;
+	const size_t tile = static_cast<size_t>(ty) * mLevels[0].width + tx;
+	mFilled[tile] += (to != mat_id_empty) - (from != mat_id_empty);
+	mDynamic[tile] += IsDynamic(to) - IsDynamic(from);
+
+	const uint8_t flags = TileState(tile, tx, ty);
+	if (flags != mLevels[0].flags[tile])
+		Propagate(tx, ty, flags);
+}
+
+uint8_t OccupancyPyramid::TileState(size_t tile, unsigned int tx, unsigned int ty) const
+{
+	// tiles at the right and bottom edge may be cut short by the world
+	const unsigned int w = std::min(tileSize, mWidth - (tx << tileShift));
+	const unsigned int h = std::min(tileSize, mHeight - (ty << tileShift));
+
+	uint8_t flags = 0;
+	if (mFilled[tile] > 0)
+		flags |= filled;
+	if (mFilled[tile] < w * h)
+		flags |= empty;
+	if (mDynamic[tile] > 0)
+		flags |= dynamic;
+	return flags;
+}
+
+void OccupancyPyramid::Recount(const World& world, unsigned int tx, unsigned int ty)
+{
+	const size_t tile = static_cast<size_t>(ty) * mLevels[0].width + tx;
+	const unsigned int x0 = tx << tileShift;
+	const unsigned int y0 = ty << tileShift;
+	const unsigned int x1 = std::min(x0 + tileSize, mWidth);
+	const unsigned int y1 = std::min(y0 + tileSize, mHeight);
+
+	unsigned int filledCells = 0;
+	unsigned int dynamicCells = 0;
+	for (unsigned int y = y0; y < y1; ++y) {
+		const Particle* row = &world.particles[static_cast<size_t>(y) * mWidth];
+		for (unsigned int x = x0; x < x1; ++x) {
+			filledCells += row[x].id != mat_id_empty;
+			dynamicCells += IsDynamic(row[x].id);
+		}
+	}
+	mFilled[tile] = static_cast<uint8_t>(filledCells);
+	mDynamic[tile] = static_cast<uint8_t>(dynamicCells);
+
+	const uint8_t flags = TileState(tile, tx, ty);
+	if (flags != mLevels[0].flags[tile])
+		Propagate(tx, ty, flags);
+}
+
+void OccupancyPyramid::Propagate(unsigned int tx, unsigned int ty, uint8_t flags)
+{
+	mLevels[0].flags[static_cast<size_t>(ty) * mLevels[0].width + tx] = flags;
+
+	// a parent is the union of its children; stop where it stays the same
+	unsigned int nx = tx;
+	unsigned int ny = ty;
+	for (size_t level = 1; level < mLevels.size(); ++level) {
+		const Level& below = mLevels[level - 1];
+		nx >>= 1;
+		ny >>= 1;
+
+		uint8_t merged = 0;
+		const unsigned int cx1 = std::min(nx * 2 + 2, below.width);
+		const unsigned int cy1 = std::min(ny * 2 + 2, below.height);
+		for (unsigned int cy = ny * 2; cy < cy1; ++cy)
+			for (unsigned int cx = nx * 2; cx < cx1; ++cx)
+				merged |= below.flags[static_cast<size_t>(cy) * below.width + cx];
+
+		uint8_t& node = mLevels[level].flags[static_cast<size_t>(ny) * mLevels[level].width + nx];
+		if (node == merged)
+			break;
+		node = merged;
+	}
+}
+
+bool OccupancyPyramid::Clip(int& x0, int& y0, int& x1, int& y1) const
+{
+	x0 = std::max(x0, 0);
+	y0 = std::max(y0, 0);
+	x1 = std::min(x1, static_cast<int>(mWidth));
+	y1 = std::min(y1, static_cast<int>(mHeight));
+	return x0 < x1 && y0 < y1;
+}
+
+bool OccupancyPyramid::MayHave(Flag flag, int x0, int y0, int x1, int y1) const
+{
+	if (mLevels.empty())
+		return true;
+	if (!Clip(x0, y0, x1, y1))
+		return false;
+
+	// the lowest level whose nodes are at least as large as the rectangle
+	const unsigned int extent = static_cast<unsigned int>(std::max(x1 - x0, y1 - y0));
+	unsigned int level = 0;
+	while (level + 1 < mLevels.size() && (tileSize << level) < extent)
+		++level;
+
+	const unsigned int shift = tileShift + level;
+	for (unsigned int ny = unsigned(y0) >> shift; ny <= unsigned(y1 - 1) >> shift; ++ny)
+		for (unsigned int nx = unsigned(x0) >> shift; nx <= unsigned(x1 - 1) >> shift; ++nx)
+			if (Node(level, nx, ny) & flag)
+				return true;
+	return false;
+}
+
+bool OccupancyPyramid::Any(const World& world, Flag flag, int x0, int y0, int x1, int y1) const
+{
+	if (!Clip(x0, y0, x1, y1))
+		return false;
+
+	const unsigned int top = Levels() - 1;
+	for (unsigned int ny = 0; ny < mLevels[top].height; ++ny)
+		for (unsigned int nx = 0; nx < mLevels[top].width; ++nx)
+			if (AnyIn(world, flag, top, nx, ny, x0, y0, x1, y1))
+				return true;
+	return false;
+}
+
+bool OccupancyPyramid::AnyIn(const World& world, Flag flag, unsigned int level, unsigned int nx, unsigned int ny,
+	unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const
+{
+	if (!(Node(level, nx, ny) & flag))
+		return false;
+
+	// the cells of the node inside the world, and the part of them in the rectangle
+	const unsigned int shift = tileShift + level;
+	const unsigned int nx0 = nx << shift, ny0 = ny << shift;
+	const unsigned int nx1 = std::min(nx0 + (1u << shift), mWidth);
+	const unsigned int ny1 = std::min(ny0 + (1u << shift), mHeight);
+	const unsigned int ix0 = std::max(nx0, x0), iy0 = std::max(ny0, y0);
+	const unsigned int ix1 = std::min(nx1, x1), iy1 = std::min(ny1, y1);
+	if (ix0 >= ix1 || iy0 >= iy1)
+		return false;
+	if (ix0 == nx0 && iy0 == ny0 && ix1 == nx1 && iy1 == ny1)
+		return true;
+
+	if (level == 0) {
+		for (unsigned int y = iy0; y < iy1; ++y)
+			for (unsigned int x = ix0; x < ix1; ++x)
+				if (HasFlag(world.particles[static_cast<size_t>(y) * mWidth + x], flag))
+					return true;
+		return false;
+	}
+
+	const Level& below = mLevels[level - 1];
+	for (unsigned int cy = ny * 2; cy < std::min(ny * 2 + 2, below.height); ++cy)
+		for (unsigned int cx = nx * 2; cx < std::min(nx * 2 + 2, below.width); ++cx)
+			if (AnyIn(world, flag, level - 1, cx, cy, x0, y0, x1, y1))
+				return true;
+	return false;
+}
+
+size_t OccupancyPyramid::MemoryBytes() const
+{
+	size_t bytes = mFilled.size() + mDynamic.size();
+	for (const Level& level : mLevels)
+		bytes += level.flags.size();
+	return bytes;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct World;
+
+// Which parts of a world hold anything, as a pyramid of levels. Level 0 has
+// one node per tileSize x tileSize tile of cells, every level above one node
+// per 2x2 nodes of the level below, up to a single node for the whole world.
+// A node flags whether its cells include any filled (non-empty), any empty and
+// any dynamic cells, those of materials with an update rule; only stone has
+// none. A node without the empty flag is known full.
+//
+// The owning sim reports every change of material through Change(), which
+// keeps the pyramid exact in the middle of a sweep, and Sync() recounts the
+// chunks edited through the world directly since the last call.
+class OccupancyPyramid
+{
+public:
+	enum Flag : uint8_t { filled = 1, empty = 2, dynamic = 4 };
+
+	static constexpr unsigned int tileShift = 2;
+	static constexpr unsigned int tileSize = 1u << tileShift;
+
+	// Count every tile of world afresh.
+	void Build(World& world);
+
+	// Recount the chunks changed since the last Build or Sync, rebuilding all
+	// when the size of world changed.
+	void Sync(World& world);
+
+	// Ignore the changes made to world so far, Change() reported them all.
+	void Skip(World& world);
+
+	// the cell at (x, y) turned from material from into to
+	void Change(unsigned int x, unsigned int y, uint8_t from, uint8_t to);
+
+	unsigned int Levels() const { return static_cast<unsigned int>(mLevels.size()); }
+	unsigned int LevelWidth(unsigned int level) const { return mLevels[level].width; }
+	unsigned int LevelHeight(unsigned int level) const { return mLevels[level].height; }
+
+	// flags of a node, and of the tile holding cell (x, y)
+	uint8_t Node(unsigned int level, unsigned int nx, unsigned int ny) const { return mLevels[level].flags[ny * mLevels[level].width + nx]; }
+	uint8_t TileFlags(unsigned int x, unsigned int y) const { return Node(0, x >> tileShift, y >> tileShift); }
+
+	// Whether [x0, x1) x [y0, y1) may hold cells with flag, from the at most
+	// 2x2 nodes of the level covering it. False means it holds none, so a
+	// search for such cells there can be skipped; the rectangle is clipped to
+	// the world first.
+	bool MayHave(Flag flag, int x0, int y0, int x1, int y1) const;
+
+	// Whether the rectangle holds cells with flag, exactly. Descends only into
+	// nodes that have it and reads cells only in the tiles at its border.
+	bool Any(const World& world, Flag flag, int x0, int y0, int x1, int y1) const;
+
+	size_t MemoryBytes() const;
+
+private:
+	struct Level
+	{
+		unsigned int width = 0;
+		unsigned int height = 0;
+		std::vector<uint8_t> flags;
+	};
+
+	bool Clip(int& x0, int& y0, int& x1, int& y1) const;
+	bool AnyIn(const World& world, Flag flag, unsigned int level, unsigned int nx, unsigned int ny,
+		unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const;
+
+	uint8_t TileState(size_t tile, unsigned int tx, unsigned int ty) const;
+	void Recount(const World& world, unsigned int tx, unsigned int ty);
+	void Propagate(unsigned int tx, unsigned int ty, uint8_t flags);
+
+	unsigned int mWidth = 0;
+	unsigned int mHeight = 0;
+	std::vector<Level> mLevels;
+
+	// cells per tile that are filled and dynamic
+	std::vector<uint8_t> mFilled;
+	std::vector<uint8_t> mDynamic;
+
+	uint64_t mCheckpoint = 0;
+};
@@ -0,0 +1,1149 @@
+#include "ParticleSim.h"
+
+#include "MaterialTable.h"
+
+#include <algorithm>
+#include <climits>
+
+void CountMaterials(const World& world, size_t counts[mat_id_count])
+{
+	std::fill(counts, counts + mat_id_count, 0);
+	for (const Particle& p : world.particles) {
+		if (p.id < mat_id_count)
+			++counts[p.id];
+	}
+}
+
+uint64_t ComputeChecksum(const World& world)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (const Particle& p : world.particles) {
+		hash ^= p.id;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+ParticleSim::ParticleSim(unsigned int width, unsigned int height, uint32_t seed)
+	: mWorld(width, height), mRandom(seed)
+{
+}
+
+void ParticleSim::Paint(int x, int y, float radius, uint8_t material)
+{
+	unsigned int mp_x = std::clamp(static_cast<unsigned int>(x), 0u, mWorld.width - 1);
+	unsigned int mp_y = std::clamp(static_cast<unsigned int>(y), 0u, mWorld.height - 1);
+	unsigned int max_idx = (mWorld.width * mWorld.height) - 1;
+	unsigned int r_amt = RandomVal(1, 10000);
+	const float R = radius;
+	const float pi = 3.1415926535f;
+
+	// Spawn in a circle around the point
+	for (unsigned int i = 0; i < r_amt; ++i)
+	{
+		float ran = (float)RandomVal(0, 100) / 100.f;
+		float r = R * sqrt(ran);
+		float theta = (float)RandomVal(0, 100) / 100.f * 2.f * pi;
+		unsigned int rx = static_cast<unsigned int>(cos(theta) * r);
+		unsigned int ry = static_cast<unsigned int>(sin(theta) * r);
+		unsigned int mpx = std::clamp(mp_x + rx, 0u, mWorld.width - 1);
+		unsigned int mpy = std::clamp(mp_y + ry, 0u, mWorld.height - 1);
+		unsigned int idx = mpy * mWorld.width + mpx;
+		idx = std::clamp(idx, 0u, max_idx);
+
+		if (IsEmpty(mpx, mpy))
+		{
+			Particle p = CreateParticle(material);
+			p.velocity = Vec2{ static_cast<float>(RandomVal(-1, 1)), static_cast<float>(RandomVal(-2, 5)) };
+			WriteData(idx, p);
+		}
+	}
+}
+
+void ParticleSim::Erase(int x, int y, float radius)
+{
+	unsigned int mp_x = std::clamp(static_cast<unsigned int>(x), 0u, mWorld.width - 1);
+	unsigned int mp_y = std::clamp(static_cast<unsigned int>(y), 0u, mWorld.height - 1);
+	const float R = radius;
+
+	// Erase in a circle pattern
+	for (int i = -R; i < R; ++i)
+	{
+		for (int j = -R; j < R; ++j)
+		{
+			unsigned int rx = mp_x + j;
+			unsigned int ry = mp_y + i;
+			Vec2 d = Vec2{ static_cast<float>(x) - static_cast<float>(rx), static_cast<float>(y) - static_cast<float>(ry) };
+			if (InBounds(rx, ry) && d.Length() <= R) {
+				WriteData(ComputeID(rx, ry), ParticleEmpty());
+			}
+		}
+	}
+}
+
+void ParticleSim::Clear()
+{
+	std::vector<Particle> tempData{ mWorld.particles.size() }; // construct a new scene with default data
+	mWorld.particles.assign(tempData.begin(), tempData.end()); // overwrite existing data
+
+	std::fill(mWorld.colors.begin(), mWorld.colors.end(), Color32(0, 0, 0, 0));
+	mWorld.TouchAll();
+}
+
+Particle ParticleSim::CreateParticle(uint8_t material)
+{
+	switch (material) {
+	case mat_id_sand:  return ParticleSand();
+	case mat_id_water: return ParticleWater();
+	case mat_id_stone: return ParticleStone();
+	case mat_id_fire:  return ParticleFire();
+	case mat_id_smoke: return ParticleSmoke();
+	case mat_id_steam: return ParticleSteam();
+	case mat_id_empty: return ParticleEmpty();
+	default: {
+		const MaterialEntry* entry = FindMaterial(material);
+		return entry != nullptr ? entry->spawn : ParticleEmpty();
+	}
+	}
+}
+
+Particle ParticleSim::ParticleEmpty()
+{
+	Particle p = { 0 };
+	p.id = mat_id_empty;
+	p.color = mat_col_empty;
+	return p;
+}
+
+Particle ParticleSim::ParticleSand()
+{
+	Particle p = { 0 };
+	p.id = mat_id_sand;
+	// Random sand color
+	p.color.r = 204;
+	p.color.g = 127;
+	p.color.b = 51;
+	p.color.a = 255;
+	return p;
+}
+
+Particle ParticleSim::ParticleWater()
+{
+	Particle p = { 0 };
+	p.id = mat_id_water;
+	p.color.r = 25;
+	p.color.g = 76;
+	p.color.b = 178;
+	p.color.a = 255;
+	return p;
+}
+
+Particle ParticleSim::ParticleStone()
+{
+	Particle p = { 0 };
+	p.id = mat_id_stone;
+	p.color.r = 128;
+	p.color.g = 128;
+	p.color.b = 128;
+	p.color.a = 255;
+	return p;
+}
+
+Particle ParticleSim::ParticleFire()
+{
+	Particle p = { 0 };
+	p.id = mat_id_fire;
+	p.color = mat_col_fire;
+	return p;
+}
+
+Particle ParticleSim::ParticleSmoke()
+{
+	Particle p = { 0 };
+	p.id = mat_id_smoke;
+	p.color = mat_col_smoke;
+	return p;
+}
+
+Particle ParticleSim::ParticleSteam()
+{
+	Particle p = { 0 };
+	p.id = mat_id_steam;
+	p.color = mat_col_steam;
+	return p;
+}
+
+void ParticleSim::Step(float dt)
+{
+	Step(dt, 0, mWorld.width, 0, mWorld.height);
+}
+
+void ParticleSim::StepMany(unsigned int ticks, float dt)
+{
+	const uint64_t checkpoint = mWorld.Checkpoint();
+	mResolveColors = false;
+	for (unsigned int i = 0; i < ticks; ++i)
+		Step(dt);
+	mResolveColors = true;
+
+	if (mProfiler != nullptr)
+		mProfiler->PhaseBegin(SimPhase::colorResolve);
+
+	// every write touches its chunk, so the untouched chunks' colors are current
+	for (unsigned int cy = 0; cy < mWorld.chunksY; ++cy) {
+		for (unsigned int cx = 0; cx < mWorld.chunksX; ++cx) {
+			if (!mWorld.ChangedSince(cy * mWorld.chunksX + cx, checkpoint))
+				continue;
+
+			const unsigned int x0 = cx << chunkShift;
+			const unsigned int x1 = std::min(x0 + chunkSize, mWorld.width);
+			const unsigned int y1 = std::min((cy + 1) << chunkShift, mWorld.height);
+			for (unsigned int y = cy << chunkShift; y < y1; ++y) {
+				const size_t row = static_cast<size_t>(y) * mWorld.width;
+				for (unsigned int x = x0; x < x1; ++x)
+					mWorld.colors[row + x] = mWorld.particles[row + x].color;
+			}
+		}
+	}
+
+	if (mProfiler != nullptr)
+		mProfiler->PhaseEnd(SimPhase::colorResolve);
+}
+
+void ParticleSim::Step(float dt, unsigned int xBegin, unsigned int xEnd, unsigned int yBegin, unsigned int yEnd)
+{
+	// Update frame counter ( loop back to 0 if we roll past unsigned int max )
+	mFrameCounter = (mFrameCounter + 1) % UINT_MAX;
+	mCellsChanged = 0;
+	bool frame_counter_even = ((mFrameCounter % 2) == 0);
+	unsigned int ran = frame_counter_even ? 0 : 1;
+
+	// The top row is never updated, and neither is the leftmost column when sweeping right to left.
+	const unsigned int y_first = std::max(yBegin, 1u);
+	const unsigned int x_first = std::max(xBegin, 1u);
+	if (yEnd <= y_first || xEnd <= xBegin) {
+		return;
+	}
+
+	const size_t chunkCount = mWorld.chunkStamps.size();
+	if (mChunkMoved.size() != chunkCount)
+		mChunkMoved.assign(chunkCount, UINT16_MAX);
+	mChunkMovedLast.swap(mChunkMoved);
+	mChunkMoved.assign(chunkCount, 0);
+
+	const bool throttled = mQuality.quietChunkDivisor > 1 || mQuality.quietChunkBudget < chunkCount;
+	if (throttled)
+		ScheduleQuietChunks();
+	mEmissionsLeft = mQuality.maxEmissions;
+	mOccupancy.Sync(mWorld);
+	mCensus.Sync(mWorld);
+
+	// plugin kernels reach the world through this
+	MaterialKernelContext kernelContext = { mWorld.particles.data(), mWorld.width, mWorld.height, mGravity, this, &KernelRandomCallback, &KernelWriteCallback };
+	const bool* ages = MaterialAgeFlags();
+	const MaterialRate* rates = MaterialRates();
+
+	if (mProfiler != nullptr)
+		mProfiler->PhaseBegin(SimPhase::sweep);
+
+	// Rip through read data and update write buffer
+	// Note(John): We update "bottom up", since all the data is edited "in place". Double buffering all data would fix this 
+	// 	issue, however it requires double all of the data.
+	for (unsigned int y = yEnd - 1; y >= y_first; --y)
+	{
+		const size_t chunkRow = (y >> chunkShift) * mWorld.chunksX;
+		const uint8_t* chunkDue = throttled ? &mChunkDue[chunkRow] : nullptr;
+		const uint16_t* chunkMoved = &mChunkMovedLast[chunkRow];
+		for (unsigned int x = ran ? xBegin : xEnd - 1; ran ? x < xEnd : x >= x_first; ran ? ++x : --x)
+		{
+			if (throttled && !chunkDue[x >> chunkShift])
+				continue;
+
+			// A tile without dynamic cells holds only empty and stone, which
+			// have no rule, so its cells in this row can be passed in one go.
+			if (!(mOccupancy.TileFlags(x, y) & OccupancyPyramid::dynamic)) {
+				constexpr unsigned int tileMask = OccupancyPyramid::tileSize - 1;
+				x = ran ? std::min(x | tileMask, xEnd - 1) : std::max(x & ~tileMask, x_first);
+				continue;
+			}
+
+			// Current particle idx
+			unsigned int read_idx = ComputeID(x, y);
+
+			// Get material of particle at point
+			uint8_t mat_id = GetParticleAt(x, y).id;
+
+			// Materials with a divisor only update on their due visits, for
+			// the time since the last one. Chunks take turns, so the cost of
+			// a large fill spreads evenly over the ticks. The leftmost column
+			// is only visited when sweeping left to right, so it counts those
+			// sweeps alone; counting ticks, an even divisor would never be
+			// due there.
+			const MaterialRate rate = rates[mat_id];
+			const unsigned int cx = x >> chunkShift;
+			float cell_dt = dt;
+			if (rate.resting > 1) {
+				const unsigned int divisor = chunkMoved[cx] ? rate.every : rate.resting;
+				const unsigned int visit = x < x_first ? mFrameCounter / 2 : mFrameCounter;
+				if ((visit + cx + (y >> chunkShift)) % divisor != 0)
+					continue;
+				cell_dt = dt * divisor;
+			}
+
+			// Update particle's lifetime (I guess just use frames)? Or should I have sublife?
+			// Only the materials whose rules read it age, so resting sand and stone leave their chunks clean.
+			if (ages[mat_id]) {
+				mWorld.particles.at(read_idx).life_time += 1.f * cell_dt;
+				mWorld.Touch(x, y);
+			}
+
+			switch (mat_id) {
+
+			case mat_id_sand:  UpdateSand(x, y, cell_dt);  break;
+			case mat_id_water: UpdateWater(x, y, cell_dt); break;
+			case mat_id_smoke: UpdateSmoke(x, y, cell_dt); break;
+			case mat_id_steam: UpdateSteam(x, y, cell_dt); break;
+			case mat_id_fire:  UpdateFire(x, y, cell_dt);  break;
+				// Do nothing for empty or stone
+			case mat_id_empty:
+			case mat_id_stone:
+				break;
+			default:
+			{
+				const MaterialEntry* entry = FindMaterial(mat_id);
+				if (entry == nullptr || entry->kernel == nullptr)
+					break;
+
+				// hand the kernel the whole run of its material in one call,
+				// aging the rest of the run like the first cell was. A run
+				// with a divisor, or while quiet chunks are throttled, ends
+				// with the chunk, the next may not be due.
+				unsigned int count = 1;
+				for (;;) {
+					const unsigned int nx = ran ? x + count : x - count;
+					if (ran ? nx >= xEnd : (nx < x_first || nx > x))
+						break;
+					if ((rate.resting > 1 || throttled) && (nx >> chunkShift) != cx)
+						break;
+					Particle& next = mWorld.particles[ComputeID(nx, y)];
+					if (next.id != mat_id)
+						break;
+					if (ages[mat_id]) {
+						next.life_time += 1.f * cell_dt;
+						mWorld.Touch(nx, y);
+					}
+					++count;
+				}
+				entry->kernel(&kernelContext, x, y, count, ran ? 1 : -1, cell_dt);
+
+				// the loop steps past the last cell of the run
+				x = ran ? x + count - 1 : x - (count - 1);
+			} break;
+			}
+
+			if (mWriteObserver != nullptr)
+				mWriteObserver->UpdateDone();
+		}
+	}
+
+	if (mProfiler != nullptr) {
+		mProfiler->PhaseEnd(SimPhase::sweep);
+		mProfiler->PhaseBegin(SimPhase::resetFlags);
+	}
+
+	// Can remove this loop later on by keeping update structure and setting that for the particle as it moves, 
+	// then at the end of frame just memsetting the entire structure to 0.
+	for (unsigned int y = yEnd - 1; y >= y_first; --y) {
+		for (unsigned int x = ran ? xBegin : xEnd - 1; ran ? x < xEnd : x >= x_first; ran ? ++x : --x) {
+			// Set particle's update to false for next frame
+			mWorld.particles.at(ComputeID(x, y)).has_been_updated_this_frame = false;
+		}
+	}
+
+	// the writes of this step reached the pyramid and census through WriteData
+	mOccupancy.Skip(mWorld);
+	mCensus.Skip(mWorld);
+
+	if (mProfiler != nullptr)
+		mProfiler->PhaseEnd(SimPhase::resetFlags);
+}
+
+void ParticleSim::UpdateFire(uint32_t x, uint32_t y, float dt)
+{
+
+	// For water, same as sand, but we'll check immediate left and right as well
+	int read_idx = ComputeID(x, y);
+	Particle* p = &mWorld.particles.at(read_idx);
+	uint32_t write_idx = read_idx;
+	uint32_t fall_rate = 4;
+
+	if (p->has_been_updated_this_frame) {
+		return;
+	}
+
+	p->has_been_updated_this_frame = true;
+
+	if (p->life_time > mMaterials.fireBurnoutAge) {
+		if (RandomVal(0, mMaterials.fireBurnoutChance) == 0) {
+			WriteData(read_idx, ParticleEmpty());
+			return;
+		}
+	}
+
+	// float grav_mul = random_val( 0, 10 ) == 0 ? 2.f : 1.f;
+	p->velocity.y = std::clamp(p->velocity.y - ((mGravity * dt)) * 0.2f, -5.0f, 0.f);
+	// p->velocity.x = std::clamp( st, -1.f, 1.f );
+	p->velocity.x = std::clamp(p->velocity.x + (float)RandomVal(-100, 100) / 200.f, -0.5f, 0.5f);
+
+	// Change color based on life_time
+
+	if (mQuality.colorChurn && RandomVal(0, (int)(p->life_time * 100.f)) % 200 == 0) {
+		int ran = RandomVal(0, 3);
+		switch (ran) {
+		case 0: p->color = { 255, 80, 20, 255 }; break;
+		case 1: p->color = { 250, 150, 10, 255 }; break;
+		case 2: p->color = { 200, 150, 0, 255 }; break;
+		case 3: p->color = { 100, 50, 2, 255 }; break;
+		}
+	}
+
+	if (p->life_time < 0.02f) {
+		p->color.r = 200;
+	}
+	else {
+		p->color.r = 255;
+	}
+
+	// write the new color through, so the color plane shows it
+	WriteData(read_idx, *p);
+
+	// In water, so create steam and DIE
+	// Should also kill the water...
+	int lx, ly;
+	if (IsInWater(x, y, &lx, &ly)) {
+		if (RandomVal(0, 1) == 0) {
+			if (mProfiler != nullptr)
+				mProfiler->PhaseBegin(SimPhase::reactions);
+			int ry = RandomVal(-5, -1);
+			int rx = RandomVal(-5, 5);
+			for (int i = ry; i > -5; --i) {
+				for (int j = rx; j < 5; ++j) {
+					Particle p = ParticleSteam();
+					if (InBounds(x + j, y + i) && IsEmpty(x + j, y + i) && Emit()) {
+						Particle p = ParticleSteam();
+						WriteData(ComputeID(x + j, y + i), p);
+					}
+				}
+			}
+			Particle p = ParticleSteam();
+			WriteData(read_idx, ParticleEmpty());
+			WriteData(read_idx, p);
+			WriteData(ComputeID(lx, ly), ParticleEmpty());
+			if (mProfiler != nullptr)
+				mProfiler->PhaseEnd(SimPhase::reactions);
+			return;
+		}
+	}
+
+	// Just check if you can move directly beneath you. If not, then reset your velocity. God, this is going to blow.
+	if (InBounds(x, y + 1) && !IsEmpty(x, y + 1) && (GetParticleAt(x, y + 1).id != mat_id_water || GetParticleAt(x, y + 1).id != mat_id_smoke)) {
+		p->velocity.y /= 2.f;
+	}
+
+	if (RandomVal(0, 10) == 0) {
+		// p->velocity.x = std::clamp( p->velocity.x + (float)random_val( -1, 1 ) / 2.f, -1.f, 1.f );
+	}
+	// p->velocity.x = std::clamp( p->velocity.x, -0.5f, 0.5f );
+
+	// Kill fire underneath
+	if (InBounds(x, y + 3) && GetParticleAt(x, y + 3).id == mat_id_fire && RandomVal(0, 100) == 0) {
+		WriteData(ComputeID(x, y + 3), *p);
+		WriteData(read_idx, ParticleEmpty());
+		return;
+	}
+
+	// Chance to kick itself up ( to simulate flames )
+	if (InBounds(x, y + 1) && GetParticleAt(x, y + 1).id == mat_id_fire &&
+		InBounds(x, y - 1) && GetParticleAt(x, y - 1).id == mat_id_empty) {
+		if (RandomVal(0, 10) == 0 * p->life_time < 10.f && p->life_time > 1.f) {
+			int r = RandomVal(0, 1);
+			int rh = RandomVal(-10, -1);
+			int spread = 3;
+			for (int i = rh; i < 0; ++i) {
+				for (int j = r ? -spread : spread; r ? j < spread : j > -spread; r ? ++j : --j) {
+					int rx = j, ry = i;
+					if (InBounds(x + rx, y + ry) && IsEmpty(x + rx, y + ry)) {
+						WriteData(ComputeID(x + rx, y + ry), *p);
+						WriteData(read_idx, ParticleEmpty());
+						break;
+					}
+				}
+			}
+		}
+		return;
+	}
+
+	int vi_x = x + (int)p->velocity.x;
+	int vi_y = y + (int)p->velocity.y;
+
+	// Check to see if you can swap first with other element below you
+	uint32_t b_idx = ComputeID(x, y + 1);
+	uint32_t br_idx = ComputeID(x + 1, y + 1);
+	uint32_t bl_idx = ComputeID(x - 1, y + 1);
+
+	const int wood_chance = 100;
+	const int gun_powder_chance = 1;
+	const int oil_chance = 5;
+
+	// Chance to spawn smoke above
+	for (uint32_t i = 0; i < RandomVal(1, 10); ++i) {
+		if (RandomVal(0, 500) == 0) {
+			// the first free cell above, the emission cap only pays for smoke written
+			int sx = 0;
+			if (InBounds(x, y - 1) && IsEmpty(x, y - 1))
+				sx = x;
+			else if (InBounds(x + 1, y - 1) && IsEmpty(x + 1, y - 1))
+				sx = x + 1;
+			else if (InBounds(x - 1, y - 1) && IsEmpty(x - 1, y - 1))
+				sx = x - 1;
+			else
+				continue;
+
+			if (Emit()) {
+				if (mProfiler != nullptr)
+					mProfiler->PhaseBegin(SimPhase::reactions);
+				WriteData(ComputeID(sx, y - 1), ParticleSmoke());
+				if (mProfiler != nullptr)
+					mProfiler->PhaseEnd(SimPhase::reactions);
+			}
+		}
+	}		
+
+	if (InBounds(vi_x, vi_y) && (IsEmpty(vi_x, vi_y) ||
+		GetParticleAt(vi_x, vi_y).id == mat_id_fire ||
+		GetParticleAt(vi_x, vi_y).id == mat_id_smoke))
+	{
+		// p->velocity.y -= (mGravity * dt );
+		Particle tmp_b = mWorld.particles.at(ComputeID(vi_x, vi_y));
+		WriteData(ComputeID(vi_x, vi_y), *p);
+		WriteData(read_idx, tmp_b);
+	}
+
+	// Simple falling, changing the velocity here ruins everything. I need to redo this entire simulation.
+	else if (InBounds(x, y + 1) && ((IsEmpty(x, y + 1) || (mWorld.particles.at(b_idx).id == mat_id_water)))) {
+		// p->velocity.y -= (mGravity * dt );
+		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
+		Particle tmp_b = mWorld.particles.at(b_idx);
+		WriteData(b_idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x - 1, y + 1) && ((IsEmpty(x - 1, y + 1) || mWorld.particles.at(bl_idx).id == mat_id_water))) {
+		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
+		// p->velocity.y -= (mGravity * dt );
+		Particle tmp_b = mWorld.particles.at(bl_idx);
+		WriteData(bl_idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x + 1, y + 1) && ((IsEmpty(x + 1, y + 1) || mWorld.particles.at(br_idx).id == mat_id_water))) {
+		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
+		// p->velocity.y -= (mGravity * dt );
+		Particle tmp_b = mWorld.particles.at(br_idx);
+		WriteData(br_idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x - 1, y - 1) && (mWorld.particles.at(ComputeID(x - 1, y - 1)).id == mat_id_water)) {
+		uint32_t idx = ComputeID(x - 1, y - 1);
+		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
+		Particle tmp_b = mWorld.particles.at(idx);
+		WriteData(idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x + 1, y - 1) && (mWorld.particles.at(ComputeID(x + 1, y - 1)).id == mat_id_water)) {
+		uint32_t idx = ComputeID(x + 1, y - 1);
+		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
+		Particle tmp_b = mWorld.particles.at(idx);
+		WriteData(idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x, y - 1) && (mWorld.particles.at(ComputeID(x, y - 1)).id == mat_id_water)) {
+		uint32_t idx = ComputeID(x, y - 1);
+		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
+		Particle tmp_b = mWorld.particles.at(idx);
+		WriteData(idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else {
+		// p->velocity.x = random_val( 0, 1 ) == 0 ? -1.f : 1.f;
+		WriteData(read_idx, *p);
+	}
+}
+
+void ParticleSim::UpdateSmoke(uint32_t x, uint32_t y, float dt)
+{
+
+	// For water, same as sand, but we'll check immediate left and right as well
+	uint32_t read_idx = ComputeID(x, y);
+	Particle* p = &mWorld.particles.at(read_idx);
+	uint32_t write_idx = read_idx;
+	uint32_t fall_rate = 4;
+
+	if (p->life_time > mMaterials.smokeLifetime) {
+		WriteData(read_idx, ParticleEmpty());
+		return;
+	}
+
+	if (p->has_been_updated_this_frame) {
+		return;
+	}
+
+	p->has_been_updated_this_frame = true;
+
+	// Smoke rises over time. This might cause issues, actually...
+	p->velocity.y = std::clamp(p->velocity.y - (mGravity * dt), -2.f, 10.f);
+	p->velocity.x = std::clamp(p->velocity.x + (float)RandomVal(-100, 100) / 100.f, -1.f, 1.f);
+
+	// Just check if you can move directly beneath you. If not, then reset your velocity. God, this is going to blow.
+	if (InBounds(x, y - 1) && !IsEmpty(x, y - 1) && GetParticleAt(x, y - 1).id != mat_id_water) {
+		p->velocity.y /= 2.f;
+	}
+
+	int vi_x = x + (int)p->velocity.x;
+	int vi_y = y + (int)p->velocity.y;
+
+	// if ( in_bounds( vi_x, vi_y ) && ( (is_empty( vi_x, vi_y ) || get_particle_at( vi_x, vi_y ).id == mat_id_water || get_particle_at( vi_x, vi_y ).id == mat_id_fire ) ) ) {
+	if (InBounds(vi_x, vi_y) && GetParticleAt(vi_x, vi_y).id != mat_id_smoke) {
+
+		Particle tmp_b = mWorld.particles.at(ComputeID(vi_x, vi_y));
+
+		// Try to throw water out
+		if (tmp_b.id == mat_id_water) {
+
+			tmp_b.has_been_updated_this_frame = true;
+
+			int rx = RandomVal(-2, 2);
+			tmp_b.velocity = { static_cast<float>(rx), -3.0f };
+
+			WriteData(ComputeID(vi_x, vi_y), *p);
+			WriteData(read_idx, tmp_b);
+
+		}
+		else if (IsEmpty(vi_x, vi_y)) {
+			WriteData(ComputeID(vi_x, vi_y), *p);
+			WriteData(read_idx, tmp_b);
+		}
+	}
+	// Simple falling, changing the velocity here ruins everything. I need to redo this entire simulation.
+	else if (InBounds(x, y - 1) && GetParticleAt(x, y - 1).id != mat_id_smoke &&
+		GetParticleAt(x, y - 1).id != mat_id_stone) {
+		p->velocity.y -= (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x, y - 1);
+		WriteData(ComputeID(x, y - 1), *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x - 1, y - 1) && GetParticleAt(x - 1, y - 1).id != mat_id_smoke &&
+		GetParticleAt(x - 1, y - 1).id != mat_id_stone) {
+		p->velocity.x = RandomVal(0, 1) == 0 ? -1.2f : 1.2f;
+		p->velocity.y -= (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x - 1, y - 1);
+		WriteData(ComputeID(x - 1, y - 1), *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x + 1, y - 1) && GetParticleAt(x + 1, y - 1).id != mat_id_smoke &&
+		GetParticleAt(x + 1, y - 1).id != mat_id_stone) {
+		p->velocity.x = RandomVal(0, 1) == 0 ? -1.2f : 1.2f;
+		p->velocity.y -= (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x + 1, y - 1);
+		WriteData(ComputeID(x + 1, y - 1), *p);
+		WriteData(read_idx, tmp_b);
+	}
+	// Can move if in liquid
+	else if (InBounds(x + 1, y) && GetParticleAt(x + 1, y).id != mat_id_smoke &&
+		GetParticleAt(x + 1, y).id != mat_id_stone) {
+		uint32_t idx = ComputeID(x + 1, y);
+		Particle tmp_b = mWorld.particles.at(idx);
+		WriteData(idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x - 1, y) && GetParticleAt(x - 1, y).id != mat_id_smoke &&
+		GetParticleAt(x - 1, y).id != mat_id_stone) {
+		uint32_t idx = ComputeID(x - 1, y);
+		Particle tmp_b = mWorld.particles.at(idx);
+		WriteData(idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else {
+		WriteData(read_idx, *p);
+	}
+}
+
+void ParticleSim::UpdateSteam(uint32_t x, uint32_t y, float dt)
+{
+
+	// For water, same as sand, but we'll check immediate left and right as well
+	uint32_t read_idx = ComputeID(x, y);
+	Particle* p = &mWorld.particles.at(read_idx);
+	uint32_t write_idx = read_idx;
+	uint32_t fall_rate = 4;
+
+	if (p->life_time > mMaterials.steamLifetime) {
+		WriteData(read_idx, ParticleEmpty());
+		return;
+	}
+
+	if (p->has_been_updated_this_frame) {
+		return;
+	}
+
+	p->has_been_updated_this_frame = true;
+
+	// Smoke rises over time. This might cause issues, actually...
+	p->velocity.y = std::clamp(p->velocity.y - (mGravity * dt), -2.f, 10.f);
+	p->velocity.x = std::clamp(p->velocity.x + (float)RandomVal(-100, 100) / 100.f, -1.f, 1.f);
+
+	// Just check if you can move directly beneath you. If not, then reset your velocity. God, this is going to blow.
+	if (InBounds(x, y - 1) && !IsEmpty(x, y - 1) && GetParticleAt(x, y - 1).id != mat_id_water) {
+		p->velocity.y /= 2.f;
+	}
+
+	int vi_x = x + (int)p->velocity.x;
+	int vi_y = y + (int)p->velocity.y;
+
+	if (InBounds(vi_x, vi_y) && ((IsEmpty(vi_x, vi_y) || GetParticleAt(vi_x, vi_y).id == mat_id_water || GetParticleAt(vi_x, vi_y).id == mat_id_fire))) {
+
+		Particle tmp_b = mWorld.particles.at(ComputeID(vi_x, vi_y));
+
+		// Try to throw water out
+		if (tmp_b.id == mat_id_water) {
+
+			tmp_b.has_been_updated_this_frame = true;
+
+			int rx = RandomVal(-2, 2);
+			tmp_b.velocity = { static_cast<float>(rx), -3.f };
+
+			WriteData(ComputeID(vi_x, vi_y), *p);
+			WriteData(read_idx, tmp_b);
+
+		}
+		else if (IsEmpty(vi_x, vi_y)) {
+			WriteData(ComputeID(vi_x, vi_y), *p);
+			WriteData(read_idx, tmp_b);
+		}
+	}
+	// Simple falling, changing the velocity here ruins everything. I need to redo this entire simulation.
+	else if (InBounds(x, y - 1) && ((IsEmpty(x, y - 1) || (GetParticleAt(x, y - 1).id == mat_id_water) || GetParticleAt(x, y - 1).id == mat_id_fire))) {
+		p->velocity.y -= (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x, y - 1);
+		WriteData(ComputeID(x, y - 1), *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x - 1, y - 1) && ((IsEmpty(x - 1, y - 1) || GetParticleAt(x - 1, y - 1).id == mat_id_water) || GetParticleAt(x - 1, y - 1).id == mat_id_fire)) {
+		p->velocity.x = RandomVal(0, 1) == 0 ? -1.2f : 1.2f;
+		p->velocity.y -= (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x - 1, y - 1);
+		WriteData(ComputeID(x - 1, y - 1), *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x + 1, y - 1) && ((IsEmpty(x + 1, y - 1) || GetParticleAt(x + 1, y - 1).id == mat_id_water) || GetParticleAt(x + 1, y - 1).id == mat_id_fire)) {
+		p->velocity.x = RandomVal(0, 1) == 0 ? -1.2f : 1.2f;
+		p->velocity.y -= (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x + 1, y - 1);
+		WriteData(ComputeID(x + 1, y - 1), *p);
+		WriteData(read_idx, tmp_b);
+	}
+	// Can move if in liquid
+	else if (InBounds(x + 1, y) && (GetParticleAt(x + 1, y).id == mat_id_water)) {
+		uint32_t idx = ComputeID(x + 1, y);
+		Particle tmp_b = mWorld.particles.at(idx);
+		WriteData(idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x - 1, y) && (mWorld.particles.at(ComputeID(x - 1, y)).id == mat_id_water)) {
+		uint32_t idx = ComputeID(x - 1, y);
+		Particle tmp_b = mWorld.particles.at(idx);
+		WriteData(idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else {
+		WriteData(read_idx, *p);
+	}
+}
+
+void ParticleSim::UpdateSand(uint32_t x, uint32_t y, float dt) {
+
+	// For water, same as sand, but we'll check immediate left and right as well
+	unsigned int read_idx = ComputeID(x, y);
+	Particle* p = &mWorld.particles.at(read_idx);
+	unsigned int write_idx = read_idx;
+	unsigned int fall_rate = 4;
+
+	p->velocity.y = std::clamp(p->velocity.y + (mGravity * dt), -10.f, 10.f);
+
+	// Just check if you can move directly beneath you. If not, then reset your velocity. God, this is going to blow.
+	if (InBounds(x, y + 1) && !IsEmpty(x, y + 1) && GetParticleAt(x, y + 1).id != mat_id_water) {
+		p->velocity.y /= 2.f;
+	}
+
+	int vi_x = x + (int)p->velocity.x;
+	int vi_y = y + (int)p->velocity.y;
+
+	// Check to see if you can swap first with other element below you
+	unsigned int b_idx = ComputeID(x, y + 1);
+	unsigned int br_idx = ComputeID(x + 1, y + 1);
+	unsigned int bl_idx = ComputeID(x - 1, y + 1);
+
+	int lx{}, ly{};
+
+	Particle tmp_a = mWorld.particles.at(read_idx);
+
+	// Physics (using velocity)
+	if (InBounds(vi_x, vi_y) && ((IsEmpty(vi_x, vi_y) ||
+		(((mWorld.particles.at(ComputeID(vi_x, vi_y)).id == mat_id_water) &&
+			!mWorld.particles.at(ComputeID(vi_x, vi_y)).has_been_updated_this_frame &&
+			(mWorld.particles.at(ComputeID(vi_x, vi_y)).velocity.Length() - tmp_a.velocity.Length()) > 10.f))))) {
+
+		Particle tmp_b = mWorld.particles.at(ComputeID(vi_x, vi_y));
+
+		// Try to throw water out
+		if (tmp_b.id == mat_id_water) {
+
+			int rx = RandomVal(-2, 2);
+			tmp_b.velocity = Vec2{ static_cast<float>(rx), -4.f };
+
+			WriteData(ComputeID(vi_x, vi_y), tmp_a);
+
+			// the search for a free cell is skipped when the area above is full
+			const bool room = mOccupancy.MayHave(OccupancyPyramid::empty, vi_x - 10, vi_y - 10, vi_x + 10, vi_y);
+			for (int i = -10; room && i < 0; ++i) {
+				for (int j = -10; j < 10; ++j) {
+					if (IsEmpty(vi_x + j, vi_y + i)) {
+						WriteData(ComputeID(vi_x + j, vi_y + i), tmp_b);
+						break;
+					}
+				}
+			}
+
+			// Couldn't write there, so, uh, destroy it.
+			WriteData(read_idx, ParticleEmpty());
+		}
+		else if (IsEmpty(vi_x, vi_y)) {
+			WriteData(ComputeID(vi_x, vi_y), tmp_a);
+			WriteData(read_idx, tmp_b);
+		}
+	}
+	// Simple falling, changing the velocity here ruins everything. I need to redo this entire simulation.
+	else if (InBounds(x, y + 1) && ((IsEmpty(x, y + 1) || (mWorld.particles.at(b_idx).id == mat_id_water)))) {
+		p->velocity.y += (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x, y + 1);
+		WriteData(b_idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x - 1, y + 1) && ((IsEmpty(x - 1, y + 1) || mWorld.particles.at(bl_idx).id == mat_id_water))) {
+		p->velocity.x = RandomVal(0, 1) == 0 ? -1.f : 1.f;
+		p->velocity.y += (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x - 1, y + 1);
+		WriteData(bl_idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x + 1, y + 1) && ((IsEmpty(x + 1, y + 1) || mWorld.particles.at(br_idx).id == mat_id_water))) {
+		p->velocity.x = RandomVal(0, 1) == 0 ? -1.f : 1.f;
+		p->velocity.y += (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x + 1, y + 1);
+		WriteData(br_idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (IsInWater(x, y, &lx, &ly) && RandomVal(0, 10) == 0) {
+		Particle tmp_b = GetParticleAt(lx, ly);
+		WriteData(ComputeID(lx, ly), *p);
+		WriteData(read_idx, tmp_b);
+	}
+}
+
+void ParticleSim::UpdateWater(uint32_t x, uint32_t y, float dt) {
+
+	unsigned int read_idx = ComputeID(x, y);
+	Particle* p = &mWorld.particles.at(read_idx);
+	unsigned int write_idx = read_idx;
+	int fall_rate = mMaterials.waterFallRate;
+	int spread_rate = mMaterials.waterSpreadRate;
+
+	p->velocity.y = std::clamp(p->velocity.y + (mGravity * dt), -10.f, 10.f);
+
+	p->has_been_updated_this_frame = true;
+
+	// Just check if you can move directly beneath you. If not, then reset your velocity. God, this is going to blow.
+	// if ( in_bounds( x, y + 1 ) && !is_empty( x, y + 1 ) && get_particle_at( x, y + 1 ).id != mat_id_water ) {
+	if (InBounds(x, y + 1) && !IsEmpty(x, y + 1)) {
+		p->velocity.y /= 2.f;
+	}
+
+	// Change color depending on pressure? Pressure would dictate how "deep" the water is, I suppose.
+	if (mQuality.colorChurn && RandomVal(0, (int)(p->life_time * 100.f)) % 20 == 0) {
+		float r = (float)(RandomVal(0, 1)) / 2.f;
+		p->color.r = 25;
+		p->color.g = 76;
+		p->color.b = 178;
+		WriteData(read_idx, *p);
+	}
+
+	int ran = RandomVal(0, 1);
+	int r = ran ? spread_rate : -spread_rate;
+	int l = -r;
+	int u = fall_rate;
+	int v_idx = ComputeID(x + (int)p->velocity.x, y + (int)p->velocity.y);
+	int b_idx = ComputeID(x, y + u);
+	int bl_idx = ComputeID(x + l, y + u);
+	int br_idx = ComputeID(x + r, y + u);
+	int l_idx = ComputeID(x + l, y);
+	int r_idx = ComputeID(x + r, y);
+	int vx = (int)p->velocity.x, vy = (int)p->velocity.y;
+	int lx{}, ly{};
+
+	if (InBounds(x + vx, y + vy) && (IsEmpty(x + vx, y + vy))) {
+		WriteData(v_idx, *p);
+		WriteData(read_idx, ParticleEmpty());
+	}
+	else if (IsEmpty(x, y + u)) {
+		WriteData(b_idx, *p);
+		WriteData(read_idx, ParticleEmpty());
+	}
+	else if (IsEmpty(x + r, y + u)) {
+		WriteData(br_idx, *p);
+		WriteData(read_idx, ParticleEmpty());
+	}
+	else if (IsEmpty(x + l, y + u)) {
+		WriteData(bl_idx, *p);
+		WriteData(read_idx, ParticleEmpty());
+	}
+	// Simple falling, changing the velocity here ruins everything. I need to redo this entire simulation.
+	else if (InBounds(x, y + u) && (IsEmpty(x, y + u))) {
+		p->velocity.y += (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x, y + u);
+		WriteData(b_idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x + l, y + u) && (IsEmpty(x + l, y + u))) {
+		p->velocity.x = RandomVal(0, 1) == 0 ? -1.f : 1.f;
+		p->velocity.y += (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x + l, y + u);
+		WriteData(bl_idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (InBounds(x + r, y + u) && (IsEmpty(x + r, y + u) )) {
+		p->velocity.x = RandomVal(0, 1) == 0 ? -1.f : 1.f;
+		p->velocity.y += (mGravity * dt);
+		Particle tmp_b = GetParticleAt(x + r, y + u);
+		WriteData(br_idx, *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else if (IsInWater(x, y, &lx, &ly) && RandomVal(0, 10) == 0) {
+		Particle tmp_b = GetParticleAt(lx, ly);
+		WriteData(ComputeID(lx, ly), *p);
+		WriteData(read_idx, tmp_b);
+	}
+	else {
+		Particle tmp = *p;
+		bool found = false;
+
+		// Don't try to spread if something is directly above you?
+		if (CompletelySurrounded(x, y)) {
+			WriteData(read_idx, tmp);
+			return;
+		}
+		else {
+			// nothing to spread into when the rows beside and below are full
+			const bool room = mOccupancy.MayHave(OccupancyPyramid::empty, x - spread_rate, y, x + spread_rate + 1, y + fall_rate);
+			for (unsigned int i = 0; room && i < fall_rate; ++i) {
+				for (int j = spread_rate; j > 0; --j)
+				{
+					if (InBounds(x - j, y + i) && (IsEmpty(x - j, y + i))) {
+						Particle tmp = GetParticleAt(x - j, y + i);
+						WriteData(ComputeID(x - j, y + i), *p);
+						WriteData(read_idx, tmp);
+						found = true;
+						break;
+					}
+					if (InBounds(x + j, y + i) && (IsEmpty(x + j, y + i))) {
+						Particle tmp = GetParticleAt(x + j, y + i);
+						WriteData(ComputeID(x + j, y + i), *p);
+						WriteData(read_idx, tmp);
+						found = true;
+						break;
+					}
+				}
+			}
+
+			if (!found) {
+				WriteData(read_idx, tmp);
+			}
+		}
+	}
+}
+
+void ParticleSim::UpdateParticle(uint32_t x, uint32_t y, float dt)
+{
+	switch (GetParticleAt(x, y).id) {
+	case mat_id_sand:  UpdateSand(x, y, dt);  break;
+	case mat_id_water: UpdateWater(x, y, dt); break;
+	case mat_id_smoke: UpdateSmoke(x, y, dt); break;
+	case mat_id_steam: UpdateSteam(x, y, dt); break;
+	case mat_id_fire:  UpdateFire(x, y, dt);  break;
+	default: break;
+	}
+}
+
+uint32_t ParticleSim::KernelRandomCallback(void* sim)
+{
+	return static_cast<uint32_t>(static_cast<ParticleSim*>(sim)->mRandom());
+}
+
+void ParticleSim::KernelWriteCallback(void* sim, uint32_t idx, const Particle* p)
+{
+	static_cast<ParticleSim*>(sim)->WriteData(idx, *p);
+}
+
+void ParticleSim::ScheduleQuietChunks()
+{
+	const size_t chunkCount = mChunkMovedLast.size();
+	mChunkDue.resize(chunkCount);
+
+	size_t quiet = 0;
+	for (size_t c = 0; c < chunkCount; ++c) {
+		mChunkDue[c] = mChunkMovedLast[c] > mQuality.quietMoves;
+		quiet += !mChunkDue[c];
+	}
+	if (quiet == 0)
+		return;
+
+	// The slice continues where the last one stopped, so every quiet chunk is
+	// refreshed in turn however few the budget allows per step.
+	const unsigned int divisor = std::max(mQuality.quietChunkDivisor, 1u);
+	size_t slice = std::min((quiet + divisor - 1) / divisor, mQuality.quietChunkBudget);
+	size_t c = mQuietCursor % chunkCount;
+	for (size_t visited = 0; slice > 0 && visited < chunkCount; ++visited, c = (c + 1) % chunkCount) {
+		if (!mChunkDue[c] && mChunkMovedLast[c] <= mQuality.quietMoves) {
+			mChunkDue[c] = 1;
+			--slice;
+		}
+	}
+	mQuietCursor = c;
+}
+
+bool ParticleSim::Emit()
+{
+	if (mEmissionsLeft == 0)
+		return false;
+	--mEmissionsLeft;
+	return true;
+}
+
+void ParticleSim::WriteData(uint32_t idx, Particle p) {
+	// Write into particle data for id value
+	Particle& dst = mWorld.particles.at(idx);
+	if (mWriteObserver != nullptr)
+		mWriteObserver->CellWritten(idx, dst);
+	const unsigned int x = idx % mWorld.width;
+	const unsigned int y = idx / mWorld.width;
+	if (dst.id != p.id) {
+		++mCellsChanged;
+		mOccupancy.Change(x, y, dst.id, p.id);
+		mCensus.Change(x, y, dst.id, p.id);
+		if (!mChunkMoved.empty()) {
+			uint16_t& moved = mChunkMoved[(y >> chunkShift) * mWorld.chunksX + (x >> chunkShift)];
+			moved += moved != UINT16_MAX;
+		}
+	}
+	dst = p;
+	if (mResolveColors)
+		mWorld.colors.at(idx) = p.color;
+	mWorld.Touch(x, y);
+}
+
+bool ParticleSim::InBounds(int x, int y) {
+	if (x < 0 || x >(mWorld.width - 1) || y < 0 || y >(mWorld.height - 1)) return false;
+	return true;
+}
+
+bool ParticleSim::IsEmpty(int x, int y) {
+	return (InBounds(x, y) && mWorld.particles.at(ComputeID(x, y)).id == mat_id_empty);
+}
+
+Particle ParticleSim::GetParticleAt(int x, int y) {
+	return mWorld.particles.at(ComputeID(x, y));
+}
+
+bool ParticleSim::CompletelySurrounded(int x, int y) {
+	// Top
+	if (InBounds(x, y - 1) && !IsEmpty(x, y - 1)) {
+		return false;
+	}
+	// Bottom
+	if (InBounds(x, y + 1) && !IsEmpty(x, y + 1)) {
+		return false;
+	}
+	// Left
+	if (InBounds(x - 1, y) && !IsEmpty(x - 1, y)) {
+		return false;
+	}
+	// Right
+	if (InBounds(x + 1, y) && !IsEmpty(x + 1, y)) {
+		return false;
+	}
+	// Top Left
+	if (InBounds(x - 1, y - 1) && !IsEmpty(x - 1, y - 1)) {
+		return false;
+	}
+	// Top Right
+	if (InBounds(x + 1, y - 1) && !IsEmpty(x + 1, y - 1)) {
+		return false;
+	}
+	// Bottom Left
+	if (InBounds(x - 1, y + 1) && !IsEmpty(x - 1, y + 1)) {
+		return false;
+	}
+	// Bottom Right
+	if (InBounds(x + 1, y + 1) && !IsEmpty(x + 1, y + 1)) {
+		return false;
+	}
+
+	return true;
+}
+
+bool ParticleSim::IsInWater(int x, int y, int* lx, int* ly) {
+	if (InBounds(x, y) && (GetParticleAt(x, y).id == mat_id_water)) {
+		*lx = x; *ly = y;
+		return true;
+	}
+	if (InBounds(x, y - 1) && (GetParticleAt(x, y - 1).id == mat_id_water)) {
+		*lx = x; *ly = y - 1;
+		return true;
+	}
+	if (InBounds(x, y + 1) && (GetParticleAt(x, y + 1).id == mat_id_water)) {
+		*lx = x; *ly = y + 1;
+		return true;
+	}
+	if (InBounds(x - 1, y) && (GetParticleAt(x - 1, y).id == mat_id_water)) {
+		*lx = x - 1; *ly = y;
+		return true;
+	}
+	if (InBounds(x - 1, y - 1) && (GetParticleAt(x - 1, y - 1).id == mat_id_water)) {
+		*lx = x - 1; *ly = y - 1;
+		return true;
+	}
+	if (InBounds(x - 1, y + 1) && (GetParticleAt(x - 1, y + 1).id == mat_id_water)) {
+		*lx = x - 1; *ly = y + 1;
+		return true;
+	}
+	if (InBounds(x + 1, y) && (GetParticleAt(x + 1, y).id == mat_id_water)) {
+		*lx = x + 1; *ly = y;
+		return true;
+	}
+	if (InBounds(x + 1, y - 1) && (GetParticleAt(x + 1, y - 1).id == mat_id_water)) {
+		*lx = x + 1; *ly = y - 1;
+		return true;
+	}
+	if (InBounds(x + 1, y + 1) && (GetParticleAt(x + 1, y + 1).id == mat_id_water)) {
+		*lx = x + 1; *ly = y + 1;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,327 @@
+#pragma once
+
+#include "MaterialCensus.h"
+#include "OccupancyPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// material ids
+#define mat_id_empty  (uint8_t)0
+#define mat_id_sand   (uint8_t)1
+#define mat_id_water  (uint8_t)2
+#define mat_id_stone  (uint8_t)3
+#define mat_id_fire   (uint8_t)4
+#define mat_id_smoke  (uint8_t)5
+#define mat_id_steam  (uint8_t)6
+#define mat_id_count  7
+
+// material colors
+// Colors
+#define mat_col_empty  { 0, 0, 0, 0}
+#define mat_col_sand   { 150, 100, 50, 255 }
+#define mat_col_water  { 20, 100, 170, 200 }
+#define mat_col_stone  { 128, 128, 128, 200 }
+#define mat_col_fire   { 150, 20, 0, 255 }
+#define mat_col_smoke  { 50, 50, 50, 255 }
+#define mat_col_steam  { 220, 220, 250, 255 }
+
+// How far a single particle update can reach from the cell being updated, with
+// the default material parameters.
+// Velocities are clamped to maxSpeed, and water displaced by falling sand is
+// thrown up to sandSplashReach rows above (and to either side of) the cell the
+// sand lands in. Water falls fall_rate rows and spreads spread_rate columns, and
+// sand moves at most one column per frame.
+constexpr int maxSpeed = 10;
+constexpr int sandSplashReach = 10;
+constexpr int waterFallRate = 2;
+constexpr int waterSpreadRate = 5;
+
+// rows / columns a neighbouring region has to be visible for an update to be exact
+constexpr int updateReachY = maxSpeed + sandSplashReach;
+constexpr int updateReachX = 1 + sandSplashReach;
+
+struct Color32 {
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+	uint8_t a;
+
+	Color32(uint8_t x, uint8_t y, uint8_t z, uint8_t w)
+		: r(x), g(y), b(z), a(w)
+	{
+	}
+};
+
+struct Vec2 {
+	float x = 0.0f;
+	float y = 0.0f;
+
+	float Length() const { return std::sqrt(x * x + y * y); }
+};
+
+struct Particle {
+	uint8_t id = mat_id_empty;
+	float life_time;
+	Vec2 velocity;
+	Color32 color = mat_col_empty;
+	bool has_been_updated_this_frame;
+};
+
+// Worlds track changes in square chunks of chunkSize cells.
+constexpr unsigned int chunkShift = 5;
+constexpr unsigned int chunkSize = 1u << chunkShift;
+
+// Particle and color planes of a world, row major.
+struct World
+{
+	World(unsigned int w, unsigned int h)
+		: width(w), height(h),
+		particles(static_cast<size_t>(w) * h),
+		colors(static_cast<size_t>(w) * h, Color32(0, 0, 0, 0)),
+		chunksX((w + chunkSize - 1) >> chunkShift),
+		chunksY((h + chunkSize - 1) >> chunkShift),
+		chunkStamps(static_cast<size_t>(chunksX) * chunksY, 1)
+	{
+	}
+
+	unsigned int width;
+	unsigned int height;
+
+	std::vector<Particle> particles;
+
+	// duplicate of the particle colors, laid out for texture upload
+	std::vector<Color32> colors;
+
+	// Change tracking. Every change to a particle stamps its chunk with the
+	// current stamp. A consumer keeps the value Checkpoint() returned and later
+	// finds the chunks changed since then with ChangedSince().
+	unsigned int chunksX;
+	unsigned int chunksY;
+	std::vector<uint64_t> chunkStamps;
+	uint64_t stamp = 1;
+
+	void Touch(unsigned int x, unsigned int y) { chunkStamps[(y >> chunkShift) * chunksX + (x >> chunkShift)] = stamp; }
+	void TouchAll() { std::fill(chunkStamps.begin(), chunkStamps.end(), stamp); }
+	uint64_t Checkpoint() { return stamp++; }
+	bool ChangedSince(size_t chunk, uint64_t checkpoint) const { return chunkStamps[chunk] > checkpoint; }
+};
+
+// Tunable behaviour of the materials. The defaults are the original hand tuned values.
+struct MaterialParams
+{
+	int waterFallRate = ::waterFallRate;		// rows water drops per frame
+	int waterSpreadRate = ::waterSpreadRate;	// columns water looks sideways for space
+	float fireBurnoutAge = 0.2f;				// seconds before fire may burn out
+	int fireBurnoutChance = 100;				// fire older than that dies with 1 in (n + 1) per frame
+	float smokeLifetime = 10.0f;				// seconds
+	float steamLifetime = 10.0f;				// seconds
+};
+
+// What the sim may give up to keep a step fast. The defaults are full quality;
+// a FrameGovernor lowers them while steps run over its budget.
+struct SimQuality
+{
+	// Quiet chunks, those with at most quietMoves cells changing material in
+	// the last step, are refreshed in round-robin slices: each step takes the
+	// next 1 / quietChunkDivisor of them, but no more than quietChunkBudget.
+	unsigned int quietChunkDivisor = 1;
+	unsigned int quietMoves = 0;
+	size_t quietChunkBudget = SIZE_MAX;
+
+	bool colorChurn = true;				// cosmetic colour flicker of fire and water
+	size_t maxEmissions = SIZE_MAX;		// particles reactions may spawn per step (smoke, steam)
+};
+
+// Number of cells of each material.
+void CountMaterials(const World& world, size_t counts[mat_id_count]);
+
+// FNV-1a hash of the material plane, cheap enough to compare runs every tick.
+uint64_t ComputeChecksum(const World& world);
+
+// Phases of a Step, in order, and of StepMany after its steps. Reactions
+// happen in the middle of the sweep, a profiler is told when they begin and
+// end like for the other phases.
+enum class SimPhase
+{
+	sweep,			// the bottom up update of every cell
+	reactions,		// materials turning into others: fire meeting water, fire giving off smoke
+	resetFlags,		// clearing the updated flags for the next frame
+	colorResolve,	// StepMany bringing the color plane up to date once its steps are done
+};
+
+// Told when each phase of a Step begins and ends, for profiling.
+class SimProfiler
+{
+public:
+	virtual ~SimProfiler() = default;
+	virtual void PhaseBegin(SimPhase phase) = 0;
+	virtual void PhaseEnd(SimPhase phase) = 0;
+};
+
+// Told about the cells every update of a Step writes, for callers that have to
+// treat the writes of one update as a single move (the domain workers at their
+// borders).
+class SimWriteObserver
+{
+public:
+	virtual ~SimWriteObserver() = default;
+
+	// cell idx is about to be overwritten, before is what it holds now
+	virtual void CellWritten(uint32_t idx, const Particle& before) = 0;
+
+	// the update whose writes were reported since the last call is done
+	virtual void UpdateDone() = 0;
+};
+
+// The falling sand simulation. It owns its world and has no dependency on the
+// renderer, so the same rules run in the app, the headless runner and the
+// domain worker processes.
+class ParticleSim
+{
+public:
+	ParticleSim(unsigned int width, unsigned int height, uint32_t seed = 5489u);
+
+	// Advance the whole world by one frame.
+	void Step(float dt);
+
+	// Advance one frame, but only update cells inside [xBegin, xEnd) x [yBegin, yEnd).
+	// Cells outside the rectangle are read and written by the updates but never
+	// updated themselves.
+	void Step(float dt, unsigned int xBegin, unsigned int xEnd, unsigned int yBegin, unsigned int yEnd);
+
+	// Advance ticks frames, but only resolve the color plane once, for the
+	// chunks that changed, after the last of them. For fast-forwarding when
+	// only the final frame is looked at.
+	void StepMany(unsigned int ticks, float dt);
+
+	// Spawn material in a circle / clear a circle around (x, y).
+	void Paint(int x, int y, float radius, uint8_t material);
+	void Erase(int x, int y, float radius);
+
+	void Clear();
+
+	// Run the rule of the particle at (x, y) alone, without aging it, as the
+	// sweep would. For benchmarks of the single rules.
+	void UpdateParticle(uint32_t x, uint32_t y, float dt);
+
+	World& GetWorld() { return mWorld; }
+	const World& GetWorld() const { return mWorld; }
+
+	float Gravity() const { return mGravity; }
+	void SetGravity(float gravity) { mGravity = gravity; }
+
+	const MaterialParams& Materials() const { return mMaterials; }
+	void SetMaterials(const MaterialParams& materials) { mMaterials = materials; }
+
+	// Every simulation draws from its own generator, so worlds stepped on
+	// different threads stay independent and a seed reproduces a run.
+	void SetSeed(uint32_t seed) { mRandom.seed(seed); }
+
+	// Occupancy of the world, brought up to date with direct edits of it first.
+	const OccupancyPyramid& Occupancy() { mOccupancy.Sync(mWorld); return mOccupancy; }
+
+	// Material counts of the world, brought up to date the same way, with the
+	// summed-area table built.
+	const MaterialCensus& Census() { mCensus.Sync(mWorld); mCensus.BuildTable(); return mCensus; }
+
+	// cells whose material changed during the last Step (moves and reactions)
+	size_t CellsChanged() const { return mCellsChanged; }
+
+	const SimQuality& Quality() const { return mQuality; }
+	void SetQuality(const SimQuality& quality) { mQuality = quality; }
+
+	// Profiler told about the phases of every Step, null for none.
+	void SetProfiler(SimProfiler* profiler) { mProfiler = profiler; }
+
+	// Observer told about the writes of every update, null for none.
+	void SetWriteObserver(SimWriteObserver* observer) { mWriteObserver = observer; }
+
+	unsigned int FrameCounter() const { return mFrameCounter; }
+	void SetFrameCounter(unsigned int frame) { mFrameCounter = frame; }
+
+	// particle definitions
+	static Particle ParticleEmpty();
+	static Particle ParticleSand();
+	static Particle ParticleWater();
+	static Particle ParticleStone();
+	static Particle ParticleFire();
+	static Particle ParticleSmoke();
+	static Particle ParticleSteam();
+	static Particle CreateParticle(uint8_t material);
+
+	// Utility functions
+	void WriteData(uint32_t idx, Particle);
+	inline int RandomVal(int lower, int upper);
+	inline int ComputeID(int x, int y) { return (y * mWorld.width + x); }
+	bool InBounds(int x, int y);
+	bool IsEmpty(int x, int y);
+	Particle GetParticleAt(int x, int y);
+
+private:
+	// particle updates
+	void UpdateSand(uint32_t x, uint32_t y, float dt);
+	void UpdateWater(uint32_t x, uint32_t y, float dt);
+	void UpdateFire(uint32_t x, uint32_t y, float dt);
+	void UpdateSmoke(uint32_t x, uint32_t y, float dt);
+	void UpdateSteam(uint32_t x, uint32_t y, float dt);
+
+	// callbacks of the plugin kernel context
+	static uint32_t KernelRandomCallback(void* sim);
+	static void KernelWriteCallback(void* sim, uint32_t idx, const Particle* p);
+
+	// false once the reactions of this step spawned maxEmissions particles
+	bool Emit();
+
+	bool CompletelySurrounded(int x, int y);
+	bool IsInWater(int x, int y, int* lx, int* ly);
+
+	World mWorld;
+
+	// gravity settings
+	float mGravity = 10.0f;
+
+	MaterialParams mMaterials;
+	std::mt19937 mRandom;
+	size_t mCellsChanged = 0;
+	SimProfiler* mProfiler = nullptr;
+	SimWriteObserver* mWriteObserver = nullptr;
+
+	SimQuality mQuality;
+	size_t mEmissionsLeft = SIZE_MAX;
+
+	// false while StepMany defers the color plane
+	bool mResolveColors = true;
+
+	// Cells per chunk that changed material, during this step (and the edits
+	// since the last one) and during the last step. Aging alone does not
+	// count, so resting water is quiet.
+	std::vector<uint16_t> mChunkMoved;
+	std::vector<uint16_t> mChunkMovedLast;
+
+	// chunks updated this step, and the quiet chunk the next slice starts at
+	std::vector<uint8_t> mChunkDue;
+	size_t mQuietCursor = 0;
+
+	void ScheduleQuietChunks();
+
+	// kept exact by WriteData, so the rules can skip full areas mid-sweep
+	OccupancyPyramid mOccupancy;
+	MaterialCensus mCensus;
+
+	// frame counter
+	unsigned int mFrameCounter = 0;
+};
+
+inline int ParticleSim::RandomVal(int lower, int upper) {
+	if (upper < lower) {
+		int tmp = lower;
+		lower = upper;
+		upper = tmp;
+	}
+
+	return static_cast<int>(mRandom() % static_cast<uint32_t>(upper - lower + 1)) + lower;
+}
@@ -0,0 +1,185 @@
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+CounterSample& CounterSample::operator+=(const CounterSample& other)
+{
+	for (int i = 0; i < counterCount; ++i)
+		values[i] += other.values[i];
+	seconds += other.seconds;
+	return *this;
+}
+
+namespace
+{
+	CounterSample Difference(const CounterSample& end, const CounterSample& begin)
+	{
+		CounterSample d;
+		for (int i = 0; i < counterCount; ++i)
+			d.values[i] = end.values[i] - begin.values[i];
+		d.seconds = end.seconds - begin.seconds;
+		return d;
+	}
+
+#ifdef __linux__
+	struct EventConfig
+	{
+		uint32_t type;
+		uint64_t config;
+	};
+
+	const EventConfig eventConfigs[counterCount] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	};
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+	Close();
+}
+
+const char* PerfCounters::Name(PerfCounter counter)
+{
+	switch (counter) {
+	case counterCycles: return "cycles";
+	case counterInstructions: return "instructions";
+	case counterL1DMisses: return "L1D misses";
+	case counterLLCMisses: return "LLC misses";
+	case counterBranchMisses: return "branch misses";
+	default: return "?";
+	}
+}
+
+#ifdef __linux__
+
+bool PerfCounters::Open()
+{
+	Close();
+	mStart = std::chrono::steady_clock::now();
+
+	// one group, so all counters run over exactly the same instructions and a
+	// single read returns them together
+	for (int i = 0; i < counterCount; ++i) {
+		perf_event_attr attr = {};
+		attr.size = sizeof(attr);
+		attr.type = eventConfigs[i].type;
+		attr.config = eventConfigs[i].config;
+		attr.disabled = mLeader < 0 ? 1 : 0;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+
+		const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, mLeader, 0));
+		if (fd < 0)
+			continue;
+		if (mLeader < 0)
+			mLeader = fd;
+		mIndex[i] = static_cast<int>(mFds.size());
+		mFds.push_back(fd);
+	}
+	if (mLeader < 0)
+		return false;
+
+	ioctl(mLeader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(mLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return true;
+}
+
+void PerfCounters::Close()
+{
+	for (int fd : mFds)
+		close(fd);
+	mFds.clear();
+	mLeader = -1;
+	for (int& index : mIndex)
+		index = -1;
+}
+
+CounterSample PerfCounters::Read() const
+{
+	CounterSample sample;
+	sample.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+	if (mLeader < 0)
+		return sample;
+
+	// group format: the number of counters, then their values in opening order
+	uint64_t data[1 + counterCount];
+	if (read(mLeader, data, sizeof(data)) < static_cast<ssize_t>(sizeof(uint64_t) * (1 + mFds.size())))
+		return sample;
+
+	for (int i = 0; i < counterCount; ++i)
+		if (mIndex[i] >= 0)
+			sample.values[i] = data[1 + mIndex[i]];
+	return sample;
+}
+
+#else
+
+bool PerfCounters::Open()
+{
+	mStart = std::chrono::steady_clock::now();
+	return false;
+}
+
+void PerfCounters::Close()
+{
+}
+
+CounterSample PerfCounters::Read() const
+{
+	CounterSample sample;
+	sample.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+	return sample;
+}
+
+#endif
+
+PhaseCounters::PhaseCounters(PerfCounters& counters, const std::vector<std::string>& extraPhases)
+	: mCounters(counters)
+{
+	mNames = { "sweep", "reactions", "reset flags", "color resolve" };
+	mNames.insert(mNames.end(), extraPhases.begin(), extraPhases.end());
+	mBegin.resize(mNames.size());
+	mFrame.resize(mNames.size());
+	mLast.resize(mNames.size());
+	mTotal.resize(mNames.size());
+}
+
+void PhaseCounters::Begin(size_t phase)
+{
+	const CounterSample now = mCounters.Read();
+	if (!mOpen.empty())
+		mFrame[mOpen.back()] += Difference(now, mBegin[mOpen.back()]);
+	mOpen.push_back(phase);
+	mBegin[phase] = now;
+}
+
+void PhaseCounters::End(size_t phase)
+{
+	const CounterSample now = mCounters.Read();
+	mFrame[phase] += Difference(now, mBegin[phase]);
+	if (!mOpen.empty() && mOpen.back() == phase)
+		mOpen.pop_back();
+	if (!mOpen.empty())
+		mBegin[mOpen.back()] = now;
+}
+
+void PhaseCounters::EndFrame()
+{
+	for (size_t i = 0; i < mNames.size(); ++i) {
+		mLast[i] = mFrame[i];
+		mTotal[i] += mFrame[i];
+		mFrame[i] = CounterSample();
+	}
+	++mFrames;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "ParticleSim.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Hardware performance counters of the calling thread, through
+// perf_event_open on Linux. Elsewhere, or when the kernel does not allow it,
+// only the elapsed time is measured.
+enum PerfCounter
+{
+	counterCycles,
+	counterInstructions,
+	counterL1DMisses,		// level 1 data cache read misses
+	counterLLCMisses,		// last level cache misses
+	counterBranchMisses,
+	counterCount
+};
+
+struct CounterSample
+{
+	uint64_t values[counterCount] = {};
+	double seconds = 0.0;
+
+	CounterSample& operator+=(const CounterSample& other);
+};
+
+class PerfCounters
+{
+public:
+	PerfCounters() = default;
+	~PerfCounters();
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	// Open every counter the machine has, false when none of them opened.
+	bool Open();
+	void Close();
+
+	bool Available(PerfCounter counter) const { return mIndex[counter] >= 0; }
+	static const char* Name(PerfCounter counter);
+
+	// Current counts since Open(), differences of two reads give a phase.
+	CounterSample Read() const;
+
+private:
+	int mLeader = -1;
+	std::vector<int> mFds;
+	int mIndex[counterCount] = { -1, -1, -1, -1, -1 };
+	std::chrono::steady_clock::time_point mStart;
+};
+
+// Counters per phase of a frame: the last frame's values and the totals.
+// Phases are exclusive: a phase begun while another one is open pauses it, so
+// the figures of all phases add up to the frame.
+class PhaseCounters : public SimProfiler
+{
+public:
+	// sim phases come first, more phases of the caller after them
+	PhaseCounters(PerfCounters& counters, const std::vector<std::string>& extraPhases);
+
+	void PhaseBegin(SimPhase phase) override { Begin(static_cast<size_t>(phase)); }
+	void PhaseEnd(SimPhase phase) override { End(static_cast<size_t>(phase)); }
+
+	void Begin(size_t phase);
+	void End(size_t phase);
+
+	// Close the frame, its values become LastFrame().
+	void EndFrame();
+
+	size_t PhaseCount() const { return mNames.size(); }
+	const std::string& PhaseName(size_t phase) const { return mNames[phase]; }
+	const CounterSample& LastFrame(size_t phase) const { return mLast[phase]; }
+	const CounterSample& Total(size_t phase) const { return mTotal[phase]; }
+	unsigned int Frames() const { return mFrames; }
+
+private:
+	PerfCounters& mCounters;
+	std::vector<std::string> mNames;
+	std::vector<CounterSample> mBegin;
+	std::vector<CounterSample> mFrame;
+	std::vector<CounterSample> mLast;
+	std::vector<CounterSample> mTotal;
+	unsigned int mFrames = 0;
+
+	// phases begun and not yet ended, the innermost last
+	std::vector<size_t> mOpen;
+};
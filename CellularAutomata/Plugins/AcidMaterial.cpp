@@ -0,0 +1,68 @@
+// Sample material plugin: acid runs like water and eats through sand and
+// stone, using itself up on the way.
+//
+// Build as a shared object next to the simulation, e.g.
+//   g++ -std=c++17 -O2 -shared -fPIC -I.. AcidMaterial.cpp -o acid.so
+// and load it with CellularAutomataHeadless --plugin acid.so.
+
+#include "../MaterialPlugin.h"
+
+namespace
+{
+	uint8_t acidId = mat_id_empty;
+
+	bool Dissolves(uint8_t id)
+	{
+		return id == mat_id_sand || id == mat_id_stone;
+	}
+
+	bool TryMove(const MaterialKernelContext* ctx, int x, int y, int nx, int ny)
+	{
+		if (!KernelInBounds(ctx, nx, ny) || KernelCell(ctx, nx, ny).id != mat_id_empty)
+			return false;
+
+		Particle p = KernelCell(ctx, x, y);
+		p.has_been_updated_this_frame = true;
+		KernelWrite(ctx, nx, ny, p);
+		KernelWrite(ctx, x, y, KernelEmpty());
+		return true;
+	}
+
+	void UpdateAcid(const MaterialKernelContext* ctx, uint32_t x0, uint32_t y, uint32_t count, int step, float)
+	{
+		for (uint32_t i = 0; i < count; ++i) {
+			const int x = static_cast<int>(x0) + static_cast<int>(i) * step;
+			Particle& p = KernelCell(ctx, x, y);
+			if (p.id != acidId || p.has_been_updated_this_frame)
+				continue;
+			p.has_been_updated_this_frame = true;
+
+			// eat what lies below, one in four tries, and sometimes die doing it
+			const int by = static_cast<int>(y) + 1;
+			if (KernelInBounds(ctx, x, by) && Dissolves(KernelCell(ctx, x, by).id) && KernelRandom(ctx, 4) == 0) {
+				KernelWrite(ctx, x, by, KernelEmpty());
+				if (KernelRandom(ctx, 3) == 0) {
+					KernelWrite(ctx, x, y, KernelEmpty());
+					continue;
+				}
+			}
+
+			const int side = KernelRandom(ctx, 2) == 0 ? -1 : 1;
+			if (TryMove(ctx, x, y, x, by) || TryMove(ctx, x, y, x + side, by) || TryMove(ctx, x, y, x - side, by))
+				continue;
+			if (!TryMove(ctx, x, y, x + side, y))
+				TryMove(ctx, x, y, x - side, y);
+		}
+	}
+}
+
+MATERIAL_PLUGIN_EXPORT bool RegisterMaterials(MaterialRegistry* registry)
+{
+	if (registry->version != MATERIAL_PLUGIN_VERSION)
+		return false;
+
+	// a liquid, so it settles to every 4th tick like water
+	MaterialDesc acid = { "acid", { 120, 230, 40, 255 }, 0, UpdateAcid, 1, 4 };
+	acidId = registry->add(registry->table, &acid);
+	return acidId != mat_id_empty;
+}
@@ -0,0 +1,335 @@
+#include "QuadtreeWorld.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Particles are equal when every field is; the padding between them is not compared.
+	bool Same(const Particle& a, const Particle& b)
+	{
+		return a.id == b.id && a.life_time == b.life_time
+			&& a.velocity.x == b.velocity.x && a.velocity.y == b.velocity.y
+			&& a.color.r == b.color.r && a.color.g == b.color.g && a.color.b == b.color.b && a.color.a == b.color.a
+			&& a.has_been_updated_this_frame == b.has_been_updated_this_frame;
+	}
+
+	bool Overlaps(uint64_t x0, uint64_t y0, uint64_t x1, uint64_t y1, uint64_t rx, uint64_t ry, uint64_t size)
+	{
+		return x0 < rx + size && y0 < ry + size && x1 > rx && y1 > ry;
+	}
+
+	bool Covers(uint64_t x0, uint64_t y0, uint64_t x1, uint64_t y1, uint64_t rx, uint64_t ry, uint64_t size)
+	{
+		return x0 <= rx && y0 <= ry && x1 >= rx + size && y1 >= ry + size;
+	}
+}
+
+QuadtreeWorld::Region QuadtreeWorld::Region::Child(int32_t first, unsigned int quadrant) const
+{
+	const uint32_t half = size / 2;
+	return { first + static_cast<int32_t>(quadrant), x + (quadrant & 1) * half, y + (quadrant >> 1) * half, half };
+}
+
+QuadtreeWorld::QuadtreeWorld(uint32_t width, uint32_t height)
+	: mWidth(width), mHeight(height), mSize(chunkSize)
+{
+	while (mSize < width || mSize < height)
+		mSize *= 2;
+
+	Node root;
+	root.value = ParticleSim::ParticleEmpty();
+	mNodes.push_back(root);
+}
+
+Particle QuadtreeWorld::Get(uint32_t x, uint32_t y) const
+{
+	Region r = Root();
+	for (;;) {
+		const Node& node = mNodes[r.node];
+		if (node.dense >= 0)
+			return mChunks[node.dense]->cells[(y - r.y) * chunkSize + (x - r.x)];
+		if (node.children < 0)
+			return node.value;
+
+		const uint32_t half = r.size / 2;
+		r = r.Child(node.children, (x >= r.x + half) + 2 * (y >= r.y + half));
+	}
+}
+
+void QuadtreeWorld::Set(uint32_t x, uint32_t y, const Particle& p)
+{
+	if (x < mWidth && y < mHeight)
+		SetIn(Root(), x, y, p);
+}
+
+void QuadtreeWorld::SetIn(const Region& r, uint32_t x, uint32_t y, const Particle& p)
+{
+	if (r.size == chunkSize) {
+		SetCell(r.node, (y - r.y) * chunkSize + (x - r.x), p);
+		return;
+	}
+
+	if (mNodes[r.node].children < 0) {
+		if (Same(mNodes[r.node].value, p))
+			return;
+		Split(r.node);
+	}
+
+	const uint32_t half = r.size / 2;
+	SetIn(r.Child(mNodes[r.node].children, (x >= r.x + half) + 2 * (y >= r.y + half)), x, y, p);
+	Merge(r.node);
+}
+
+void QuadtreeWorld::Fill(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, const Particle& p)
+{
+	// cells past the edge of the map are never read, filling them as well
+	// lets the chunks along the edge stay uniform
+	const uint64_t fx1 = x1 >= mWidth ? mSize : x1;
+	const uint64_t fy1 = y1 >= mHeight ? mSize : y1;
+	if (x0 < fx1 && y0 < fy1)
+		FillIn(Root(), x0, y0, fx1, fy1, p);
+}
+
+void QuadtreeWorld::FillIn(const Region& r, uint64_t x0, uint64_t y0, uint64_t x1, uint64_t y1, const Particle& p)
+{
+	if (!Overlaps(x0, y0, x1, y1, r.x, r.y, r.size))
+		return;
+
+	if (Covers(x0, y0, x1, y1, r.x, r.y, r.size)) {
+		MakeUniform(r.node, p);
+		return;
+	}
+
+	if (r.size == chunkSize) {
+		const uint32_t cx0 = static_cast<uint32_t>(std::max<uint64_t>(x0, r.x)) - r.x;
+		const uint32_t cy0 = static_cast<uint32_t>(std::max<uint64_t>(y0, r.y)) - r.y;
+		const uint32_t cx1 = static_cast<uint32_t>(std::min<uint64_t>(x1, r.x + chunkSize) - r.x);
+		const uint32_t cy1 = static_cast<uint32_t>(std::min<uint64_t>(y1, r.y + chunkSize) - r.y);
+		for (uint32_t y = cy0; y < cy1; ++y)
+			for (uint32_t x = cx0; x < cx1; ++x)
+				SetCell(r.node, y * chunkSize + x, p);
+		return;
+	}
+
+	if (mNodes[r.node].children < 0) {
+		if (Same(mNodes[r.node].value, p))
+			return;
+		Split(r.node);
+	}
+
+	for (unsigned int q = 0; q < 4; ++q)
+		FillIn(r.Child(mNodes[r.node].children, q), x0, y0, x1, y1, p);
+	Merge(r.node);
+}
+
+void QuadtreeWorld::Read(World& window, uint32_t x0, uint32_t y0) const
+{
+	std::fill(window.particles.begin(), window.particles.end(), ParticleSim::ParticleEmpty());
+	ReadIn(Root(), window, x0, y0);
+
+	for (size_t i = 0; i < window.particles.size(); ++i)
+		window.colors[i] = window.particles[i].color;
+	window.TouchAll();
+}
+
+void QuadtreeWorld::ReadIn(const Region& r, World& window, uint32_t x0, uint32_t y0) const
+{
+	const uint64_t x1 = std::min<uint64_t>(uint64_t(x0) + window.width, mWidth);
+	const uint64_t y1 = std::min<uint64_t>(uint64_t(y0) + window.height, mHeight);
+	if (!Overlaps(x0, y0, x1, y1, r.x, r.y, r.size))
+		return;
+
+	const Node& node = mNodes[r.node];
+	if (node.children >= 0) {
+		for (unsigned int q = 0; q < 4; ++q)
+			ReadIn(r.Child(node.children, q), window, x0, y0);
+		return;
+	}
+
+	const uint32_t rx0 = std::max(r.x, x0);
+	const uint32_t ry0 = std::max(r.y, y0);
+	const uint32_t rx1 = static_cast<uint32_t>(std::min<uint64_t>(uint64_t(r.x) + r.size, x1));
+	const uint32_t ry1 = static_cast<uint32_t>(std::min<uint64_t>(uint64_t(r.y) + r.size, y1));
+	for (uint32_t y = ry0; y < ry1; ++y) {
+		Particle* dst = &window.particles[size_t(y - y0) * window.width + (rx0 - x0)];
+		if (node.dense >= 0)
+			std::copy_n(&mChunks[node.dense]->cells[(y - r.y) * chunkSize + (rx0 - r.x)], rx1 - rx0, dst);
+		else
+			std::fill_n(dst, rx1 - rx0, node.value);
+	}
+}
+
+void QuadtreeWorld::Write(const World& window, uint32_t x0, uint32_t y0)
+{
+	if (x0 < mWidth && y0 < mHeight)
+		WriteIn(Root(), window, x0, y0);
+}
+
+void QuadtreeWorld::WriteIn(const Region& r, const World& window, uint32_t x0, uint32_t y0)
+{
+	// A map cell takes the window cell at its position clamped to the map, so
+	// a window reaching the edge also decides the cells past it.
+	const uint64_t x1 = uint64_t(x0) + window.width >= mWidth ? mSize : uint64_t(x0) + window.width;
+	const uint64_t y1 = uint64_t(y0) + window.height >= mHeight ? mSize : uint64_t(y0) + window.height;
+	if (!Overlaps(x0, y0, x1, y1, r.x, r.y, r.size))
+		return;
+
+	if (r.size == chunkSize) {
+		std::vector<Particle> block(chunkSize * chunkSize);
+		bool uniform = true;
+		for (uint32_t ly = 0; ly < chunkSize; ++ly) {
+			for (uint32_t lx = 0; lx < chunkSize; ++lx) {
+				const uint32_t mx = std::min(r.x + lx, mWidth - 1);
+				const uint32_t my = std::min(r.y + ly, mHeight - 1);
+				Particle& cell = block[ly * chunkSize + lx];
+				if (mx >= x0 && my >= y0 && mx - x0 < window.width && my - y0 < window.height)
+					cell = window.particles[size_t(my - y0) * window.width + (mx - x0)];
+				else if (mNodes[r.node].dense >= 0)
+					cell = mChunks[mNodes[r.node].dense]->cells[ly * chunkSize + lx];
+				else
+					cell = mNodes[r.node].value;
+				uniform = uniform && Same(cell, block[0]);
+			}
+		}
+
+		if (uniform) {
+			MakeUniform(r.node, block[0]);
+			return;
+		}
+
+		if (mNodes[r.node].dense < 0)
+			Materialize(r.node);
+		DenseChunk& chunk = *mChunks[mNodes[r.node].dense];
+		chunk.differing = 0;
+		for (uint32_t i = 0; i < chunkSize * chunkSize; ++i) {
+			chunk.cells[i] = block[i];
+			chunk.differing += !Same(block[i], chunk.ref);
+		}
+		return;
+	}
+
+	if (mNodes[r.node].children < 0)
+		Split(r.node);
+	for (unsigned int q = 0; q < 4; ++q)
+		WriteIn(r.Child(mNodes[r.node].children, q), window, x0, y0);
+	Merge(r.node);
+}
+
+size_t QuadtreeWorld::MemoryBytes() const
+{
+	return NodeCount() * sizeof(Node) + DenseChunks() * sizeof(DenseChunk);
+}
+
+void QuadtreeWorld::SetCell(int32_t node, uint32_t index, const Particle& p)
+{
+	if (mNodes[node].dense < 0) {
+		if (Same(mNodes[node].value, p))
+			return;
+		Materialize(node);
+	}
+
+	DenseChunk& chunk = *mChunks[mNodes[node].dense];
+	Particle& cell = chunk.cells[index];
+	if (!Same(cell, chunk.ref))
+		--chunk.differing;
+	if (!Same(p, chunk.ref))
+		++chunk.differing;
+	cell = p;
+
+	// no cell holds ref any more, count against the new particle instead, so
+	// a block that became uniform in it is found as well
+	if (chunk.differing == chunkSize * chunkSize) {
+		chunk.ref = p;
+		chunk.differing = 0;
+		for (const Particle& c : chunk.cells)
+			chunk.differing += !Same(c, p);
+	}
+
+	if (chunk.differing == 0)
+		Collapse(node);
+}
+
+void QuadtreeWorld::Split(int32_t node)
+{
+	const int32_t first = AllocBlock();
+	for (unsigned int q = 0; q < 4; ++q) {
+		mNodes[first + q] = Node();
+		mNodes[first + q].value = mNodes[node].value;
+	}
+	mNodes[node].children = first;
+}
+
+void QuadtreeWorld::Merge(int32_t node)
+{
+	const int32_t first = mNodes[node].children;
+	for (unsigned int q = 0; q < 4; ++q) {
+		const Node& child = mNodes[first + q];
+		if (child.children >= 0 || child.dense >= 0 || !Same(child.value, mNodes[first].value))
+			return;
+	}
+
+	mNodes[node].value = mNodes[first].value;
+	mNodes[node].children = -1;
+	mFreeBlocks.push_back(first);
+}
+
+void QuadtreeWorld::MakeUniform(int32_t node, const Particle& p)
+{
+	FreeSubtree(node);
+	mNodes[node].value = p;
+}
+
+void QuadtreeWorld::Materialize(int32_t node)
+{
+	int32_t index;
+	if (!mFreeChunks.empty()) {
+		index = mFreeChunks.back();
+		mFreeChunks.pop_back();
+	}
+	else {
+		index = static_cast<int32_t>(mChunks.size());
+		mChunks.emplace_back();
+	}
+
+	mChunks[index] = std::make_unique<DenseChunk>();
+	DenseChunk& chunk = *mChunks[index];
+	std::fill(std::begin(chunk.cells), std::end(chunk.cells), mNodes[node].value);
+	chunk.ref = mNodes[node].value;
+	mNodes[node].dense = index;
+}
+
+void QuadtreeWorld::Collapse(int32_t node)
+{
+	const int32_t index = mNodes[node].dense;
+	mNodes[node].value = mChunks[index]->ref;
+	mNodes[node].dense = -1;
+	mChunks[index].reset();
+	mFreeChunks.push_back(index);
+}
+
+int32_t QuadtreeWorld::AllocBlock()
+{
+	if (!mFreeBlocks.empty()) {
+		const int32_t first = mFreeBlocks.back();
+		mFreeBlocks.pop_back();
+		return first;
+	}
+
+	const int32_t first = static_cast<int32_t>(mNodes.size());
+	mNodes.resize(mNodes.size() + 4);
+	return first;
+}
+
+void QuadtreeWorld::FreeSubtree(int32_t node)
+{
+	if (mNodes[node].dense >= 0)
+		Collapse(node);
+
+	const int32_t first = mNodes[node].children;
+	if (first < 0)
+		return;
+	for (unsigned int q = 0; q < 4; ++q)
+		FreeSubtree(first + q);
+	mNodes[node].children = -1;
+	mFreeBlocks.push_back(first);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "ParticleSim.h"
+
+#include <memory>
+#include <vector>
+
+// Storage for huge maps that are mostly empty or uniform, as a region
+// quadtree. Every leaf is either uniform, one particle standing for all of its
+// cells, or a dense chunkSize x chunkSize block. Leaves larger than a chunk
+// are always uniform.
+//
+// Writing a cell that differs from its uniform leaf splits the leaf down to
+// the chunk and materializes a dense block there. A dense block that becomes
+// uniform again collapses back, and four uniform siblings holding the same
+// particle merge into their parent, so memory follows the content rather
+// than the area.
+//
+// The simulation steps dense worlds: Read() copies a window of the map into
+// one and Write() stores it back.
+class QuadtreeWorld
+{
+public:
+	QuadtreeWorld(uint32_t width, uint32_t height);
+
+	uint32_t Width() const { return mWidth; }
+	uint32_t Height() const { return mHeight; }
+
+	Particle Get(uint32_t x, uint32_t y) const;
+	void Set(uint32_t x, uint32_t y, const Particle& p);
+
+	// Set every cell of [x0, x1) x [y0, y1), without materializing the chunks
+	// the rectangle covers whole.
+	void Fill(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, const Particle& p);
+
+	// Copy the window of the map at (x0, y0) with the size of window into it,
+	// colors included. Cells beyond the map read as empty.
+	void Read(World& window, uint32_t x0, uint32_t y0) const;
+
+	// Store window back at (x0, y0). Cells beyond the map are dropped.
+	void Write(const World& window, uint32_t x0, uint32_t y0);
+
+	size_t NodeCount() const { return mNodes.size() - mFreeBlocks.size() * 4; }
+	size_t DenseChunks() const { return mChunks.size() - mFreeChunks.size(); }
+
+	// bytes held by the nodes and dense blocks in use
+	size_t MemoryBytes() const;
+
+private:
+	struct Node
+	{
+		int32_t children = -1;	// first of four in mNodes, -1 for a leaf
+		int32_t dense = -1;		// block in mChunks, -1 while uniform
+		Particle value;			// the particle of a uniform leaf
+	};
+
+	// cells that differ from ref; zero means the block is uniform again. ref
+	// is the particle the block was materialized from until no cell holds it,
+	// then the particle written last.
+	struct DenseChunk
+	{
+		Particle cells[chunkSize * chunkSize];
+		Particle ref;
+		uint32_t differing = 0;
+	};
+
+	// a node and the square it covers
+	struct Region
+	{
+		int32_t node;
+		uint32_t x;
+		uint32_t y;
+		uint32_t size;
+
+		Region Child(int32_t first, unsigned int quadrant) const;
+	};
+
+	Region Root() const { return { 0, 0, 0, mSize }; }
+
+	void SetIn(const Region& r, uint32_t x, uint32_t y, const Particle& p);
+	void FillIn(const Region& r, uint64_t x0, uint64_t y0, uint64_t x1, uint64_t y1, const Particle& p);
+	void ReadIn(const Region& r, World& window, uint32_t x0, uint32_t y0) const;
+	void WriteIn(const Region& r, const World& window, uint32_t x0, uint32_t y0);
+
+	void SetCell(int32_t node, uint32_t index, const Particle& p);
+	void Split(int32_t node);
+	void Merge(int32_t node);
+	void MakeUniform(int32_t node, const Particle& p);
+	void Materialize(int32_t node);
+	void Collapse(int32_t node);
+
+	int32_t AllocBlock();
+	void FreeSubtree(int32_t node);
+
+	uint32_t mWidth;
+	uint32_t mHeight;
+	uint32_t mSize;		// side of the root, a power of two of at least chunkSize
+
+	std::vector<Node> mNodes;
+	std::vector<int32_t> mFreeBlocks;
+	std::vector<std::unique_ptr<DenseChunk>> mChunks;
+	std::vector<int32_t> mFreeChunks;
+};
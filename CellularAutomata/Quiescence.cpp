@@ -0,0 +1,68 @@
+#include "Quiescence.h"
+
+#include "MaterialTable.h"
+
+#include <chrono>
+
+QuiescenceDetector::QuiescenceDetector(const SettleCriteria& criteria)
+	: mCriteria(criteria)
+{
+}
+
+bool QuiescenceDetector::Update(const ParticleSim& sim)
+{
+	const World& world = sim.GetWorld();
+	const size_t changedLimit = static_cast<size_t>(mCriteria.changedFraction * world.width * world.height);
+	mQuiet = sim.CellsChanged() <= changedLimit ? mQuiet + 1 : 0;
+	if (mQuiet < mCriteria.ticks) {
+		mSettled = false;
+		return false;
+	}
+
+	// Gases trapped in place still run out. Cells left to expire count as
+	// activity, so the scan, a pass over the world, runs every ticks ticks at
+	// most, and the world settles ticks after the last of them is gone.
+	if (!mSettled) {
+		if (mCriteria.expiries && HasExpiringCells(world))
+			mQuiet = 0;
+		else
+			mSettled = true;
+	}
+	return mSettled;
+}
+
+void QuiescenceDetector::Reset()
+{
+	mQuiet = 0;
+	mSettled = false;
+}
+
+bool HasExpiringCells(const World& world)
+{
+	// the sweep never updates the top row, nothing there ages
+	const bool* expires = MaterialExpireFlags();
+	for (size_t i = world.width; i < world.particles.size(); ++i)
+		if (expires[world.particles[i].id])
+			return true;
+	return false;
+}
+
+SettleResult RunUntilSettled(ParticleSim& sim, float dt, unsigned int maxTicks, const SettleCriteria& criteria)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	SettleResult result;
+	QuiescenceDetector detector(criteria);
+	while (result.ticks < maxTicks) {
+		sim.Step(dt);
+		++result.ticks;
+		if (detector.Update(sim)) {
+			result.settled = true;
+			result.settleTick = result.ticks - detector.QuietTicks();
+			break;
+		}
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
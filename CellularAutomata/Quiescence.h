@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ParticleSim.h"
+
+// When a world counts as settled: no more than changedFraction of its cells
+// changed material (moves and reactions) in each of ticks consecutive ticks,
+// and, with expiries set, no cell is left that dies of old age. Water surfaces
+// never come to a complete rest, a settled pool keeps a few tenths of a
+// percent of the cells moving, so a fraction of zero would rarely trigger.
+// ticks should be well above the largest material divisor.
+struct SettleCriteria
+{
+	unsigned int ticks = 60;
+	float changedFraction = 0.01f;
+	bool expiries = true;
+};
+
+// Follows the steps of a simulation and tells when its world stopped changing.
+class QuiescenceDetector
+{
+public:
+	explicit QuiescenceDetector(const SettleCriteria& criteria = SettleCriteria());
+
+	// Account for the step sim just took, true while the world is settled.
+	bool Update(const ParticleSim& sim);
+	void Reset();
+
+	bool Settled() const { return mSettled; }
+
+	// consecutive ticks that changed no more cells than allowed
+	unsigned int QuietTicks() const { return mQuiet; }
+
+private:
+	SettleCriteria mCriteria;
+	unsigned int mQuiet = 0;
+	bool mSettled = false;
+};
+
+// True when a cell of a material that dies of old age is left.
+bool HasExpiringCells(const World& world);
+
+struct SettleResult
+{
+	bool settled = false;
+	unsigned int ticks = 0;			// ticks simulated
+	unsigned int settleTick = 0;	// first tick of the quiet run, when settled
+	double seconds = 0.0;
+};
+
+// Step sim until its world settles or maxTicks passed.
+SettleResult RunUntilSettled(ParticleSim& sim, float dt, unsigned int maxTicks,
+	const SettleCriteria& criteria = SettleCriteria());
@@ -0,0 +1,181 @@
+#include "Raycast.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+namespace
+{
+	// a rectangle of cells, [x0, x1) x [y0, y1), that holds no target
+	struct Box
+	{
+		int64_t x0;
+		int64_t y0;
+		int64_t x1;
+		int64_t y1;
+	};
+
+	// further out than any ray reaches
+	constexpr int64_t beyond = int64_t(rayReach) * 2;
+
+	int64_t FloorDiv(int64_t a, int64_t b)
+	{
+		return a >= 0 ? a / b : -((-a + b - 1) / b);
+	}
+
+	// The node flag a cell needs for a target to be among its cells, zero
+	// when every node may hold one.
+	uint8_t NeededFlag(const MaterialSet& targets)
+	{
+		MaterialSet others = targets;
+		others.reset(mat_id_empty);
+		if (targets.test(mat_id_empty))
+			return others.none() ? OccupancyPyramid::empty : 0;
+		return targets.test(mat_id_stone) ? OccupancyPyramid::filled : OccupancyPyramid::dynamic;
+	}
+
+	// Walks the path a cell at a time, or a box at a time. The line crosses a
+	// vertical cell border at t = (i + 0.5) / nx and a horizontal one at
+	// t = (j + 0.5) / ny, so comparing crossings in integers keeps the path
+	// the same however it is walked.
+	class Path
+	{
+	public:
+		Path(int x0, int y0, int x1, int y1)
+			: mX0(x0), mY0(y0),
+			mNx(std::abs(int64_t(x1) - x0)), mNy(std::abs(int64_t(y1) - y0)),
+			mSx(x1 >= x0 ? 1 : -1), mSy(y1 >= y0 ? 1 : -1)
+		{
+		}
+
+		int64_t X() const { return mX0 + mSx * mKx; }
+		int64_t Y() const { return mY0 + mSy * mKy; }
+		unsigned int Steps() const { return static_cast<unsigned int>(mKx + mKy); }
+		unsigned int Length() const { return static_cast<unsigned int>(mNx + mNy); }
+
+		// Move to the first cell of the path beyond box, false when the path
+		// ends inside it.
+		bool Leave(const Box& box)
+		{
+			const int64_t iX = mKx + (mSx > 0 ? box.x1 - X() : X() - box.x0 + 1) - 1;
+			const int64_t jY = mKy + (mSy > 0 ? box.y1 - Y() : Y() - box.y0 + 1) - 1;
+			const bool xLeaves = iX < mNx;
+			const bool yLeaves = jY < mNy;
+			if (!xLeaves && !yLeaves)
+				return false;
+
+			// the sideways step i comes before the vertical step j when
+			// (i + 0.5) / nx < (j + 0.5) / ny
+			if (xLeaves && (!yLeaves || (2 * iX + 1) * mNy < (2 * jY + 1) * mNx)) {
+				const int64_t vertical = FloorDiv((2 * iX + 1) * mNy - mNx, 2 * mNx) + 1;
+				mKy = std::max(mKy, std::min(vertical, mNy));
+				mKx = iX + 1;
+			}
+			else {
+				const int64_t sideways = FloorDiv((2 * jY + 1) * mNx - 1 - mNy, 2 * mNy) + 1;
+				mKx = std::max(mKx, std::min(sideways, mNx));
+				mKy = jY + 1;
+			}
+			return true;
+		}
+
+	private:
+		int64_t mX0, mY0;
+		int64_t mNx, mNy;
+		int64_t mSx, mSy;
+		int64_t mKx = 0;	// steps taken sideways and up or down
+		int64_t mKy = 0;
+	};
+
+	RayHit Trace(const World& world, const OccupancyPyramid* occupancy, int x0, int y0, int x1, int y1,
+		const MaterialSet& targets, bool ends)
+	{
+		RayHit result;
+		if (std::max({ std::abs(int64_t(x0)), std::abs(int64_t(y0)), std::abs(int64_t(x1)), std::abs(int64_t(y1)) }) > rayReach)
+			return result;
+
+		const uint8_t needed = occupancy != nullptr ? NeededFlag(targets) : 0;
+		const int64_t width = world.width;
+		const int64_t height = world.height;
+
+		Path path(x0, y0, x1, y1);
+		for (;;) {
+			const int64_t x = path.X();
+			const int64_t y = path.Y();
+
+			Box box = { x, y, x + 1, y + 1 };
+			if (x < 0 || y < 0 || x >= width || y >= height) {
+				// everything on this side of the world
+				box = { -beyond, -beyond, beyond, beyond };
+				if (x < 0)
+					box.x1 = 0;
+				else if (x >= width)
+					box.x0 = width;
+				else if (y < 0)
+					box.y1 = 0;
+				else
+					box.y0 = height;
+			}
+			else if (needed != 0 && !(occupancy->TileFlags(unsigned(x), unsigned(y)) & needed)) {
+				// the largest node around the cell that cannot hold a target
+				unsigned int level = 0;
+				while (level + 1 < occupancy->Levels()) {
+					const unsigned int shift = OccupancyPyramid::tileShift + level + 1;
+					if (occupancy->Node(level + 1, unsigned(x) >> shift, unsigned(y) >> shift) & needed)
+						break;
+					++level;
+				}
+				const unsigned int shift = OccupancyPyramid::tileShift + level;
+				box.x0 = (x >> shift) << shift;
+				box.y0 = (y >> shift) << shift;
+				box.x1 = box.x0 + (int64_t(1) << shift);
+				box.y1 = box.y0 + (int64_t(1) << shift);
+			}
+			else {
+				const uint8_t id = world.particles[size_t(y) * world.width + size_t(x)].id;
+				const bool end = path.Steps() == 0 || path.Steps() == path.Length();
+				if (targets.test(id) && (ends || !end)) {
+					result.hit = true;
+					result.x = int(x);
+					result.y = int(y);
+					result.material = id;
+					result.steps = path.Steps();
+					return result;
+				}
+			}
+
+			if (!path.Leave(box))
+				return result;
+		}
+	}
+}
+
+MaterialSet FilledMaterials()
+{
+	MaterialSet set;
+	set.set();
+	set.reset(mat_id_empty);
+	return set;
+}
+
+MaterialSet DynamicMaterials()
+{
+	MaterialSet set = FilledMaterials();
+	set.reset(mat_id_stone);
+	return set;
+}
+
+RayHit CastRay(const World& world, const OccupancyPyramid* occupancy, int x0, int y0, int x1, int y1, const MaterialSet& targets)
+{
+	return Trace(world, occupancy, x0, y0, x1, y1, targets, true);
+}
+
+bool LineOfSight(const World& world, const OccupancyPyramid* occupancy, int x0, int y0, int x1, int y1, const MaterialSet& blockers)
+{
+	// corners go the same way from either end when traced from the lower one
+	if (y1 < y0 || (y1 == y0 && x1 < x0)) {
+		std::swap(x0, x1);
+		std::swap(y0, y1);
+	}
+	return !Trace(world, occupancy, x0, y0, x1, y1, blockers, false).hit;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "MaterialTable.h"
+#include "OccupancyPyramid.h"
+
+#include <bitset>
+
+// The materials a ray stops at, one bit per material id.
+using MaterialSet = std::bitset<maxMaterials>;
+
+// every material but empty, and every material with an update rule
+MaterialSet FilledMaterials();
+MaterialSet DynamicMaterials();
+
+struct RayHit
+{
+	bool hit = false;
+	int x = 0;
+	int y = 0;
+	uint8_t material = mat_id_empty;
+	unsigned int steps = 0;		// cells on the path before the one hit
+};
+
+// Ends of a ray have to lie within rayReach cells of the world's origin, so
+// the exact integer stepping cannot overflow; rays beyond miss.
+constexpr int rayReach = 1 << 30;
+
+// The first cell on the path from cell (x0, y0) to cell (x1, y1), both ends
+// included, whose material is in targets. The path steps one cell sideways or
+// up and down at a time through the cells the straight line between the two
+// cell centers crosses, taking the vertical step first where it passes a
+// corner exactly, and is the same whichever way it is looked up. Because of
+// those corners, the path back from (x1, y1) may differ from this one.
+//
+// Nodes of occupancy that cannot hold a target are crossed in one step, so a
+// ray costs about as much as the occupied part of its path rather than its
+// length. occupancy has to be in sync with world (see ParticleSim::Occupancy);
+// without one every cell is read. Cells beyond the world never stop a ray.
+RayHit CastRay(const World& world, const OccupancyPyramid* occupancy, int x0, int y0, int x1, int y1, const MaterialSet& targets);
+
+// True when no cell strictly between the two ends is of a material in blockers.
+// Symmetric: the path is always traced from the end with the lower y (then
+// x), so swapping the ends gives the same answer even where the path passes
+// a corner exactly.
+bool LineOfSight(const World& world, const OccupancyPyramid* occupancy, int x0, int y0, int x1, int y1, const MaterialSet& blockers);
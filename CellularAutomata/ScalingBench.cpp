@@ -0,0 +1,157 @@
+#include "ScalingBench.h"
+
+#include "DomainSim.h"
+#include "ParticleSim.h"
+#include "Scenes.h"
+#include "ThreadPool.h"
+
+#include <cstdio>
+#include <memory>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// A tick reads every particle in the sweep and reads and writes it again
+	// when the updated flags are reset. Moves and halo copies come on top,
+	// so this is a lower bound of the traffic.
+	constexpr double bytesPerCellTick = 3.0 * sizeof(Particle);
+
+	// Physical memory not in use right now.
+	double AvailableMemory()
+	{
+#ifdef _WIN32
+		MEMORYSTATUSEX status = {};
+		status.dwLength = sizeof(status);
+		return GlobalMemoryStatusEx(&status) ? double(status.ullAvailPhys) : 0.0;
+#else
+		return double(sysconf(_SC_AVPHYS_PAGES)) * double(sysconf(_SC_PAGESIZE));
+#endif
+	}
+
+	// Simulate a fresh test scene with threads strips, false when it does not fit.
+	// Only the ticks are timed, not starting the workers and copying the world.
+	bool Measure(ScalingPoint& point, const ScalingConfig& config, ThreadPool& pool)
+	{
+		// The world, its copy in the memory shared with the domain workers, and
+		// the workers' windows with the material each saw in them, together at
+		// least the whole world once more; a single worker holds all of it.
+		const double cells = double(point.width) * point.height;
+		const double worldBytes = sizeof(Particle) + sizeof(Color32);
+		if (cells * (2.0 * worldBytes + sizeof(Particle) + sizeof(uint8_t)) > AvailableMemory()) {
+			point.skipped = true;
+			return false;
+		}
+
+		std::unique_ptr<ParticleSim> sim;
+		try {
+			sim = std::make_unique<ParticleSim>(point.width, point.height);
+		}
+		catch (const std::bad_alloc&) {
+			point.skipped = true;
+			return false;
+		}
+		BuildScene(*sim, config.scene, config.seed, pool);
+
+		DomainConfig domains;
+		domains.columns = 1;
+		domains.rows = point.threads;
+		domains.ticks = config.ticks;
+
+		if (!RunDomainLauncher(sim->GetWorld(), domains, &point.seconds) || point.seconds <= 0.0) {
+			point.skipped = true;
+			return false;
+		}
+
+		const double cellTicks = double(point.width) * point.height * config.ticks;
+		point.cellsPerSecond = cellTicks / point.seconds;
+		point.bandwidth = cellTicks * bytesPerCellTick / point.seconds;
+		return true;
+	}
+}
+
+std::vector<ScalingPoint> RunScalingBench(const ScalingConfig& config)
+{
+	std::vector<ScalingPoint> points;
+	ThreadPool pool;	// builds the scenes
+
+	for (const auto& size : config.sizes) {
+		double baseSeconds = 0.0;
+		for (unsigned int threads = 1; threads <= config.maxThreads; ++threads) {
+			ScalingPoint point;
+			point.width = size.first;
+			point.height = size.second;
+			point.threads = threads;
+			if (Measure(point, config, pool)) {
+				if (threads == 1)
+					baseSeconds = point.seconds;
+				point.speedup = baseSeconds > 0.0 ? baseSeconds / point.seconds : 0.0;
+				point.efficiency = point.speedup / threads;
+				std::printf("strong %5ux%-5u %2u threads  %8.3f s  speedup %5.2f  efficiency %3.0f%%\n",
+					point.width, point.height, threads, point.seconds, point.speedup, point.efficiency * 100.0);
+			}
+			else
+				std::printf("strong %5ux%-5u %2u threads  skipped\n", point.width, point.height, threads);
+			points.push_back(point);
+
+			// a size too large for one domain is too large for all of them
+			if (point.skipped)
+				break;
+		}
+	}
+
+	if (config.sizes.empty())
+		return points;
+
+	const auto base = config.sizes.front();
+	double baseRate = 0.0;
+	for (unsigned int threads = 1; threads <= config.maxThreads; ++threads) {
+		ScalingPoint point;
+		point.weak = true;
+		point.width = base.first;
+		point.height = base.second * threads;
+		point.threads = threads;
+		if (Measure(point, config, pool)) {
+			if (threads == 1)
+				baseRate = point.cellsPerSecond;
+			point.speedup = baseRate > 0.0 ? point.cellsPerSecond / baseRate : 0.0;
+			point.efficiency = point.speedup / threads;
+			std::printf("weak   %5ux%-5u %2u threads  %8.3f s  speedup %5.2f  efficiency %3.0f%%\n",
+				point.width, point.height, threads, point.seconds, point.speedup, point.efficiency * 100.0);
+		}
+		else
+			std::printf("weak   %5ux%-5u %2u threads  skipped\n", point.width, point.height, threads);
+		points.push_back(point);
+		if (point.skipped)
+			break;
+	}
+	return points;
+}
+
+bool WriteScalingJson(const std::string& path, const ScalingConfig& config, const std::vector<ScalingPoint>& points)
+{
+	FILE* file = std::fopen(path.c_str(), "w");
+	if (file == nullptr)
+		return false;
+
+	std::fprintf(file, "{\n  \"scene\": \"%s\",\n  \"ticks\": %u,\n  \"seed\": %u,\n  \"max_threads\": %u,\n  \"particle_bytes\": %zu,\n  \"points\": [\n",
+		config.scene.c_str(), config.ticks, config.seed, config.maxThreads, sizeof(Particle));
+	for (size_t i = 0; i < points.size(); ++i) {
+		const ScalingPoint& p = points[i];
+		std::fprintf(file, "    { \"mode\": \"%s\", \"width\": %u, \"height\": %u, \"threads\": %u, ",
+			p.weak ? "weak" : "strong", p.width, p.height, p.threads);
+		if (p.skipped)
+			std::fprintf(file, "\"skipped\": true }");
+		else
+			std::fprintf(file, "\"seconds\": %.6f, \"cells_per_second\": %.0f, \"speedup\": %.4f, \"efficiency\": %.4f, \"estimated_bandwidth_bytes_per_second\": %.0f }",
+				p.seconds, p.cellsPerSecond, p.speedup, p.efficiency, p.bandwidth);
+		std::fprintf(file, "%s\n", i + 1 < points.size() ? "," : "");
+	}
+	std::fprintf(file, "  ]\n}\n");
+	return std::fclose(file) == 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Strong and weak scaling of the domain decomposed simulation.
+//
+// Strong scaling simulates the same world with 1..maxThreads domains, so the
+// work per domain shrinks. Weak scaling gives every domain a world of the
+// base size stacked vertically, so the work per domain stays the same. Every
+// run starts from a freshly built scene, domains are horizontal strips.
+struct ScalingConfig
+{
+	unsigned int maxThreads = 1;
+	std::vector<std::pair<unsigned int, unsigned int>> sizes;	// strong scaling, the first one is the weak base
+	unsigned int ticks = 30;
+	unsigned int seed = 1;
+	std::string scene = "test";	// see BuildScene
+};
+
+struct ScalingPoint
+{
+	bool weak = false;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int threads = 0;
+	bool skipped = false;			// the world did not fit into memory, or the run failed
+	double seconds = 0.0;			// in the tick loop, without the workers' setup
+	double cellsPerSecond = 0.0;
+	double speedup = 0.0;			// over one thread; for weak scaling, of the throughput
+	double efficiency = 0.0;		// speedup / threads
+	double bandwidth = 0.0;			// bytes/s the sweep streams, estimated from the plane sizes
+};
+
+// Run every point, printing progress. Points are in run order.
+std::vector<ScalingPoint> RunScalingBench(const ScalingConfig& config);
+
+// Write config and points to path as JSON.
+bool WriteScalingJson(const std::string& path, const ScalingConfig& config, const std::vector<ScalingPoint>& points);
@@ -0,0 +1,182 @@
+#include "Scenes.h"
+#include "ParticleSim.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+void BuildTestScene(ParticleSim& sim, unsigned int seed)
+{
+	World& world = sim.GetWorld();
+	sim.SetSeed(seed);
+
+	for (unsigned int y = world.height - 4; y < world.height; ++y)
+		for (unsigned int x = 0; x < world.width; ++x)
+			sim.WriteData(sim.ComputeID(x, y), ParticleSim::ParticleStone());
+
+	const unsigned int ledges = world.width * world.height / 20000 + 1;
+	for (unsigned int i = 0; i < ledges; ++i) {
+		const int lx = sim.RandomVal(0, world.width - 1);
+		const int ly = sim.RandomVal(world.height / 3, world.height - 5);
+		const int length = sim.RandomVal(20, 120);
+		for (int x = lx; x < lx + length && x < (int)world.width; ++x)
+			sim.WriteData(sim.ComputeID(x, ly), ParticleSim::ParticleStone());
+	}
+
+	const uint8_t materials[] = { mat_id_sand, mat_id_water, mat_id_sand, mat_id_water, mat_id_fire };
+	const unsigned int blobs = world.width * world.height / 4000 + 1;
+	for (unsigned int i = 0; i < blobs; ++i) {
+		const int bx = sim.RandomVal(0, world.width - 1);
+		const int by = sim.RandomVal(0, world.height / 2);
+		sim.Paint(bx, by, static_cast<float>(sim.RandomVal(5, 20)), materials[i % 5]);
+	}
+}
+
+namespace
+{
+	// Integer hash of a lattice point, the source of all randomness of the terrain.
+	uint32_t Hash(uint32_t x, uint32_t y, uint32_t seed)
+	{
+		uint32_t h = seed * 0x9E3779B9u ^ x * 0x85EBCA6Bu ^ y * 0xC2B2AE35u;
+		h ^= h >> 16;
+		h *= 0x7FEB352Du;
+		h ^= h >> 15;
+		h *= 0x846CA68Bu;
+		h ^= h >> 16;
+		return h;
+	}
+
+	float Unit(uint32_t h)
+	{
+		return (h >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Smooth 1D value noise in [0, 1), one lattice point per unit of x.
+	float ValueNoise(float x, uint32_t seed)
+	{
+		const float fx = std::floor(x);
+		const int i = static_cast<int>(fx);
+		const float t = x - fx;
+		const float s = t * t * (3.0f - 2.0f * t);
+		const float a = Unit(Hash(static_cast<uint32_t>(i), 0, seed));
+		const float b = Unit(Hash(static_cast<uint32_t>(i + 1), 0, seed));
+		return a + (b - a) * s;
+	}
+
+	// Octaves of noise, each half the wavelength and amplitude of the last, in [0, 1).
+	float LayeredNoise(float x, uint32_t seed, int octaves)
+	{
+		float sum = 0.0f;
+		float amplitude = 0.5f;
+		float total = 0.0f;
+		for (int o = 0; o < octaves; ++o) {
+			sum += amplitude * ValueNoise(x, seed + o * 101u);
+			total += amplitude;
+			x *= 2.0f;
+			amplitude *= 0.5f;
+		}
+		return sum / total;
+	}
+
+	// wavelengths in cells, so larger worlds get more hills rather than larger ones
+	constexpr float hillWavelength = 400.0f;
+	constexpr float duneWavelength = 60.0f;
+	constexpr unsigned int pocketGrid = 48;		// at most one fire pocket per grid square
+	constexpr unsigned int rowsPerTask = 32;
+
+	struct Column
+	{
+		int stone;	// first stone row
+		int sand;	// first sand row, stone or above
+	};
+}
+
+void BuildTerrainScene(ParticleSim& sim, unsigned int seed, ThreadPool& pool)
+{
+	World& world = sim.GetWorld();
+	sim.SetSeed(seed);
+
+	const int height = static_cast<int>(world.height);
+	const int waterLine = height * 6 / 10;
+	const size_t columnTasks = (world.width + 255) / 256;
+
+	// surface heights of every column
+	std::vector<Column> columns(world.width);
+	pool.ParallelFor(columnTasks, [&](size_t task) {
+		const unsigned int xEnd = std::min<unsigned int>(world.width, static_cast<unsigned int>(task + 1) * 256);
+		for (unsigned int x = static_cast<unsigned int>(task) * 256; x < xEnd; ++x) {
+			const float hills = LayeredNoise(x / hillWavelength, seed, 5);
+			const float dunes = LayeredNoise(x / duneWavelength, seed + 7919u, 2);
+			Column& c = columns[x];
+			c.stone = std::clamp(static_cast<int>(height * (0.35f + 0.5f * hills)), 1, height - 1);
+			c.sand = std::max(0, c.stone - static_cast<int>(std::max(0.0f, dunes - 0.45f) * height * 0.15f));
+		}
+	});
+
+	const Particle stone = ParticleSim::ParticleStone();
+	const Particle sand = ParticleSim::ParticleSand();
+	const Particle water = ParticleSim::ParticleWater();
+	const Particle fire = ParticleSim::ParticleFire();
+	const Particle empty = ParticleSim::ParticleEmpty();
+
+	// Is (x, y) inside the fire pocket of grid square (gx, gy)?
+	auto inPocket = [&](int x, int y, int gx, int gy) {
+		if (gx < 0 || gy < 0)
+			return false;
+		const uint32_t h = Hash(static_cast<uint32_t>(gx), static_cast<uint32_t>(gy), seed + 31337u);
+		if ((h & 7) != 0)
+			return false;
+		const int px = gx * static_cast<int>(pocketGrid) + static_cast<int>((h >> 3) % pocketGrid);
+		const int py = gy * static_cast<int>(pocketGrid) + static_cast<int>((h >> 11) % pocketGrid);
+		const int r = 3 + static_cast<int>((h >> 19) % 8);
+		return (x - px) * (x - px) + (y - py) * (y - py) <= r * r;
+	};
+
+	const size_t rowTasks = (world.height + rowsPerTask - 1) / rowsPerTask;
+	pool.ParallelFor(rowTasks, [&](size_t task) {
+		const unsigned int yBegin = static_cast<unsigned int>(task) * rowsPerTask;
+		const unsigned int yEnd = std::min(world.height, yBegin + rowsPerTask);
+		for (unsigned int y = yBegin; y < yEnd; ++y) {
+			const int gy = static_cast<int>(y / pocketGrid);
+			for (unsigned int x = 0; x < world.width; ++x) {
+				const Column& c = columns[x];
+				const int iy = static_cast<int>(y);
+				const Particle* p = &empty;
+
+				if (iy >= c.stone) {
+					p = &stone;
+					// pockets reach into neighbouring squares by their radius
+					const int gx = static_cast<int>(x / pocketGrid);
+					if (iy > c.stone + 4)
+						for (int dy = -1; dy <= 1 && p == &stone; ++dy)
+							for (int dx = -1; dx <= 1; ++dx)
+								if (inPocket(static_cast<int>(x), iy, gx + dx, gy + dy)) {
+									p = &fire;
+									break;
+								}
+				}
+				else if (iy >= c.sand)
+					p = &sand;
+				else if (iy >= waterLine)
+					p = &water;
+
+				const size_t i = static_cast<size_t>(y) * world.width + x;
+				world.particles[i] = *p;
+				world.colors[i] = p->color;
+			}
+		}
+	});
+
+	world.TouchAll();
+}
+
+bool BuildScene(ParticleSim& sim, const std::string& name, unsigned int seed, ThreadPool& pool)
+{
+	if (name == "test")
+		BuildTestScene(sim, seed);
+	else if (name == "terrain")
+		BuildTerrainScene(sim, seed, pool);
+	else
+		return false;
+	return true;
+}
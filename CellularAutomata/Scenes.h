@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+class ParticleSim;
+class ThreadPool;
+
+// Stone floor and ledges with blobs of sand, water and fire dropped on them.
+// Reseeds sim, so the same seed always builds the same scene.
+void BuildTestScene(ParticleSim& sim, unsigned int seed);
+
+// Generated landscape for worlds of any size: stone hills from layered noise,
+// sand dunes on top, water filling the valleys below a water line and pockets
+// of fire in the rock. Every cell is computed on its own from the seed and
+// written straight into the planes, rows spread over the pool, so the result
+// does not depend on the number of threads. Reseeds sim.
+void BuildTerrainScene(ParticleSim& sim, unsigned int seed, ThreadPool& pool);
+
+// Build the scene called name ("test" or "terrain"), false for other names.
+bool BuildScene(ParticleSim& sim, const std::string& name, unsigned int seed, ThreadPool& pool);
@@ -0,0 +1,167 @@
+#include "SharedMemory.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+	std::string SystemName(const std::string& name) { return "Local\\" + name; }
+#else
+	std::string SystemName(const std::string& name) { return "/" + name; }
+#endif
+}
+
+SharedMemory::~SharedMemory()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool SharedMemory::Create(const std::string& name, size_t size)
+{
+	Close();
+
+	const unsigned long long size64 = size;
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xFFFFFFFF), SystemName(name).c_str());
+	if (mapping == nullptr)
+		return false;
+
+	if (GetLastError() == ERROR_ALREADY_EXISTS) {
+		CloseHandle(mapping);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		return false;
+	}
+
+	mName = name;
+	mMapping = mapping;
+	mData = data;
+	mSize = size;
+	mOwner = true;
+	return true;
+}
+
+bool SharedMemory::Open(const std::string& name, bool readOnly)
+{
+	Close();
+
+	HANDLE mapping = OpenFileMappingA(readOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, FALSE, SystemName(name).c_str());
+	if (mapping == nullptr)
+		return false;
+
+	void* data = MapViewOfFile(mapping, readOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		return false;
+	}
+
+	MEMORY_BASIC_INFORMATION info = {};
+	VirtualQuery(data, &info, sizeof(info));
+
+	mName = name;
+	mMapping = mapping;
+	mData = data;
+	mSize = info.RegionSize;
+	mOwner = false;
+	return true;
+}
+
+void SharedMemory::Close()
+{
+	if (mData != nullptr)
+		UnmapViewOfFile(mData);
+	if (mMapping != nullptr)
+		CloseHandle(mMapping);
+
+	mMapping = nullptr;
+	mData = nullptr;
+	mSize = 0;
+	mOwner = false;
+	mName.clear();
+}
+
+#else
+
+bool SharedMemory::Create(const std::string& name, size_t size)
+{
+	Close();
+
+	const std::string sysName = SystemName(name);
+	int fd = shm_open(sysName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0)
+		return false;
+
+	if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+		close(fd);
+		shm_unlink(sysName.c_str());
+		return false;
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		shm_unlink(sysName.c_str());
+		return false;
+	}
+
+	mName = name;
+	mData = data;
+	mSize = size;
+	mOwner = true;
+	return true;
+}
+
+bool SharedMemory::Open(const std::string& name, bool readOnly)
+{
+	Close();
+
+	int fd = shm_open(SystemName(name).c_str(), readOnly ? O_RDONLY : O_RDWR, 0);
+	if (fd < 0)
+		return false;
+
+	struct stat st = {};
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+
+	const size_t size = static_cast<size_t>(st.st_size);
+	void* data = mmap(nullptr, size, readOnly ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	mName = name;
+	mData = data;
+	mSize = size;
+	mOwner = false;
+	return true;
+}
+
+void SharedMemory::Close()
+{
+	if (mData != nullptr)
+		munmap(mData, mSize);
+	if (mOwner)
+		shm_unlink(SystemName(mName).c_str());
+
+	mData = nullptr;
+	mSize = 0;
+	mOwner = false;
+	mName.clear();
+}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Named shared memory region (file mapping on Windows, POSIX shm elsewhere)
+// mapped into the address space of every process that opens it.
+class SharedMemory
+{
+public:
+	SharedMemory() = default;
+	~SharedMemory();
+
+	SharedMemory(const SharedMemory& rhs) = delete;
+	SharedMemory& operator=(const SharedMemory& rhs) = delete;
+
+	// Create a zero filled region. The creator removes the name again on Close().
+	bool Create(const std::string& name, size_t size);
+
+	// Map an existing region created by another process.
+	bool Open(const std::string& name, bool readOnly = false);
+
+	void Close();
+
+	void* Data() const { return mData; }
+	size_t Size() const { return mSize; }
+	const std::string& Name() const { return mName; }
+
+private:
+	std::string mName;
+	void* mData = nullptr;
+	size_t mSize = 0;
+	bool mOwner = false;
+
+#ifdef _WIN32
+	void* mMapping = nullptr;
+#endif
+};
@@ -0,0 +1,199 @@
+#include "Socket.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+	using Handle = SOCKET;
+
+	bool StartNetworking()
+	{
+		static const bool started = [] {
+			WSADATA data;
+			return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		}();
+		return started;
+	}
+
+	void CloseSocket(Handle h) { closesocket(h); }
+	bool WouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+
+	void SetNonBlocking(Handle h)
+	{
+		u_long on = 1;
+		ioctlsocket(h, FIONBIO, &on);
+	}
+#else
+	using Handle = int;
+
+	bool StartNetworking() { return true; }
+	void CloseSocket(Handle h) { close(h); }
+	bool WouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+
+	void SetNonBlocking(Handle h)
+	{
+		fcntl(h, F_SETFL, fcntl(h, F_GETFL, 0) | O_NONBLOCK);
+	}
+#endif
+
+	// frames are small and latency matters more than packet count
+	void SetNoDelay(Handle h)
+	{
+		int on = 1;
+		setsockopt(h, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+	}
+
+	Handle ToHandle(intptr_t h) { return static_cast<Handle>(h); }
+}
+
+Socket::~Socket()
+{
+	Close();
+}
+
+Socket::Socket(Socket&& rhs) noexcept
+	: mHandle(std::exchange(rhs.mHandle, invalidHandle))
+{
+}
+
+Socket& Socket::operator=(Socket&& rhs) noexcept
+{
+	if (this != &rhs) {
+		Close();
+		mHandle = std::exchange(rhs.mHandle, invalidHandle);
+	}
+	return *this;
+}
+
+void Socket::Close()
+{
+	if (Valid())
+		CloseSocket(ToHandle(mHandle));
+	mHandle = invalidHandle;
+}
+
+bool Socket::Listen(uint16_t port, bool loopbackOnly)
+{
+	Close();
+	if (!StartNetworking())
+		return false;
+
+	const Handle h = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (h == static_cast<Handle>(invalidHandle))
+		return false;
+
+	int reuse = 1;
+	setsockopt(h, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+
+	if (bind(h, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(h, 8) != 0) {
+		CloseSocket(h);
+		return false;
+	}
+
+	SetNonBlocking(h);
+	mHandle = static_cast<intptr_t>(h);
+	return true;
+}
+
+bool Socket::Accept(Socket& client)
+{
+	if (!Valid())
+		return false;
+
+	const Handle h = accept(ToHandle(mHandle), nullptr, nullptr);
+	if (h == static_cast<Handle>(invalidHandle))
+		return false;
+
+	SetNonBlocking(h);
+	SetNoDelay(h);
+	client = Socket(static_cast<intptr_t>(h));
+	return true;
+}
+
+bool Socket::Connect(const std::string& host, uint16_t port)
+{
+	Close();
+	if (!StartNetworking())
+		return false;
+
+	addrinfo hints = {};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo* found = nullptr;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0)
+		return false;
+
+	Handle h = static_cast<Handle>(invalidHandle);
+	for (addrinfo* a = found; a != nullptr; a = a->ai_next) {
+		h = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (h == static_cast<Handle>(invalidHandle))
+			continue;
+		if (connect(h, a->ai_addr, static_cast<int>(a->ai_addrlen)) == 0)
+			break;
+		CloseSocket(h);
+		h = static_cast<Handle>(invalidHandle);
+	}
+	freeaddrinfo(found);
+
+	if (h == static_cast<Handle>(invalidHandle))
+		return false;
+
+	SetNonBlocking(h);
+	SetNoDelay(h);
+	mHandle = static_cast<intptr_t>(h);
+	return true;
+}
+
+long long Socket::SendSome(const void* data, size_t size)
+{
+	if (!Valid())
+		return -1;
+
+#ifdef _WIN32
+	const int sent = send(ToHandle(mHandle), static_cast<const char*>(data), static_cast<int>(size), 0);
+#else
+	const ssize_t sent = send(ToHandle(mHandle), data, size, MSG_NOSIGNAL);
+#endif
+	if (sent >= 0)
+		return sent;
+	return WouldBlock() ? 0 : -1;
+}
+
+long long Socket::ReceiveSome(void* data, size_t size)
+{
+	if (!Valid())
+		return -1;
+
+#ifdef _WIN32
+	const int received = recv(ToHandle(mHandle), static_cast<char*>(data), static_cast<int>(size), 0);
+#else
+	const ssize_t received = recv(ToHandle(mHandle), data, size, 0);
+#endif
+	if (received > 0)
+		return received;
+	if (received == 0)
+		return -1;
+	return WouldBlock() ? 0 : -1;
+}
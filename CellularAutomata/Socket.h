@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Minimal non-blocking TCP socket over Winsock and BSD sockets.
+class Socket
+{
+public:
+	Socket() = default;
+	~Socket();
+
+	Socket(Socket&& rhs) noexcept;
+	Socket& operator=(Socket&& rhs) noexcept;
+	Socket(const Socket& rhs) = delete;
+	Socket& operator=(const Socket& rhs) = delete;
+
+	// Listen on port, on the loopback interface unless loopbackOnly is false.
+	bool Listen(uint16_t port, bool loopbackOnly = true);
+
+	// Take a pending connection, false if there is none.
+	bool Accept(Socket& client);
+
+	// Blocking connect; the socket is non-blocking afterwards.
+	bool Connect(const std::string& host, uint16_t port);
+
+	// Send what the socket takes right now: bytes sent, or -1 when the
+	// connection failed.
+	long long SendSome(const void* data, size_t size);
+
+	// Bytes received, 0 when nothing is available, -1 when the connection closed or failed.
+	long long ReceiveSome(void* data, size_t size);
+
+	bool Valid() const { return mHandle != invalidHandle; }
+	void Close();
+
+private:
+	static constexpr intptr_t invalidHandle = -1;
+
+	explicit Socket(intptr_t handle) : mHandle(handle) {}
+
+	// SOCKET on Windows, a file descriptor elsewhere
+	intptr_t mHandle = invalidHandle;
+};
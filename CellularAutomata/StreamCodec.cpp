@@ -0,0 +1,154 @@
+#include "StreamCodec.h"
+
+#include <cstring>
+
+namespace
+{
+	constexpr size_t minMatch = 4;
+	constexpr size_t maxOffset = 65535;
+	constexpr unsigned int hashBits = 12;
+
+	uint32_t Read32(const uint8_t* p)
+	{
+		uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	uint32_t Hash(uint32_t v)
+	{
+		return (v * 2654435761u) >> (32 - hashBits);
+	}
+
+	void WriteLength(size_t length, std::vector<uint8_t>& out)
+	{
+		for (; length >= 255; length -= 255)
+			out.push_back(255);
+		out.push_back(static_cast<uint8_t>(length));
+	}
+
+	void EmitToken(const uint8_t* literals, size_t literalCount, size_t matchLength, size_t offset,
+		std::vector<uint8_t>& out)
+	{
+		const size_t matchCode = matchLength ? matchLength - minMatch : 0;
+		out.push_back(static_cast<uint8_t>((literalCount < 15 ? literalCount : 15) << 4 | (matchCode < 15 ? matchCode : 15)));
+
+		if (literalCount >= 15)
+			WriteLength(literalCount - 15, out);
+		out.insert(out.end(), literals, literals + literalCount);
+
+		if (matchLength == 0)
+			return;
+		out.push_back(static_cast<uint8_t>(offset & 0xFF));
+		out.push_back(static_cast<uint8_t>(offset >> 8));
+		if (matchCode >= 15)
+			WriteLength(matchCode - 15, out);
+	}
+
+	bool ReadLength(const uint8_t*& p, const uint8_t* end, size_t& length)
+	{
+		for (;;) {
+			if (p == end)
+				return false;
+			const uint8_t b = *p++;
+			length += b;
+			if (b != 255)
+				return true;
+		}
+	}
+}
+
+void CompressBytes(const uint8_t* src, size_t size, std::vector<uint8_t>& out)
+{
+	uint32_t table[1 << hashBits];
+	std::memset(table, 0xFF, sizeof(table));
+
+	size_t anchor = 0;
+	size_t i = 0;
+
+	while (size >= minMatch && i + minMatch <= size) {
+		size_t offset = 0;
+		size_t length = 0;
+
+		// runs of the previous byte
+		if (i > 0 && src[i] == src[i - 1]) {
+			size_t n = 0;
+			while (i + n < size && src[i + n] == src[i - 1])
+				++n;
+			if (n >= minMatch) {
+				offset = 1;
+				length = n;
+			}
+		}
+
+		// earlier occurrence of the next four bytes
+		const uint32_t v = Read32(src + i);
+		const uint32_t h = Hash(v);
+		const uint32_t candidate = table[h];
+		table[h] = static_cast<uint32_t>(i);
+
+		if (length == 0 && candidate != 0xFFFFFFFFu && i - candidate <= maxOffset && Read32(src + candidate) == v) {
+			size_t n = minMatch;
+			while (i + n < size && src[candidate + n] == src[i + n])
+				++n;
+			offset = i - candidate;
+			length = n;
+		}
+
+		if (length == 0) {
+			++i;
+			continue;
+		}
+
+		EmitToken(src + anchor, i - anchor, length, offset, out);
+		i += length;
+		anchor = i;
+	}
+
+	EmitToken(src + anchor, size - anchor, 0, 0, out);
+}
+
+bool DecompressBytes(const uint8_t* src, size_t size, uint8_t* dst, size_t dstSize)
+{
+	const uint8_t* p = src;
+	const uint8_t* end = src + size;
+	size_t written = 0;
+
+	while (p < end) {
+		const uint8_t token = *p++;
+
+		size_t literals = token >> 4;
+		if (literals == 15 && !ReadLength(p, end, literals))
+			return false;
+		if (literals > static_cast<size_t>(end - p) || literals > dstSize - written)
+			return false;
+		std::memcpy(dst + written, p, literals);
+		p += literals;
+		written += literals;
+
+		// the last token has no match
+		if (p == end)
+			break;
+
+		if (end - p < 2)
+			return false;
+		const size_t offset = p[0] | (size_t(p[1]) << 8);
+		p += 2;
+
+		size_t length = token & 0x0F;
+		if (length == 15 && !ReadLength(p, end, length))
+			return false;
+		length += minMatch;
+
+		if (offset == 0 || offset > written || length > dstSize - written)
+			return false;
+
+		// byte by byte, matches may overlap what they produce
+		const uint8_t* from = dst + written - offset;
+		for (size_t k = 0; k < length; ++k)
+			dst[written + k] = from[k];
+		written += length;
+	}
+
+	return written == dstSize;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Small byte oriented LZ codec for the world stream, in the spirit of LZ4.
+//
+// The output is a sequence of tokens, each a run of literals followed by a
+// match (offset, length) into the bytes already produced. A match with offset
+// 1 repeats the previous byte, which is how runs are encoded: the compressor
+// looks for a run first and only then for an earlier occurrence through a hash
+// of the next four bytes. Chunks are split into planes before compression (all
+// ids, then all reds, ...), so materials and flat colors turn into long runs.
+//
+// Token layout: one byte holding the literal count in the high nibble and the
+// match length - minMatch in the low nibble, 15 meaning more length bytes
+// follow (each adding up to 255). Then the literals, then a two byte little
+// endian offset. The last token has literals only.
+
+// Append the compressed form of src to out.
+void CompressBytes(const uint8_t* src, size_t size, std::vector<uint8_t>& out);
+
+// Decompress exactly dstSize bytes, false on malformed input.
+bool DecompressBytes(const uint8_t* src, size_t size, uint8_t* dst, size_t dstSize);
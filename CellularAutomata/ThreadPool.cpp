@@ -0,0 +1,81 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+
+	for (unsigned int i = 1; i < threads; ++i)
+		mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+
+	for (std::thread& worker : mWorkers)
+		worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn)
+{
+	if (count == 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFn = &fn;
+		mCount = count;
+		mNext = 0;
+		++mGeneration;
+	}
+	mWake.notify_all();
+
+	RunIterations();
+
+	// workers still finishing their last iteration keep fn alive until they are done
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [this] { return mBusy == 0 && mNext >= mCount; });
+	mFn = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	unsigned int seen = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [&] { return mStop || mGeneration != seen; });
+			if (mStop)
+				return;
+			seen = mGeneration;
+		}
+
+		RunIterations();
+	}
+}
+
+void ThreadPool::RunIterations()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	++mBusy;
+
+	while (mFn != nullptr && mNext < mCount) {
+		const size_t i = mNext++;
+		const std::function<void(size_t)>& fn = *mFn;
+
+		lock.unlock();
+		fn(i);
+		lock.lock();
+	}
+
+	if (--mBusy == 0)
+		mDone.notify_all();
+}
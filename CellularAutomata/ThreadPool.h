@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run the iterations of a parallel loop.
+// The calling thread joins in, so a pool of one thread runs everything inline.
+class ThreadPool
+{
+public:
+	// threads == 0 uses one thread per hardware thread.
+	explicit ThreadPool(unsigned int threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+
+	// Call fn(i) for every i in [0, count) and return once all calls finished.
+	// Iterations are handed out one at a time, so uneven work balances itself.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+	unsigned int ThreadCount() const { return static_cast<unsigned int>(mWorkers.size()) + 1; }
+
+private:
+	void WorkerLoop();
+	void RunIterations();
+
+	std::vector<std::thread> mWorkers;
+
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+
+	// current loop, guarded by mMutex
+	const std::function<void(size_t)>* mFn = nullptr;
+	size_t mCount = 0;
+	size_t mNext = 0;
+	unsigned int mBusy = 0;
+	unsigned int mGeneration = 0;
+	bool mStop = false;
+};
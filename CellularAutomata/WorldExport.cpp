@@ -0,0 +1,122 @@
+#include "WorldExport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace
+{
+	constexpr size_t sectionAlign = 64;
+
+	// no slot has been published yet
+	constexpr uint32_t noSlot = ~0u;
+
+	size_t Align(size_t v)
+	{
+		return (v + sectionAlign - 1) & ~(sectionAlign - 1);
+	}
+}
+
+WorldExport::~WorldExport()
+{
+	Close();
+}
+
+bool WorldExport::Create(const std::string& name, unsigned int width, unsigned int height)
+{
+	Close();
+
+	const size_t cells = static_cast<size_t>(width) * height;
+	const size_t idBytes = Align(cells);
+	const size_t colorBytes = Align(cells * sizeof(Color32));
+
+	size_t size = Align(sizeof(WorldExportHeader));
+	size_t idOffset[WorldExportHeader::slotCount];
+	size_t colorOffset[WorldExportHeader::slotCount];
+	for (uint32_t s = 0; s < WorldExportHeader::slotCount; ++s) {
+		idOffset[s] = size;
+		colorOffset[s] = size + idBytes;
+		size += idBytes + colorBytes;
+	}
+
+	if (!mShared.Create(name, size))
+		return false;
+
+	WorldExportHeader* h = new (mShared.Data()) WorldExportHeader;
+	h->width = width;
+	h->height = height;
+	for (uint32_t s = 0; s < WorldExportHeader::slotCount; ++s) {
+		h->idOffset[s] = idOffset[s];
+		h->colorOffset[s] = colorOffset[s];
+		h->sequence[s].store(0, std::memory_order_relaxed);
+		h->frame[s] = 0;
+		mCheckpoint[s] = 0;
+	}
+	h->latest.store(noSlot, std::memory_order_relaxed);
+	h->closed.store(0, std::memory_order_relaxed);
+	mNext = 0;
+
+	// readers check the magic last
+	std::atomic_thread_fence(std::memory_order_release);
+	h->magic = WorldExportHeader::magicValue;
+	return true;
+}
+
+void WorldExport::Publish(World& world, uint64_t frame)
+{
+	WorldExportHeader* h = Header();
+	if (h == nullptr || world.width != h->width || world.height != h->height)
+		return;
+
+	const uint32_t slot = mNext;
+	uint8_t* ids = static_cast<uint8_t*>(mShared.Data()) + h->idOffset[slot];
+	Color32* colors = reinterpret_cast<Color32*>(static_cast<uint8_t*>(mShared.Data()) + h->colorOffset[slot]);
+
+	const uint32_t sequence = h->sequence[slot].load(std::memory_order_relaxed);
+	h->sequence[slot].store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	const size_t chunkCount = world.chunkStamps.size();
+	for (size_t c = 0; c < chunkCount; ++c) {
+		if (!world.ChangedSince(c, mCheckpoint[slot]))
+			continue;
+
+		const unsigned int x0 = static_cast<unsigned int>(c % world.chunksX) << chunkShift;
+		const unsigned int y0 = static_cast<unsigned int>(c / world.chunksX) << chunkShift;
+		const unsigned int x1 = std::min(x0 + chunkSize, world.width);
+		const unsigned int y1 = std::min(y0 + chunkSize, world.height);
+
+		for (unsigned int y = y0; y < y1; ++y) {
+			const size_t row = static_cast<size_t>(y) * world.width;
+			for (unsigned int x = x0; x < x1; ++x)
+				ids[row + x] = world.particles[row + x].id;
+			std::memcpy(&colors[row + x0], &world.colors[row + x0], (x1 - x0) * sizeof(Color32));
+		}
+	}
+	h->frame[slot] = frame;
+
+	h->sequence[slot].store(sequence + 2, std::memory_order_release);
+	h->latest.store(slot, std::memory_order_release);
+
+	mCheckpoint[slot] = world.Checkpoint();
+	mNext = (slot + 1) % WorldExportHeader::slotCount;
+}
+
+void WorldExport::Close()
+{
+	if (WorldExportHeader* h = Header())
+		h->closed.store(1, std::memory_order_release);
+	mShared.Close();
+}
+
+bool WorldExportReader::Open(const std::string& name)
+{
+	if (!mShared.Open(name, true))
+		return false;
+
+	if (mShared.Size() < sizeof(WorldExportHeader) || Header().magic != WorldExportHeader::magicValue) {
+		mShared.Close();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "ParticleSim.h"
+#include "SharedMemory.h"
+
+#include <atomic>
+#include <string>
+
+// Read-only view of the live world for other processes.
+//
+// The region starts with a WorldExportHeader followed by two slots, each an
+// id plane (one byte per cell) and a color plane (Color32 per cell, the same
+// layout the renderer uploads), both row major. The publisher alternates
+// between the slots, so a reader has a whole tick to look at the newest one.
+// Publish() only copies the chunks the world stamped since the slot was last
+// written, so exporting a mostly resting world costs next to nothing.
+//
+// Every slot is guarded by a sequence counter: odd while the slot is written,
+// bumped to the next even value when done. A reader takes the slot named by
+// latest, reads its sequence, looks at the planes in place and accepts what
+// it saw if the sequence did not change meanwhile.
+struct WorldExportHeader
+{
+	static constexpr uint32_t magicValue = 0x58454143; // "CAEX"
+	static constexpr uint32_t slotCount = 2;
+
+	uint32_t magic;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pad;
+
+	// byte offsets from the start of the region
+	uint64_t idOffset[slotCount];
+	uint64_t colorOffset[slotCount];
+
+	std::atomic<uint32_t> sequence[slotCount];
+	std::atomic<uint32_t> latest;		// slot holding the newest complete frame
+	std::atomic<uint32_t> closed;		// set when the publisher shut down
+	uint64_t frame[slotCount];			// tick each slot holds, written under its sequence
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "sequence counters must work across processes");
+
+class WorldExport
+{
+public:
+	~WorldExport();
+
+	// Create the region for a width x height world.
+	bool Create(const std::string& name, unsigned int width, unsigned int height);
+
+	// Copy the chunks changed since the next slot was last written and make
+	// that slot the latest.
+	void Publish(World& world, uint64_t frame);
+
+	// Tell readers no more frames follow and remove the region.
+	void Close();
+
+	size_t MemoryBytes() const { return mShared.Size(); }
+
+private:
+	WorldExportHeader* Header() const { return static_cast<WorldExportHeader*>(mShared.Data()); }
+
+	SharedMemory mShared;
+	uint64_t mCheckpoint[WorldExportHeader::slotCount] = {};
+	uint32_t mNext = 0;
+};
+
+// Reader side: maps a region created by WorldExport read only.
+class WorldExportReader
+{
+public:
+	bool Open(const std::string& name);
+	void Close() { mShared.Close(); }
+
+	const WorldExportHeader& Header() const { return *static_cast<const WorldExportHeader*>(mShared.Data()); }
+
+	// Let visit look at the newest frame in place: visit(frame, ids, colors).
+	// Retries when the publisher overwrote the slot while visit ran; visit
+	// should therefore only read. False if no frame was published yet.
+	template <typename Visit>
+	bool ReadLatest(Visit&& visit) const;
+
+	bool PublisherClosed() const { return Header().closed.load(std::memory_order_acquire) != 0; }
+
+private:
+	const uint8_t* Bytes() const { return static_cast<const uint8_t*>(mShared.Data()); }
+
+	SharedMemory mShared;
+};
+
+template <typename Visit>
+bool WorldExportReader::ReadLatest(Visit&& visit) const
+{
+	const WorldExportHeader& h = Header();
+
+	for (;;) {
+		const uint32_t slot = h.latest.load(std::memory_order_acquire);
+		if (slot >= WorldExportHeader::slotCount)
+			return false;
+
+		const uint32_t before = h.sequence[slot].load(std::memory_order_acquire);
+		if (before & 1)
+			continue;
+
+		visit(h.frame[slot], Bytes() + h.idOffset[slot],
+			reinterpret_cast<const Color32*>(Bytes() + h.colorOffset[slot]));
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (h.sequence[slot].load(std::memory_order_relaxed) == before)
+			return true;
+	}
+}
@@ -0,0 +1,95 @@
+#include "WorldFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const char worldFileMagic[8] = { 'C', 'A', 'W', 'O', 'R', 'L', 'D', '1' };
+
+	bool HeaderValid(const WorldFileHeader& header)
+	{
+		return std::memcmp(header.magic, worldFileMagic, sizeof(worldFileMagic)) == 0 &&
+			header.particleSize == sizeof(Particle) && header.width > 0 && header.height > 0;
+	}
+}
+
+WorldFileHeader MakeWorldFileHeader(unsigned int width, unsigned int height, unsigned int frameCounter)
+{
+	WorldFileHeader header = {};
+	std::memcpy(header.magic, worldFileMagic, sizeof(worldFileMagic));
+	header.width = width;
+	header.height = height;
+	header.frameCounter = frameCounter;
+	header.particleSize = sizeof(Particle);
+	return header;
+}
+
+bool WriteWorldFile(const std::string& path, const WorldFileHeader& header, const Particle* particles, size_t count)
+{
+	const std::string temp = path + ".tmp";
+	FILE* file = std::fopen(temp.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		std::fwrite(particles, sizeof(Particle), count, file) == count;
+	ok = std::fclose(file) == 0 && ok;
+
+	// rename does not replace an existing file everywhere
+	std::remove(path.c_str());
+	if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+		std::remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool SaveWorld(const ParticleSim& sim, const std::string& path)
+{
+	const World& world = sim.GetWorld();
+	const WorldFileHeader header = MakeWorldFileHeader(world.width, world.height, sim.FrameCounter());
+	return WriteWorldFile(path, header, world.particles.data(), world.particles.size());
+}
+
+bool ReadWorldFileHeader(const std::string& path, WorldFileHeader& header)
+{
+	FILE* file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return false;
+
+	const bool ok = std::fread(&header, sizeof(header), 1, file) == 1 && HeaderValid(header);
+	std::fclose(file);
+	return ok;
+}
+
+bool LoadWorld(ParticleSim& sim, const std::string& path)
+{
+	World& world = sim.GetWorld();
+
+	FILE* file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return false;
+
+	WorldFileHeader header;
+	bool ok = std::fread(&header, sizeof(header), 1, file) == 1 && HeaderValid(header) &&
+		header.width == world.width && header.height == world.height;
+
+	std::vector<Particle> particles;
+	if (ok) {
+		particles.resize(world.particles.size());
+		ok = std::fread(particles.data(), sizeof(Particle), particles.size(), file) == particles.size();
+	}
+	std::fclose(file);
+	if (!ok)
+		return false;
+
+	// copy into the existing plane, pointers into it stay valid
+	std::copy(particles.begin(), particles.end(), world.particles.begin());
+	for (size_t i = 0; i < world.particles.size(); ++i)
+		world.colors[i] = world.particles[i].color;
+	world.TouchAll();
+	sim.SetFrameCounter(header.frameCounter);
+	return true;
+}
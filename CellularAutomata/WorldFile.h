@@ -0,0 +1,33 @@
+#pragma once
+
+#include "ParticleSim.h"
+
+#include <string>
+
+// Binary world file: a small header followed by the raw particle plane.
+// Files are only meant to be read back by the same build, the loader rejects
+// files written with a different particle layout.
+struct WorldFileHeader
+{
+	char magic[8];
+	uint32_t width;
+	uint32_t height;
+	uint32_t frameCounter;
+	uint32_t particleSize;
+};
+
+// Fill header for a world of the given size.
+WorldFileHeader MakeWorldFileHeader(unsigned int width, unsigned int height, unsigned int frameCounter);
+
+// Write a header and particle plane to path through a temporary file.
+bool WriteWorldFile(const std::string& path, const WorldFileHeader& header, const Particle* particles, size_t count);
+
+// Write the world of sim to path, through a temporary file so readers never
+// see a partly written world.
+bool SaveWorld(const ParticleSim& sim, const std::string& path);
+
+// Replace the world of sim, which has to be of the same size, with the file.
+bool LoadWorld(ParticleSim& sim, const std::string& path);
+
+// Read only the header, to find the size of the world a file holds.
+bool ReadWorldFileHeader(const std::string& path, WorldFileHeader& header);
@@ -0,0 +1,253 @@
+#include "WorldHistory.h"
+
+#include "StreamCodec.h"
+
+#include <algorithm>
+
+namespace
+{
+	struct ChunkRect
+	{
+		unsigned int x0, y0, x1, y1;
+	};
+
+	ChunkRect ChunkBounds(const World& world, size_t chunk)
+	{
+		ChunkRect r;
+		r.x0 = static_cast<unsigned int>(chunk % world.chunksX) << chunkShift;
+		r.y0 = static_cast<unsigned int>(chunk / world.chunksX) << chunkShift;
+		r.x1 = std::min(r.x0 + chunkSize, world.width);
+		r.y1 = std::min(r.y0 + chunkSize, world.height);
+		return r;
+	}
+
+	std::vector<uint8_t> Pack(const std::vector<Particle>& particles)
+	{
+		// byte planes (every first byte, then every second, ...) turn the runs of
+		// equal particles into runs of equal bytes
+		const size_t n = particles.size();
+		std::vector<uint8_t> planes(n * sizeof(Particle));
+		const uint8_t* src = reinterpret_cast<const uint8_t*>(particles.data());
+		for (size_t b = 0; b < sizeof(Particle); ++b)
+			for (size_t i = 0; i < n; ++i)
+				planes[b * n + i] = src[i * sizeof(Particle) + b];
+
+		std::vector<uint8_t> packed;
+		CompressBytes(planes.data(), planes.size(), packed);
+		packed.shrink_to_fit();
+		return packed;
+	}
+}
+
+WorldHistory::Chunk::~Chunk()
+{
+	history.mBytes -= Bytes();
+	history.mPackedBytes -= packed.size();
+}
+
+WorldHistory::WorldHistory(size_t capacity)
+	: mCapacity(capacity > 0 ? capacity : 1)
+{
+}
+
+WorldHistory::~WorldHistory()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_one();
+	if (mPacker.joinable())
+		mPacker.join();
+	Clear();
+}
+
+void WorldHistory::SetBudget(size_t bytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mBudget = bytes;
+	}
+	if (bytes > 0 && !mPacker.joinable())
+		mPacker = std::thread(&WorldHistory::PackLoop, this);
+	mWake.notify_one();
+}
+
+WorldHistory::ChunkPtr WorldHistory::CopyChunk(const World& world, size_t chunk)
+{
+	const ChunkRect r = ChunkBounds(world, chunk);
+	const unsigned int w = r.x1 - r.x0;
+
+	// rows are appended rather than written over a cleared buffer, the copy
+	// is most of what a capture costs
+	auto copy = std::make_shared<Chunk>(*this);
+	copy->cells = static_cast<size_t>(w) * (r.y1 - r.y0);
+	copy->particles.reserve(copy->cells);
+	for (unsigned int y = r.y0; y < r.y1; ++y) {
+		const auto src = world.particles.begin() + static_cast<size_t>(y) * world.width + r.x0;
+		copy->particles.insert(copy->particles.end(), src, src + w);
+	}
+
+	mBytes += copy->Bytes();
+	return copy;
+}
+
+// called with the lock held
+void WorldHistory::PopFront()
+{
+	mFrames.pop_front();
+	if (mPackedFrames > 0)
+		--mPackedFrames;
+	else
+		mPackChunk = 0;
+}
+
+// called with the lock held
+WorldHistory::ChunkPtr WorldHistory::NextToPack()
+{
+	// Compress from the oldest frame on. Chunks the latest frame uses are left
+	// alone, they are what the next capture and rewind touch.
+	if (mBudget == 0 || mBytes <= mBudget / 4 * 3 || mFrames.empty())
+		return nullptr;
+
+	const Frame& latest = mFrames.back();
+	for (; mPackedFrames + 1 < mFrames.size(); ++mPackedFrames, mPackChunk = 0) {
+		const Frame& frame = mFrames[mPackedFrames];
+		for (; mPackChunk < frame.chunks.size(); ++mPackChunk) {
+			const ChunkPtr& chunk = frame.chunks[mPackChunk];
+			if (chunk->packed.empty() && chunk != latest.chunks[mPackChunk])
+				return chunk;
+		}
+	}
+	return nullptr;
+}
+
+void WorldHistory::PackLoop()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (!mStop) {
+		ChunkPtr chunk = NextToPack();
+		if (!chunk) {
+			mWake.wait(lock);
+			continue;
+		}
+
+		// the particles of a published chunk never change, so they are read
+		// without the lock while the caller keeps capturing
+		lock.unlock();
+		std::vector<uint8_t> packed = Pack(chunk->particles);
+		lock.lock();
+
+		mBytes -= chunk->Bytes();
+		chunk->packed = std::move(packed);
+		std::vector<Particle>().swap(chunk->particles);
+		mBytes += chunk->Bytes();
+		mPackedBytes += chunk->packed.size();
+	}
+}
+
+void WorldHistory::Unpack(const Chunk& chunk, std::vector<Particle>& particles) const
+{
+	const size_t n = chunk.cells;
+	std::vector<uint8_t> planes(n * sizeof(Particle));
+	DecompressBytes(chunk.packed.data(), chunk.packed.size(), planes.data(), planes.size());
+
+	particles.resize(n);
+	uint8_t* dst = reinterpret_cast<uint8_t*>(particles.data());
+	for (size_t b = 0; b < sizeof(Particle); ++b)
+		for (size_t i = 0; i < n; ++i)
+			dst[i * sizeof(Particle) + b] = planes[b * n + i];
+}
+
+void WorldHistory::Capture(ParticleSim& sim)
+{
+	World& world = sim.GetWorld();
+	const size_t chunkCount = world.chunkStamps.size();
+
+	if (world.width != mWidth || world.height != mHeight) {
+		Clear();
+		mWidth = world.width;
+		mHeight = world.height;
+	}
+
+	Frame frame;
+	frame.frameCounter = sim.FrameCounter();
+	frame.chunks.resize(chunkCount);
+
+	const Frame* previous = mFrames.empty() ? nullptr : &mFrames.back();
+	for (size_t c = 0; c < chunkCount; ++c) {
+		if (previous != nullptr && !world.ChangedSince(c, mCheckpoint))
+			frame.chunks[c] = previous->chunks[c];
+		else
+			frame.chunks[c] = CopyChunk(world, c);
+	}
+	mCheckpoint = world.Checkpoint();
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mFrames.size() == mCapacity)
+			PopFront();
+		mFrames.push_back(std::move(frame));
+
+		// only when the packer fell behind
+		while (mBudget > 0 && mBytes > mBudget && mFrames.size() > 1) {
+			PopFront();
+			++mEvicted;
+		}
+	}
+	mWake.notify_one();
+}
+
+bool WorldHistory::Rewind(ParticleSim& sim, size_t frames)
+{
+	World& world = sim.GetWorld();
+	if (mFrames.empty() || world.width != mWidth || world.height != mHeight)
+		return false;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	frames = std::min(frames, mFrames.size() - 1);
+	const Frame& latest = mFrames.back();
+	const Frame& target = mFrames[mFrames.size() - 1 - frames];
+
+	// The world matches the latest frame except for chunks stamped since, so
+	// only those and the chunks that differ between the two frames are copied.
+	const size_t chunkCount = target.chunks.size();
+	std::vector<Particle> unpacked;
+	for (size_t c = 0; c < chunkCount; ++c) {
+		if (target.chunks[c] == latest.chunks[c] && !world.ChangedSince(c, mCheckpoint))
+			continue;
+
+		const ChunkRect r = ChunkBounds(world, c);
+		const unsigned int w = r.x1 - r.x0;
+		const Chunk& chunk = *target.chunks[c];
+		if (!chunk.packed.empty())
+			Unpack(chunk, unpacked);
+		const Particle* src = chunk.packed.empty() ? chunk.particles.data() : unpacked.data();
+		for (unsigned int y = r.y0; y < r.y1; ++y, src += w) {
+			const size_t row = static_cast<size_t>(y) * world.width;
+			std::copy(src, src + w, world.particles.begin() + row + r.x0);
+			for (unsigned int x = r.x0; x < r.x1; ++x)
+				world.colors[row + x] = world.particles[row + x].color;
+		}
+		world.Touch(r.x0, r.y0);
+	}
+	sim.SetFrameCounter(target.frameCounter);
+
+	for (; frames > 0; --frames)
+		mFrames.pop_back();
+	if (mPackedFrames >= mFrames.size()) {
+		mPackedFrames = mFrames.size();
+		mPackChunk = 0;
+	}
+	mCheckpoint = world.Checkpoint();
+	return true;
+}
+
+void WorldHistory::Clear()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mFrames.clear();
+	mPackedFrames = 0;
+	mPackChunk = 0;
+	mCheckpoint = 0;
+}
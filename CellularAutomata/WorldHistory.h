@@ -0,0 +1,114 @@
+#pragma once
+
+#include "ParticleSim.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Rolling history of world states for undo and rewind, one entry per
+// Capture() call.
+//
+// A snapshot is a list of shared, immutable chunk copies. Capture() only copies
+// the chunks the world stamped since the previous capture and shares every
+// other chunk with the previous snapshot, so a frame in which nothing moved
+// costs one pointer per chunk and memory grows with what changed, not with
+// world size times frames. Colors are not stored; they are rebuilt from the
+// particles on restore.
+//
+// With a memory budget, a packer thread compresses chunks, oldest frames
+// first, once the history passes three quarters of it, so Capture() itself
+// only copies. A capture that still takes the history over the budget, with
+// the packer behind, drops the oldest frames until it fits again.
+class WorldHistory
+{
+public:
+	explicit WorldHistory(size_t capacity);
+	~WorldHistory();
+
+	WorldHistory(const WorldHistory& rhs) = delete;
+	WorldHistory& operator=(const WorldHistory& rhs) = delete;
+
+	// Record the current state of sim. Drops the oldest frame when full.
+	void Capture(ParticleSim& sim);
+
+	// Return sim to the state captured frames captures before the latest one
+	// (0 undoes changes made since the last capture) and forget the newer
+	// frames. Clamps to the oldest frame, false if nothing was captured.
+	bool Rewind(ParticleSim& sim, size_t frames);
+
+	void Clear();
+
+	size_t Size() const { return mFrames.size(); }
+	size_t Capacity() const { return mCapacity; }
+
+	// Bytes the chunk copies may take, 0 for no limit. Starts the packer.
+	void SetBudget(size_t bytes);
+	size_t Budget() const { return mBudget; }
+
+	// bytes held by chunk copies, shared chunks counted once
+	size_t MemoryBytes() const { return mBytes; }
+	size_t PackedBytes() const { return mPackedBytes; }
+
+	// frames dropped to stay within the budget
+	size_t FramesEvicted() const { return mEvicted; }
+
+private:
+	// A chunk copy, either as particles or compressed. Compressing changes the
+	// representation, never the content, so frames sharing a chunk agree.
+	// Whichever thread drops the last reference takes its bytes off the count.
+	struct Chunk
+	{
+		explicit Chunk(WorldHistory& history) : history(history) {}
+		~Chunk();
+
+		WorldHistory& history;
+		std::vector<Particle> particles;
+		std::vector<uint8_t> packed;
+		size_t cells = 0;
+
+		size_t Bytes() const { return particles.size() * sizeof(Particle) + packed.size(); }
+	};
+	using ChunkPtr = std::shared_ptr<Chunk>;
+
+	struct Frame
+	{
+		std::vector<ChunkPtr> chunks;
+		unsigned int frameCounter;
+	};
+
+	ChunkPtr CopyChunk(const World& world, size_t chunk);
+	void PopFront();
+	ChunkPtr NextToPack();
+	void PackLoop();
+	void Unpack(const Chunk& chunk, std::vector<Particle>& particles) const;
+
+	// Frames are added and removed by the caller's thread only, so it reads
+	// them without the lock. Removing frames, changing a chunk's representation
+	// and reading one that may be packed happen under it.
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::thread mPacker;
+	bool mStop = false;
+
+	std::deque<Frame> mFrames;
+	size_t mCapacity;
+	std::atomic<size_t> mBytes{ 0 };
+	std::atomic<size_t> mPackedBytes{ 0 };
+	size_t mBudget = 0;
+	size_t mEvicted = 0;
+
+	// next chunk the packer looks at: frames at the front whose chunks are
+	// all packed, and the chunk within the frame after them
+	size_t mPackedFrames = 0;
+	size_t mPackChunk = 0;
+
+	// world checkpoint taken when the latest frame was captured
+	uint64_t mCheckpoint = 0;
+	unsigned int mWidth = 0;
+	unsigned int mHeight = 0;
+};
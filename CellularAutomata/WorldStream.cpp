@@ -0,0 +1,233 @@
+#include "WorldStream.h"
+#include "StreamCodec.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+	struct ChunkRect
+	{
+		unsigned int x0, y0, x1, y1;
+
+		size_t Cells() const { return static_cast<size_t>(x1 - x0) * (y1 - y0); }
+	};
+
+	ChunkRect ChunkBounds(const World& world, size_t chunk)
+	{
+		ChunkRect r;
+		r.x0 = static_cast<unsigned int>(chunk % world.chunksX) << chunkShift;
+		r.y0 = static_cast<unsigned int>(chunk / world.chunksX) << chunkShift;
+		r.x1 = std::min(r.x0 + chunkSize, world.width);
+		r.y1 = std::min(r.y0 + chunkSize, world.height);
+		return r;
+	}
+}
+
+bool StreamServer::Start(uint16_t port, unsigned int width, unsigned int height)
+{
+	Stop();
+	if (!mListener.Listen(port))
+		return false;
+
+	mWidth = width;
+	mHeight = height;
+	return true;
+}
+
+void StreamServer::Stop()
+{
+	mViewers.clear();
+	mListener.Close();
+	mEncoded.clear();
+	mEncodedPublish.clear();
+}
+
+const std::vector<uint8_t>& StreamServer::EncodedChunk(const World& world, size_t chunk)
+{
+	if (mEncodedPublish[chunk] == mPublishCount)
+		return mEncoded[chunk];
+
+	const ChunkRect r = ChunkBounds(world, chunk);
+	const size_t cells = r.Cells();
+
+	// planes of ids, reds, greens, blues and alphas
+	std::vector<uint8_t> planes(cells * 5);
+	size_t i = 0;
+	for (unsigned int y = r.y0; y < r.y1; ++y) {
+		const size_t row = static_cast<size_t>(y) * world.width;
+		for (unsigned int x = r.x0; x < r.x1; ++x, ++i) {
+			const Color32& c = world.colors[row + x];
+			planes[i] = world.particles[row + x].id;
+			planes[cells + i] = c.r;
+			planes[cells * 2 + i] = c.g;
+			planes[cells * 3 + i] = c.b;
+			planes[cells * 4 + i] = c.a;
+		}
+	}
+
+	std::vector<uint8_t>& encoded = mEncoded[chunk];
+	encoded.clear();
+	CompressBytes(planes.data(), planes.size(), encoded);
+	mEncodedPublish[chunk] = mPublishCount;
+	return encoded;
+}
+
+void StreamServer::QueueFrame(Viewer& viewer, const World& world, uint64_t frame)
+{
+	MessageChannel& out = viewer.channel;
+	out.BeginMessage(stream::messageFrame);
+	out.Write(stream::FrameHeader{ frame, 0 });
+
+	uint32_t chunkCount = 0;
+	for (size_t c = 0; c < world.chunkStamps.size(); ++c) {
+		if (!world.ChangedSince(c, viewer.checkpoint))
+			continue;
+
+		const std::vector<uint8_t>& encoded = EncodedChunk(world, c);
+		out.Write(stream::ChunkHeader{ static_cast<uint32_t>(c), static_cast<uint32_t>(encoded.size()) });
+		out.Write(encoded.data(), encoded.size());
+		++chunkCount;
+	}
+
+	out.Patch(offsetof(stream::FrameHeader, chunkCount), &chunkCount, sizeof(chunkCount));
+	out.EndMessage();
+	++mFramesSent;
+}
+
+size_t StreamServer::MemoryBytes() const
+{
+	size_t bytes = mEncodedPublish.capacity() * sizeof(uint64_t);
+	for (const std::vector<uint8_t>& chunk : mEncoded)
+		bytes += chunk.capacity();
+	for (const auto& viewer : mViewers)
+		bytes += viewer->channel.MemoryBytes();
+	return bytes;
+}
+
+void StreamServer::Publish(World& world, uint64_t frame)
+{
+	if (!mListener.Valid() || world.width != mWidth || world.height != mHeight)
+		return;
+
+	if (mEncoded.size() != world.chunkStamps.size()) {
+		mEncoded.assign(world.chunkStamps.size(), {});
+		mEncodedPublish.assign(world.chunkStamps.size(), 0);
+	}
+	++mPublishCount;
+
+	Socket socket;
+	while (mListener.Accept(socket)) {
+		auto viewer = std::make_unique<Viewer>();
+		viewer->channel = MessageChannel(std::move(socket));
+
+		viewer->channel.BeginMessage(stream::messageHello);
+		viewer->channel.Write(stream::Hello{ mWidth, mHeight, chunkSize });
+		viewer->channel.EndMessage();
+		mViewers.push_back(std::move(viewer));
+	}
+
+	// A new viewer first flushes its hello. It then gets a frame with every
+	// chunk, since its checkpoint of 0 predates all stamps.
+	const uint64_t checkpoint = world.stamp;
+	for (auto& viewer : mViewers) {
+		const uint64_t sentBefore = viewer->channel.BytesSent();
+		if (viewer->channel.Flush()) {
+			if (viewer->channel.HasPending()) {
+				++mFramesDropped;
+			}
+			else {
+				QueueFrame(*viewer, world, frame);
+				viewer->checkpoint = checkpoint;
+				viewer->channel.Flush();
+			}
+		}
+		mBytesSent += viewer->channel.BytesSent() - sentBefore;
+	}
+	world.Checkpoint();
+
+	mViewers.erase(std::remove_if(mViewers.begin(), mViewers.end(),
+		[](const std::unique_ptr<Viewer>& v) { return !v->channel.Open(); }), mViewers.end());
+}
+
+bool StreamClient::Connect(const std::string& host, uint16_t port)
+{
+	mWorld.reset();
+	mFrame = 0;
+	return mChannel.Connect(host, port);
+}
+
+bool StreamClient::Poll()
+{
+	return mChannel.Receive([this](uint8_t type, const uint8_t* data, size_t size) {
+		return HandleMessage(type, data, size);
+	});
+}
+
+bool StreamClient::HandleMessage(uint8_t type, const uint8_t* data, size_t size)
+{
+	if (type == stream::messageHello) {
+		stream::Hello hello;
+		if (size < sizeof(hello))
+			return false;
+		std::memcpy(&hello, data, sizeof(hello));
+		if (hello.chunkSize != chunkSize || hello.width == 0 || hello.height == 0)
+			return false;
+
+		mWorld = std::make_unique<World>(hello.width, hello.height);
+		return true;
+	}
+
+	if (type == stream::messageFrame)
+		return mWorld != nullptr && ApplyFrame(data, size);
+
+	// unknown messages are skipped, newer servers may send more
+	return true;
+}
+
+bool StreamClient::ApplyFrame(const uint8_t* data, size_t size)
+{
+	stream::FrameHeader header;
+	if (size < sizeof(header))
+		return false;
+	std::memcpy(&header, data, sizeof(header));
+
+	World& world = *mWorld;
+	const uint8_t* p = data + sizeof(header);
+	const uint8_t* end = data + size;
+
+	for (uint32_t i = 0; i < header.chunkCount; ++i) {
+		stream::ChunkHeader chunk;
+		if (static_cast<size_t>(end - p) < sizeof(chunk))
+			return false;
+		std::memcpy(&chunk, p, sizeof(chunk));
+		p += sizeof(chunk);
+
+		if (chunk.index >= world.chunkStamps.size() || chunk.size > static_cast<size_t>(end - p))
+			return false;
+
+		const ChunkRect r = ChunkBounds(world, chunk.index);
+		const size_t cells = r.Cells();
+		mPlanes.resize(cells * 5);
+		if (!DecompressBytes(p, chunk.size, mPlanes.data(), mPlanes.size()))
+			return false;
+		p += chunk.size;
+
+		size_t k = 0;
+		for (unsigned int y = r.y0; y < r.y1; ++y) {
+			const size_t row = static_cast<size_t>(y) * world.width;
+			for (unsigned int x = r.x0; x < r.x1; ++x, ++k) {
+				const Color32 c(mPlanes[cells + k], mPlanes[cells * 2 + k], mPlanes[cells * 3 + k], mPlanes[cells * 4 + k]);
+				world.particles[row + x].id = mPlanes[k];
+				world.particles[row + x].color = c;
+				world.colors[row + x] = c;
+			}
+		}
+		world.Touch(r.x0, r.y0);
+	}
+
+	mFrame = header.frame;
+	++mFramesReceived;
+	return true;
+}
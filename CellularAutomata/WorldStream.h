@@ -0,0 +1,114 @@
+#pragma once
+
+#include "ParticleSim.h"
+#include "MessageChannel.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Streaming of a running world to viewers over TCP.
+//
+// Messages go over a MessageChannel. After connecting, a viewer gets a hello with the world size and chunk size, then
+// frames. A frame holds the chunks that changed since the viewer's previous
+// frame: chunk index, compressed size, and the chunk's cells compressed with
+// StreamCodec as planes of ids, reds, greens, blues and alphas.
+//
+// The server never blocks on a viewer. While a viewer still has unsent bytes
+// it gets no new frame. It keeps its own checkpoint, so the frame it gets
+// once it caught up carries every chunk changed in the frames it skipped.
+// Slow viewers therefore drop frames, never state.
+namespace stream
+{
+	constexpr uint8_t messageHello = 1;
+	constexpr uint8_t messageFrame = 2;
+
+	struct Hello
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t chunkSize;
+	};
+
+	struct FrameHeader
+	{
+		uint64_t frame;
+		uint32_t chunkCount;
+	};
+
+	struct ChunkHeader
+	{
+		uint32_t index;
+		uint32_t size;
+	};
+}
+
+class StreamServer
+{
+public:
+	bool Start(uint16_t port, unsigned int width, unsigned int height);
+	void Stop();
+
+	// Accept new viewers, send a frame to every viewer that is caught up and
+	// keep pushing pending bytes to the others.
+	void Publish(World& world, uint64_t frame);
+
+	size_t ViewerCount() const { return mViewers.size(); }
+	uint64_t FramesSent() const { return mFramesSent; }
+	uint64_t FramesDropped() const { return mFramesDropped; }
+	uint64_t BytesSent() const { return mBytesSent; }
+
+	// compressed chunk cache and viewer buffers
+	size_t MemoryBytes() const;
+
+private:
+	struct Viewer
+	{
+		MessageChannel channel;
+		uint64_t checkpoint = 0;	// world checkpoint of the last frame queued
+	};
+
+	const std::vector<uint8_t>& EncodedChunk(const World& world, size_t chunk);
+	void QueueFrame(Viewer& viewer, const World& world, uint64_t frame);
+
+	Socket mListener;
+	std::vector<std::unique_ptr<Viewer>> mViewers;
+	unsigned int mWidth = 0;
+	unsigned int mHeight = 0;
+
+	// chunks compressed during the current Publish, shared by all viewers
+	std::vector<std::vector<uint8_t>> mEncoded;
+	std::vector<uint64_t> mEncodedPublish;
+	uint64_t mPublishCount = 0;
+
+	uint64_t mFramesSent = 0;
+	uint64_t mFramesDropped = 0;
+	uint64_t mBytesSent = 0;
+};
+
+class StreamClient
+{
+public:
+	bool Connect(const std::string& host, uint16_t port);
+
+	// Receive what arrived and apply every complete frame. False once the
+	// server closed the connection.
+	bool Poll();
+
+	// null until the hello arrived
+	World* GetWorld() { return mWorld.get(); }
+
+	uint64_t Frame() const { return mFrame; }
+	uint64_t FramesReceived() const { return mFramesReceived; }
+	uint64_t BytesReceived() const { return mChannel.BytesReceived(); }
+
+private:
+	bool HandleMessage(uint8_t type, const uint8_t* data, size_t size);
+	bool ApplyFrame(const uint8_t* data, size_t size);
+
+	MessageChannel mChannel;
+	std::vector<uint8_t> mPlanes;
+	std::unique_ptr<World> mWorld;
+	uint64_t mFrame = 0;
+	uint64_t mFramesReceived = 0;
+};